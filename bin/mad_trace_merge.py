@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+
+#
+#  This file is part of MADNESS.
+#
+#  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+#
+#  This program is free software; you can redistribute it and/or modify
+#  it under the terms of the GNU General Public License as published by
+#  the Free Software Foundation; either version 2 of the License, or
+#  (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software
+#  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+#
+#  For more information please contact:
+#
+#  Robert J. Harrison
+#  Oak Ridge National Laboratory
+#  One Bethel Valley Road
+#  P.O. Box 2008, MS-6367
+#
+#  email: harrisonrj@ornl.gov
+#  tel:   865-241-3937
+#  fax:   865-572-0680
+#
+
+"""Merges the per-rank traces written with MAD_TRACE=<prefix> into one file.
+
+Usage: mad_trace_merge.py [-o merged.json] [--summary] prefix.0.json prefix.1.json ...
+       mad_trace_merge.py [-o merged.json] [--summary] prefix
+
+Given just a prefix, all files named prefix.<rank>.json are merged. The
+result loads in chrome://tracing or https://ui.perfetto.dev, with one
+process per rank. Flow arrows (submit -> ready -> run) are keyed by task
+address, so they are made unique per rank here.
+
+--summary prints, per rank, the busy time of each thread, the time in
+fences and the ten task types with the largest total time.
+"""
+
+import argparse
+import collections
+import glob
+import json
+import re
+import sys
+
+
+def rank_files(args):
+    files = []
+    for name in args:
+        if name.endswith('.json'):
+            files.append(name)
+        else:
+            matches = glob.glob(name + '.*.json')
+            pattern = re.compile(re.escape(name) + r'\.(\d+)\.json$')
+            matches = [m for m in matches if pattern.search(m)]
+            matches.sort(key=lambda m: int(pattern.search(m).group(1)))
+            files.extend(matches)
+    return files
+
+
+def summarize(events, out):
+    busy = collections.defaultdict(float)
+    fence = collections.defaultdict(float)
+    task = collections.defaultdict(lambda: collections.defaultdict(float))
+    span = {}
+    for e in events:
+        if e.get('ph') != 'X':
+            continue
+        pid = e['pid']
+        t0, t1 = e['ts'], e['ts'] + e['dur']
+        lo, hi = span.get(pid, (t0, t1))
+        span[pid] = (min(lo, t0), max(hi, t1))
+        if e.get('cat') == 'task':
+            busy[(pid, e['tid'])] += e['dur']
+            task[pid][e['name']] += e['dur']
+        elif e.get('cat') == 'gop':
+            fence[pid] += e['dur']
+
+    for pid in sorted(span):
+        lo, hi = span[pid]
+        out.write('rank %d: span %.3f s, fence %.3f s\n' % (pid, (hi - lo)*1e-6, fence[pid]*1e-6))
+        for (p, tid) in sorted(busy):
+            if p == pid:
+                out.write('    thread %d busy %.3f s (%.1f%%)\n' %
+                          (tid, busy[(p, tid)]*1e-6, 100.0*busy[(p, tid)]/max(hi - lo, 1e-9)))
+        top = sorted(task[pid].items(), key=lambda kv: -kv[1])[:10]
+        for name, t in top:
+            out.write('    %10.3f s  %s\n' % (t*1e-6, name))
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Merge MADNESS per-rank Chrome traces.')
+    parser.add_argument('-o', '--output', default='trace.json', help='merged output file')
+    parser.add_argument('--summary', action='store_true', help='print a per-rank summary')
+    parser.add_argument('inputs', nargs='+', help='per-rank files or a file prefix')
+    args = parser.parse_args()
+
+    files = rank_files(args.inputs)
+    if not files:
+        sys.exit('mad_trace_merge: no input files found')
+
+    events = []
+    for name in files:
+        with open(name) as f:
+            trace = json.load(f)
+        for e in trace['traceEvents']:
+            if 'id' in e:
+                e['id'] = '%s:%s' % (e.get('pid', 0), e['id'])
+            events.append(e)
+
+    with open(args.output, 'w') as f:
+        json.dump({'displayTimeUnit': 'ms', 'traceEvents': events}, f)
+    sys.stderr.write('mad_trace_merge: wrote %d events from %d files to %s\n' %
+                     (len(events), len(files), args.output))
+
+    if args.summary:
+        summarize(events, sys.stdout)
+
+
+if __name__ == '__main__':
+    main()
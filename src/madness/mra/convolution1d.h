@@ -37,11 +37,15 @@
 #include <limits.h>
 #include <madness/tensor/tensor.h>
 #include <madness/mra/simplecache.h>
+#include <madness/mra/funcdefaults.h>
+#include <madness/mra/operatorcache.h>
+#include <madness/mra/sharedcache.h>
 #include <madness/mra/adquad.h>
 #include <madness/mra/twoscale.h>
 #include <madness/tensor/aligned.h>
 #include <madness/tensor/tensor_lapack.h>
 #include <algorithm>
+#include <type_traits>
 
 /// \file mra/convolution1d.h
 /// \brief Compuates most matrix elements over 1D operators (including Gaussians)
@@ -153,6 +157,64 @@ namespace madness {
     //     return result;
     // }
 
+    namespace detail {
+        /// append the dimensions and elements of a contiguous tensor to a vector of doubles
+
+        /// The elements start at a multiple of 8 doubles (64 bytes) from the
+        /// start of the vector, so that they may be used in place
+        template <typename T>
+        void pack_tensor(std::vector<double>& v, const Tensor<T>& t) {
+            v.push_back(t.ndim());
+            for (long d=0; d<t.ndim(); ++d) v.push_back(t.dim(d));
+            if (t.size() == 0) return;
+            MADNESS_ASSERT(t.iscontiguous());
+            v.resize((v.size()+7)/8*8, 0.0);
+            const double* p = reinterpret_cast<const double*>(t.ptr());
+            v.insert(v.end(), p, p + t.size()*sizeof(T)/sizeof(double));
+        }
+
+        /// make a tensor from data written by pack_tensor and advance the pointer past it
+
+        /// @param[in] base the start of the packed data
+        /// @param[in,out] p the packed tensor
+        /// @param[in] owner if not null the tensor refers to the packed data and keeps owner alive
+        template <typename T>
+        Tensor<T> unpack_tensor(const double* base, const double*& p, const std::shared_ptr<void>& owner) {
+            const long ndim = long(*p++);
+            if (ndim < 0) return Tensor<T>();
+            std::vector<long> dims(ndim);
+            long size = 1;
+            for (long d=0; d<ndim; ++d) {
+                dims[d] = long(*p++);
+                size *= dims[d];
+            }
+            if (size == 0) return Tensor<T>(dims);
+            p = base + (p-base+7)/8*8;
+            const std::size_t n = size*sizeof(T)/sizeof(double);
+            Tensor<T> t;
+            if (owner) {
+                t = Tensor<T>(dims, reinterpret_cast<T*>(const_cast<double*>(p)), owner);
+            }
+            else {
+                t = Tensor<T>(dims, false);
+                std::copy(p, p + n, reinterpret_cast<double*>(t.ptr()));
+            }
+            p += n;
+            return t;
+        }
+
+        /// single precision copy of a tensor
+        inline Tensor<float> to_float(const Tensor<double>& t) {
+            if (t.size() == 0) return Tensor<float>();
+            const Tensor<double> c = t.iscontiguous() ? t : copy(t);
+            Tensor<float> f(c.ndim(), c.dims(), false);
+            const double* restrict p = c.ptr();
+            float* restrict q = f.ptr();
+            for (long i=0; i<c.size(); ++i) q[i] = p[i];
+            return f;
+        }
+    }
+
     /// actual data for 1 dimension and for 1 term and for 1 displacement for a convolution operator
     /// here we keep the transformation matrices
 
@@ -164,6 +226,7 @@ namespace madness {
         Tensor<Q> R, T;                 ///< if NS: R=ns, T=T part of ns; if modified NS: T=\uparrow r^(n-1)
         Tensor<Q> RU, RVT, TU, TVT;     ///< SVD approximations to R and T
         Tensor<typename Tensor<Q>::scalar_type> Rs, Ts;     ///< hold relative errors, NOT the singular values..
+        Tensor<float> Rf, Tf, RUf, RVTf, TUf, TVTf;         ///< single precision R, T, RU, ..., see make_float
 
         // norms for NS form
         double Rnorm, Tnorm, Rnormf, Tnormf, NSnormf;
@@ -177,6 +240,7 @@ namespace madness {
         /// @param[in]  R   operator matrix of the requested level;     NS: unfilter(r^(n+1)); modified NS: r^n
         /// @param[in]  T   upsampled operator matrix from level n-1;   NS: r^n; modified NS: filter( r^(n-1) )
         ConvolutionData1D(const Tensor<Q>& R, const Tensor<Q>& T) : R(R), T(T) {
+            N_F = N_up = N_diff = 0.0;
             Rnormf = R.normf();
             // Making the approximations is expensive ... only do it for
             // significant components
@@ -197,6 +261,7 @@ namespace madness {
                 Rnorm = Tnorm = Rnormf = Tnormf = NSnormf = 0.0;
                 N_F = N_up = N_diff = 0.0;
             }
+            make_float();
         }
 
         /// ctor for modified NS form
@@ -208,6 +273,7 @@ namespace madness {
 
             // note that R can be small, but T still be large
 
+            Rnorm = Tnorm = NSnormf = 0.0;
             Rnormf = R.normf();
             Tnormf = T.normf();
             // Making the approximations is expensive ... only do it for
@@ -219,9 +285,83 @@ namespace madness {
             N_F=Rnormf;
             N_up=Tnormf;
             N_diff=(R-T).normf();
+            make_float();
+        }
+
+
+
+        /// ctor from the data written by pack, e.g. by the operator caches
+
+        /// @param[in] data the packed data
+        /// @param[in] size the number of doubles
+        /// @param[in] owner if not null the tensors refer to data, which owner keeps alive
+        ConvolutionData1D(const double* data, std::size_t size,
+                          const std::shared_ptr<void>& owner = std::shared_ptr<void>()) {
+            const double* p = data;
+            Rnorm = p[0];
+            Tnorm = p[1];
+            Rnormf = p[2];
+            Tnormf = p[3];
+            NSnormf = p[4];
+            N_up = p[5];
+            N_diff = p[6];
+            N_F = p[7];
+            p += 8;
+            R = detail::unpack_tensor<Q>(data, p, owner);
+            T = detail::unpack_tensor<Q>(data, p, owner);
+            RU = detail::unpack_tensor<Q>(data, p, owner);
+            RVT = detail::unpack_tensor<Q>(data, p, owner);
+            TU = detail::unpack_tensor<Q>(data, p, owner);
+            TVT = detail::unpack_tensor<Q>(data, p, owner);
+            Rs = detail::unpack_tensor<typename Tensor<Q>::scalar_type>(data, p, owner);
+            Ts = detail::unpack_tensor<typename Tensor<Q>::scalar_type>(data, p, owner);
+            MADNESS_ASSERT(p == data + size);
+            make_float();
+        }
+
+        /// flatten into doubles
+        std::vector<double> pack() const {
+            std::vector<double> v;
+            v.push_back(Rnorm);
+            v.push_back(Tnorm);
+            v.push_back(Rnormf);
+            v.push_back(Tnormf);
+            v.push_back(NSnormf);
+            v.push_back(N_up);
+            v.push_back(N_diff);
+            v.push_back(N_F);
+            detail::pack_tensor(v, R);
+            detail::pack_tensor(v, T);
+            detail::pack_tensor(v, RU);
+            detail::pack_tensor(v, RVT);
+            detail::pack_tensor(v, TU);
+            detail::pack_tensor(v, TVT);
+            detail::pack_tensor(v, Rs);
+            detail::pack_tensor(v, Ts);
+            return v;
+        }
+
+        /// make the single precision blocks used by the mixed precision apply
+
+        /// Only real blocks made while detail::float_convolution_blocks() is
+        /// set get a single precision copy; the others are applied in
+        /// double precision.  The copies are local even if the blocks are
+        /// in a shared or file cache.
+        void make_float() {
+            if (detail::float_convolution_blocks().load(std::memory_order_relaxed))
+                make_float(std::is_same<Q,double>());
         }
 
+        void make_float(std::false_type) {}
 
+        void make_float(std::true_type) {
+            Rf = detail::to_float(R);
+            Tf = detail::to_float(T);
+            RUf = detail::to_float(RU);
+            RVTf = detail::to_float(RVT);
+            TUf = detail::to_float(TU);
+            TVTf = detail::to_float(TVT);
+        }
 
         /// approximate the operator matrices using SVD, and abuse Rs to hold the error instead of
         /// the singular values (seriously, who named this??)
@@ -271,6 +411,8 @@ namespace madness {
         mutable SimpleCache<Tensor<Q>, 1> rnlij_cache;
         mutable SimpleCache<ConvolutionData1D<Q>, 1> ns_cache;
         mutable SimpleCache<ConvolutionData1D<Q>, 2> mod_ns_cache;
+        std::shared_ptr<OperatorCacheFile> diskcache; ///< persistent cache of the NS form, may be null
+        hashT shared_id;    ///< identifies the operator in the SharedOperatorCache, 0 if not shared
 
         virtual ~Convolution1D() {};
 
@@ -281,6 +423,7 @@ namespace madness {
                 , quad_x(npt)
                 , quad_w(npt)
                 , arg(arg)
+                , shared_id(0)
         {
 
             MADNESS_ASSERT(autoc(k,&c));
@@ -368,6 +511,16 @@ namespace madness {
             const ConvolutionData1D<Q>* p = mod_ns_cache.getptr(cache_key);
             if (p) return p;
 
+            const SharedOperatorCache::BlockKey shared_key(shared_id, 1, n, lx, s_off);
+            if (shared_id) {
+                std::size_t size;
+                const double* data = SharedOperatorCache::find(shared_key, size);
+                if (data) {
+                    mod_ns_cache.set(cache_key,ConvolutionData1D<Q>(data, size, SharedOperatorCache::owner()));
+                    return mod_ns_cache.getptr(cache_key);
+                }
+            }
+
             // for paranoid me
             MADNESS_ASSERT(sx>=0 and tx>=0);
 
@@ -416,7 +569,14 @@ namespace madness {
 
 //            }
 
-            mod_ns_cache.set(cache_key,ConvolutionData1D<Q>(R,T,true));
+            const ConvolutionData1D<Q> data(R,T,true);
+            if (shared_id) {
+                const std::vector<double> v = data.pack();
+                mod_ns_cache.set(cache_key,shared_block(shared_key, &v[0], v.size(), data));
+            }
+            else {
+                mod_ns_cache.set(cache_key,data);
+            }
             return mod_ns_cache.getptr(cache_key);
         }
 
@@ -425,6 +585,25 @@ namespace madness {
             const ConvolutionData1D<Q>* p = ns_cache.getptr(n,lx);
             if (p) return p;
 
+            const SharedOperatorCache::BlockKey shared_key(shared_id, 0, n, lx);
+            if (shared_id) {
+                std::size_t size;
+                const double* data = SharedOperatorCache::find(shared_key, size);
+                if (data) {
+                    ns_cache.set(n,lx,ConvolutionData1D<Q>(data, size, SharedOperatorCache::owner()));
+                    return ns_cache.getptr(n,lx);
+                }
+            }
+
+            if (diskcache) {
+                std::size_t size;
+                const double* data = diskcache->find(n, lx, size);
+                if (data) {
+                    ns_cache.set(n,lx,shared_block(shared_key, data, size, ConvolutionData1D<Q>(data, size)));
+                    return ns_cache.getptr(n,lx);
+                }
+            }
+
             // PROFILE_MEMBER_FUNC(Convolution1D); // Too fine grain for routine profiling
 
             Tensor<Q> R, T;
@@ -479,11 +658,33 @@ namespace madness {
                 //print("NS", n, lx, R.normf(), T.normf());
             }
 
-            ns_cache.set(n,lx,ConvolutionData1D<Q>(R,T));
+            const ConvolutionData1D<Q> data(R,T);
+            if (diskcache || shared_id) {
+                const std::vector<double> v = data.pack();
+                if (diskcache) diskcache->insert(n, lx, v);
+                ns_cache.set(n,lx,shared_block(shared_key, &v[0], v.size(), data));
+            }
+            else {
+                ns_cache.set(n,lx,data);
+            }
 
             return ns_cache.getptr(n,lx);
         };
 
+        /// Store a block in the SharedOperatorCache and return the copy that refers to the segment
+
+        /// @param[in] key the key of the block in the shared cache
+        /// @param[in] v,size the packed block
+        /// @param[in] local the block, returned if it cannot be shared
+        ConvolutionData1D<Q> shared_block(const SharedOperatorCache::BlockKey& key, const double* v,
+                                          std::size_t size, const ConvolutionData1D<Q>& local) const {
+            if (shared_id) {
+                const double* data = SharedOperatorCache::insert(key, v, size);
+                if (data) return ConvolutionData1D<Q>(data, size, SharedOperatorCache::owner());
+            }
+            return local;
+        }
+
         Q phase(double R) const {
         	return 1.0;
         }
@@ -703,6 +904,20 @@ namespace madness {
             , m(m)
         {
             MADNESS_ASSERT(m>=0 && m<=2);
+
+            // the blocks of the NS form depend on all of these
+            OperatorCacheFile::idT id;
+            id.push_back(sizeof(Q)/sizeof(double));
+            id.push_back(k);
+            id.push_back(this->npt);
+            id.push_back(Convolution1D<Q>::maxR);
+            id.push_back(std::real(coeff));
+            id.push_back(std::imag(coeff));
+            id.push_back(expnt);
+            id.push_back(m);
+            id.push_back(arg);
+            this->diskcache = OperatorCacheFile::open("gaussian", id);
+            if (SharedOperatorCache::enabled()) this->shared_id = hash_range(id.begin(), id.end());
             // std::cout << "GC expnt=" << expnt << " coeff="  << coeff << " natlev=" << natlev << " maxR=" << maxR(periodic,expnt) << std::endl;
             // for (Level n=0; n<5; n++) {
             //     for (Translation l=0; l<(1<<n); l++) {
@@ -845,9 +1060,9 @@ namespace madness {
 
     template <typename Q>
     struct GaussianConvolution1DCache {
-        static ConcurrentHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > > map;
-        typedef typename ConcurrentHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > >::iterator iterator;
-        typedef typename ConcurrentHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > >::datumT datumT;
+        static ContainerHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > > map;
+        typedef typename ContainerHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > >::iterator iterator;
+        typedef typename ContainerHashMap<hashT, std::shared_ptr< GaussianConvolution1D<Q> > >::datumT datumT;
 
         static std::shared_ptr< GaussianConvolution1D<Q> > get(int k, double expnt, int m, bool periodic) {
             hashT key = hash_value(expnt);
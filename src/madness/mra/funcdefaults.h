@@ -42,6 +42,7 @@
 #include <madness/world/worlddc.h>
 #include <madness/tensor/tensor.h>
 #include <madness/mra/key.h>
+#include <atomic>
 
 namespace madness {
     template <typename T, std::size_t NDIM> class FunctionImpl;
@@ -159,6 +160,17 @@ namespace madness {
      }
 
 
+    namespace detail {
+        /// True if new ConvolutionData1D also keep their blocks in single precision
+
+        /// Set by FunctionDefaults::set_apply_float_thresh()
+        inline std::atomic<bool>& float_convolution_blocks() {
+            static std::atomic<bool> flag(false);
+            return flag;
+        }
+    }
+
+
     /// FunctionDefaults holds default paramaters as static class members
 
     /// Declared and initialized in mra.cc and/or funcimpl::initialize.
@@ -183,6 +195,10 @@ namespace madness {
         static bool debug;             ///< Controls output of debug info
         static bool truncate_on_project; ///< If true initial projection inserts at n-1 not n
         static bool apply_randomize;   ///< If true use randomization for load balancing in apply integral operator
+        static bool apply_batch;       ///< If true apply integral operators to each shell of displacements in one batch
+        static bool apply_rank_by_flops; ///< If true integral operators choose dense or low-rank 1D blocks by operation count
+        static double apply_float_thresh; ///< Integral operators use single precision blocks if thresh is at least this, 0 never
+        static std::size_t apply_buffer_size; ///< Bytes per process for summing the results of apply locally, 0 sends each
         static bool project_randomize; ///< If true use randomization for load balancing in project/refine
         static BoundaryConditions<NDIM> bc; ///< Default boundary conditions
         static Tensor<double> cell ;   ///< cell[NDIM][2] Simulation cell, cell(0,0)=xlo, cell(0,1)=xhi, ...
@@ -331,6 +347,70 @@ namespace madness {
             apply_randomize=value;
         }
 
+        /// Gets the flag for batched application of integral operators
+        static bool get_apply_batch() {
+            return apply_batch;
+        }
+
+        /// Sets the flag for batched application of integral operators
+
+        /// If true (the default) the displacements of each shell of
+        /// neighbors are applied together by SeparatedConvolution::apply_batch
+        static void set_apply_batch(bool value) {
+            apply_batch=value;
+        }
+
+        /// Gets the flag for choosing the rank of the 1D operator blocks by operation count
+        static bool get_apply_rank_by_flops() {
+            return apply_rank_by_flops;
+        }
+
+        /// Sets the flag for choosing the rank of the 1D operator blocks by operation count
+
+        /// If true integral operators use the dense or the low-rank form of
+        /// each 1D block so that the estimated operation count of a term is
+        /// least; if false (the default) a block is used in low-rank form if
+        /// its rank is below a fixed fraction of its size
+        static void set_apply_rank_by_flops(bool value) {
+            apply_rank_by_flops=value;
+        }
+
+        /// Gets the threshold above which integral operators use single precision blocks
+        static double get_apply_float_thresh() {
+            return apply_float_thresh;
+        }
+
+        /// Sets the threshold above which integral operators use single precision blocks
+
+        /// If \c value is positive and the truncation threshold is at least
+        /// \c value, SeparatedConvolution::apply transforms the coefficients
+        /// with single precision copies of the 1D blocks and accumulates
+        /// the result in double precision.  The single precision blocks
+        /// are only made for operator blocks computed after the first call
+        /// with a positive value, so this should be set before operators
+        /// are constructed.  The default is 0 (never).
+        static void set_apply_float_thresh(double value) {
+            apply_float_thresh=value;
+            if (value > 0.0) detail::float_convolution_blocks() = true;
+        }
+
+        /// Gets the size of the buffers in which apply sums its results
+        static std::size_t get_apply_buffer_size() {
+            return apply_buffer_size;
+        }
+
+        /// Sets the size of the buffers in which apply sums its results
+
+        /// Each thread sums the contributions of the integral operator to
+        /// a destination node in a local buffer, and the sums are sent to
+        /// the nodes when the operator has been applied to all source
+        /// nodes, or earlier when the buffer of the thread exceeds its
+        /// share of \c value bytes.  If \c value is 0 each contribution
+        /// is sent as soon as it is computed.  The default is 64 MB.
+        static void set_apply_buffer_size(std::size_t value) {
+            apply_buffer_size=value;
+        }
+
 
         /// Gets the random load balancing for projection flag
         static bool get_project_randomize() {
@@ -37,6 +37,7 @@
 
 #include <iostream>
 #include <type_traits>
+#include <unordered_map>
 #include <madness/world/MADworld.h>
 #include <madness/world/print.h>
 #include <madness/misc/misc.h>
@@ -576,9 +577,7 @@ namespace madness {
             const opkeyT source=op->get_source_key(key);
 
             const double thresh=f->truncate_tol(f->get_thresh(),key);
-            const std::vector<opkeyT>& disp = op->get_disp(key.level());
-            const opkeyT& d = *disp.begin();         // use the zero-displacement for screening
-            const double opnorm = op->norm(key.level(), d, source);
+            const double opnorm = op->disp_norm(key.level(), 0, source);   // use the zero-displacement for screening
             const double norm=opnorm*cnorm;
             return norm<thresh;
 
@@ -650,9 +649,7 @@ namespace madness {
             if (error < thresh) return true;
 
             // now check if the norm of this and the norm of the operator are significant
-            const std::vector<Key<NDIM> >& disp = op->get_disp(key.level());
-            const Key<NDIM>& d = *disp.begin();         // use the zero-displacement for screening
-            const double opnorm = op->norm(key.level(), d, key);
+            const double opnorm = op->disp_norm(key.level(), 0, key);   // use the zero-displacement for screening
             const double final_norm=opnorm*sfnorm*sgnorm;
             if (final_norm < thresh) return true;
 
@@ -930,6 +927,16 @@ namespace madness {
 
         dcT coeffs; ///< The coefficients
 
+        /// Sums of the results of apply for their destination nodes, kept by one thread
+        struct ApplyBuffer {
+            Mutex mutex;
+            std::unordered_map<keyT, tensorT, Hash<keyT> > sums;
+            std::size_t bytes;      ///< size of the sums
+            const std::size_t cap;  ///< the sums are sent when they are larger
+            ApplyBuffer(std::size_t cap) : bytes(0), cap(cap) {}
+        };
+        std::vector< std::shared_ptr<ApplyBuffer> > apply_buffers; ///< one per thread while apply buffers, else empty
+
         // Disable the default copy constructor
         FunctionImpl(const FunctionImpl<T,NDIM>& p);
 
@@ -4095,6 +4102,13 @@ namespace madness {
         //        void reconstruct_op(const keyT& key, const tensorT& s);
         void reconstruct_op(const keyT& key, const coeffT& s);
 
+        /// Estimated run time in microseconds of a task that filters or unfilters one node
+
+        /// Used as the cost hint of the tasks of \c compress and
+        /// \c reconstruct so that in low dimension, where these tasks are
+        /// tiny, they may be run inline or fused (see \c TaskFusion).
+        unsigned long transform_cost() const;
+
         /// compress the wave function
 
         /// after application there will be sum coefficients at the root level,
@@ -4354,6 +4368,12 @@ namespace madness {
 
             const std::vector<opkeyT>& disp = op->get_disp(key.level()); // list of displacements sorted in orer of increasing distance
             const std::vector<bool> is_periodic(NDIM,false); // Periodic sum is already done when making rnlp
+            const double tol = truncate_tol(thresh, key);
+            const bool batch = FunctionDefaults<NDIM>::get_apply_batch();
+            std::vector<opkeyT> batched;  // Batched displacements of whole shells
+            std::vector<keyT> dests;
+            std::vector<double> tols;
+            const std::size_t max_batch = 64;
 	    int ndone=1;	// Counts #done at each distance
 	    uint64_t distsq = 99999999999999; 
             for (typename std::vector<opkeyT>::const_iterator it=disp.begin(); it != disp.end(); ++it) {
@@ -4364,6 +4384,11 @@ namespace madness {
 
 		uint64_t dsq = d.distsq();
 		if (dsq != distsq) { // Moved to next shell of neighbors
+                    // Shells whose displacements share 1D blocks are batched
+                    // together; whether a shell is done depends only on the
+                    // operator norms, not on the results
+                    if (batched.size() >= max_batch)
+                        do_apply_batch(op, source, batched, dests, tols, c, 0.3*tol/fac);
 		    if (ndone == 0 && dsq > 1) {
 		        // Have at least done the input box and all first
 		        // nearest neighbors, and for all of the last set
@@ -4377,20 +4402,98 @@ namespace madness {
 
                 keyT dest = neighbor(key, d, is_periodic);
                 if (dest.is_valid()) {
-                    double opnorm = op->norm(key.level(), *it, source);
-                    double tol = truncate_tol(thresh, key);
+                    double opnorm = op->disp_norm(key.level(), it - disp.begin(), source);
 
                     if (cnorm*opnorm> tol/fac) {
 		        ndone++;
+                        if (batch) {
+                            batched.push_back(*it);
+                            dests.push_back(dest);
+                            tols.push_back(tol/fac/cnorm);
+                            continue;
+                        }
 		        tensorT result = op->apply(source, *it, c, tol/fac/cnorm);
 			if (result.normf() > 0.3*tol/fac) {
 			      // Switched back to send in order to get rid of a zillion small tasks and to preserve
 			      // direct call optimization.  Also reduces remote memory foot print.
-			      coeffs.send(dest, &nodeT::accumulate2, result, coeffs, dest);
+			      accumulate_apply(dest, result);
                         }
                     }
                 }
             }
+            do_apply_batch(op, source, batched, dests, tols, c, 0.3*tol/fac);
+        }
+
+        /// apply an operator for a batch of displacements and send the results
+
+        /// @param[in] op	the operator to act on the source function
+        /// @param[in] source	the source key of the operator
+        /// @param[in,out] shifts	the displacements, cleared on return
+        /// @param[in,out] dests	the destination of each displacement, cleared on return
+        /// @param[in,out] tols	the tolerance of each displacement, cleared on return
+        /// @param[in] c	coeffs of the FunctionNode of f which is processed
+        /// @param[in] screen	results with a smaller norm are not sent
+        template <typename opT, typename R>
+        void do_apply_batch(const opT* op, const typename opT::keyT& source,
+                            std::vector<typename opT::keyT>& shifts, std::vector<keyT>& dests,
+                            std::vector<double>& tols, const Tensor<R>& c, double screen) {
+            if (shifts.empty()) return;
+            typedef TENSOR_RESULT_TYPE(R,typename opT::opT) resultT;
+            std::vector< Tensor<resultT> > results = op->apply_batch(source, shifts, c, tols);
+            for (std::size_t i=0; i<results.size(); ++i) {
+                tensorT result = results[i];
+                if (result.normf() > screen) {
+                    accumulate_apply(dests[i], result);
+                }
+            }
+            shifts.clear();
+            dests.clear();
+            tols.clear();
+        }
+
+        /// add a result of do_apply to the coefficients of a node
+
+        /// While apply buffers its results the result is added to the sum
+        /// for the node in the buffer of the calling thread, otherwise it
+        /// is sent to the node at once.
+        /// @param[in] dest	the destination node
+        /// @param[in] result	the result, which the buffer may keep and modify
+        void accumulate_apply(const keyT& dest, const tensorT& result) {
+            if (apply_buffers.empty()) {
+                coeffs.send(dest, &nodeT::accumulate2, result, coeffs, dest);
+                return;
+            }
+            // Threads outside the pool, e.g. the main thread, share the last buffer
+            const ThreadBase* thread = ThreadBase::this_thread();
+            const int index = thread ? thread->get_pool_thread_index() : -1;
+            const std::size_t last = apply_buffers.size()-1;
+            ApplyBuffer& buffer = *apply_buffers[(index >= 0 && std::size_t(index) < last) ? index : last];
+
+            ScopedMutex<Mutex> guard(buffer.mutex);
+            typename std::unordered_map<keyT, tensorT, Hash<keyT> >::iterator it = buffer.sums.find(dest);
+            if (it == buffer.sums.end()) {
+                buffer.sums.insert(std::make_pair(dest, result));
+                buffer.bytes += result.size()*sizeof(T);
+                if (buffer.bytes > buffer.cap) send_apply_buffer(buffer);
+            }
+            else {
+                it->second += result;
+            }
+        }
+
+        /// send the sums of a buffer to their nodes and empty it; the caller holds its mutex
+        void send_apply_buffer(ApplyBuffer& buffer) {
+            typename std::unordered_map<keyT, tensorT, Hash<keyT> >::const_iterator it;
+            for (it=buffer.sums.begin(); it!=buffer.sums.end(); ++it)
+                coeffs.send(it->first, &nodeT::accumulate2, it->second, coeffs, it->first);
+            buffer.sums.clear();
+            buffer.bytes = 0;
+        }
+
+        /// send the sums of the buffer of one thread to their nodes
+        void flush_apply_buffer(std::size_t i) {
+            ScopedMutex<Mutex> guard(apply_buffers[i]->mutex);
+            send_apply_buffer(*apply_buffers[i]);
         }
 
 
@@ -4399,6 +4502,18 @@ namespace madness {
         void apply(opT& op, const FunctionImpl<R,NDIM>& f, bool fence) {
             PROFILE_MEMBER_FUNC(FunctionImpl);
             MADNESS_ASSERT(!op.modified());
+
+            // The results are summed in buffers until all do_apply tasks
+            // are done, which is only known at the fence.  The tasks are
+            // then all local, since the owner of f's nodes is this process.
+            const std::size_t buffer_size = FunctionDefaults<NDIM>::get_apply_buffer_size();
+            const bool buffered = fence && buffer_size > 0 && !FunctionDefaults<NDIM>::get_apply_randomize();
+            if (buffered) {
+                const std::size_t nbuffer = ThreadPool::size() + 1;
+                for (std::size_t i=0; i<nbuffer; ++i)
+                    apply_buffers.push_back(std::make_shared<ApplyBuffer>(buffer_size/nbuffer));
+            }
+
             typename dcT::const_iterator end = f.coeffs.end();
             for (typename dcT::const_iterator it=f.coeffs.begin(); it!=end; ++it) {
                 // looping through all the coefficients in the source
@@ -4415,6 +4530,13 @@ namespace madness {
             if (fence)
                 world.gop.fence();
 
+            if (buffered) {
+                for (std::size_t i=0; i<apply_buffers.size(); ++i)
+                    woT::task(world.rank(), &implT::flush_apply_buffer, i);
+                world.gop.fence();
+                apply_buffers.clear();
+            }
+
             this->compressed=true;
             this->nonstandard=true;
             this->redundant=false;
@@ -4472,16 +4594,26 @@ namespace madness {
             const std::vector<opkeyT>& disp = op->get_disp(key.level());
             const std::vector<bool> is_periodic(NDIM,false); // Periodic sum is already done when making rnlp
 
-            for (typename std::vector<opkeyT>::const_iterator it=disp.begin(); it != disp.end(); ++it) {
-                const opkeyT& d = *it;
+            // displacements that may pass the screening below, without enumerating all others
+            std::vector<std::size_t> candidates;
+            if (do_kernel) {
+                for (std::size_t i=0; i<disp.size() and disp[i].distsq()==0; ++i) candidates.push_back(i);
+            } else {
+                candidates=op->screened_disp(key.level(), tol/fac/cnorm);
+            }
+            long nused=0;
+
+            for (std::size_t ic=0; ic<candidates.size(); ++ic) {
+                const std::size_t idisp=candidates[ic];
+                const opkeyT& d = disp[idisp];
 
                 const int shell=d.distsq();
                 if (do_kernel and (shell>0)) break;
                 if ((not do_kernel) and (shell==0)) continue;
 
                 keyT disp1;
-                if (op->particle()==1) disp1=it->merge_with(nullkey);
-                else if (op->particle()==2) disp1=nullkey.merge_with(*it);
+                if (op->particle()==1) disp1=d.merge_with(nullkey);
+                else if (op->particle()==2) disp1=nullkey.merge_with(d);
                 else {
                     MADNESS_EXCEPTION("confused particle in operato??",1);
                 }
@@ -4503,7 +4635,7 @@ namespace madness {
                 }
                 if (not screened) {
 
-                    double opnorm = op->norm(key.level(), d, source);
+                    double opnorm = op->disp_norm(key.level(), idisp, source);
                     double norm=0.0;
 
                     if (cnorm*opnorm> tol/fac) {
@@ -4514,6 +4646,7 @@ namespace madness {
 
                         if (cost_ratio>0.0) {
 
+                            ++nused;
                             do_op_args<opdim> args(source, d, dest, tol, fac, cnorm);
                             norm=0.0;
                             if (cost_ratio<1.0) {
@@ -4535,6 +4668,7 @@ namespace madness {
                     if (norm<0.3*tol/fac) blacklist.push_back(d);
                 }
             }
+            if (not do_kernel) op->count_used_disp(nused);
             return maxnorm;
         }
 
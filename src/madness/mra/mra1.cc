@@ -40,12 +40,12 @@
 namespace madness {
 
     template <>
-    ConcurrentHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double> > >
-    GaussianConvolution1DCache<double>::map = ConcurrentHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double> > >();
+    ContainerHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double> > >
+    GaussianConvolution1DCache<double>::map = ContainerHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double> > >();
 
     template <>
-    ConcurrentHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double_complex> > >
-    GaussianConvolution1DCache<double_complex>::map = ConcurrentHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double_complex> > >();
+    ContainerHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double_complex> > >
+    GaussianConvolution1DCache<double_complex>::map = ContainerHashMap< hashT, std::shared_ptr< GaussianConvolution1D<double_complex> > >();
 
 #ifdef FUNCTION_INSTANTIATE_1
 
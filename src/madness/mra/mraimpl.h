@@ -1452,6 +1452,13 @@ namespace madness {
         }
     }
 
+    template <typename T, std::size_t NDIM>
+    unsigned long FunctionImpl<T,NDIM>::transform_cost() const {
+        // NDIM products of a (2k)^NDIM tensor with a 2k x 2k matrix at about 4 Gflop/s
+        const double flops = 2.0*NDIM*std::pow(2.0*k, double(NDIM+1));
+        return std::max(1ul, static_cast<unsigned long>(std::min(flops*2.5e-4, 65535.0)));
+    }
+
     template <typename T, std::size_t NDIM>
     void FunctionImpl<T,NDIM>::reconstruct(bool fence) {
         // Must set true here so that successive calls without fence do the right thing
@@ -2022,7 +2029,8 @@ namespace madness {
                     coeffT ss = copy(d(child_patch(child)));
                     ss.reduce_rank(thresh);
                     //PROFILE_BLOCK(recon_send); // Too fine grain for routine profiling
-                    woT::task(coeffs.owner(child), &implT::reconstruct_op, child, ss);
+                    woT::task(coeffs.owner(child), &implT::reconstruct_op, child, ss,
+                              TaskAttributes::cost_hint(transform_cost()));
                 }
             } else {
                 MADNESS_ASSERT(node.is_leaf());
@@ -3073,10 +3081,11 @@ namespace madness {
                 //PROFILE_BLOCK(compress_send); // Too fine grain for routine profiling
                 // readily available
                 v[i] = woT::task(coeffs.owner(kit.key()), &implT::compress_spawn, kit.key(),
-                                 nonstandard, keepleaves, redundant, TaskAttributes::hipri());
+                                 nonstandard, keepleaves, redundant, TaskAttributes::cost_hint(1, true));
             }
-            if (redundant) return woT::task(world.rank(),&implT::make_redundant_op, key, v);
-            return woT::task(world.rank(),&implT::compress_op, key, v, nonstandard, redundant);
+            const TaskAttributes attr = TaskAttributes::cost_hint(transform_cost());
+            if (redundant) return woT::task(world.rank(),&implT::make_redundant_op, key, v, attr);
+            return woT::task(world.rank(),&implT::compress_op, key, v, nonstandard, redundant, attr);
         }
         else {
             Future<coeffT > result(node.coeff());
@@ -3307,6 +3316,10 @@ namespace madness {
         debug = false;
         truncate_on_project = true;
         apply_randomize = false;
+        apply_batch = true;
+        apply_rank_by_flops = false;
+        apply_float_thresh = 0.0;
+        apply_buffer_size = std::size_t(64) << 20;
         project_randomize = false;
         bc = BoundaryConditions<NDIM>(BC_FREE);
         tt = TT_FULL;
@@ -3332,6 +3345,10 @@ namespace madness {
     		std::cout << "                           debug" <<  ": " << debug << std::endl;
     		std::cout << "             truncate_on_project" <<  ": " << truncate_on_project << std::endl;
     		std::cout << "                 apply_randomize" <<  ": " << apply_randomize << std::endl;
+    		std::cout << "                     apply_batch" <<  ": " << apply_batch << std::endl;
+    		std::cout << "             apply_rank_by_flops" <<  ": " << apply_rank_by_flops << std::endl;
+    		std::cout << "              apply_float_thresh" <<  ": " << apply_float_thresh << std::endl;
+    		std::cout << "               apply_buffer_size" <<  ": " << apply_buffer_size << std::endl;
     		std::cout << "               project_randomize" <<  ": " << project_randomize << std::endl;
     		std::cout << "                              bc" <<  ": " << bc << std::endl;
     		std::cout << "                              tt" <<  ": " << tt << std::endl;
@@ -3351,6 +3368,10 @@ namespace madness {
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::debug;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::truncate_on_project;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::apply_randomize;
+    template <std::size_t NDIM> bool FunctionDefaults<NDIM>::apply_batch;
+    template <std::size_t NDIM> bool FunctionDefaults<NDIM>::apply_rank_by_flops;
+    template <std::size_t NDIM> double FunctionDefaults<NDIM>::apply_float_thresh;
+    template <std::size_t NDIM> std::size_t FunctionDefaults<NDIM>::apply_buffer_size;
     template <std::size_t NDIM> bool FunctionDefaults<NDIM>::project_randomize;
     template <std::size_t NDIM> BoundaryConditions<NDIM> FunctionDefaults<NDIM>::bc;
     template <std::size_t NDIM> TensorType FunctionDefaults<NDIM>::tt;
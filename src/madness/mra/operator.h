@@ -37,6 +37,9 @@
 
 /// \ingroup function
 
+#include <algorithm>
+#include <atomic>
+#include <functional>
 #include <type_traits>
 #include <limits.h>
 #include <madness/mra/adquad.h>
@@ -47,6 +50,7 @@
 #include <madness/mra/simplecache.h>
 #include <madness/mra/convolution1d.h>
 #include <madness/mra/displacements.h>
+#include <madness/mra/opnormtable.h>
 #include <madness/mra/function_common_data.h>
 #include <madness/mra/gfit.h>
 
@@ -147,6 +151,174 @@ namespace madness {
         // SeparatedConvolutionData keeps data for all terms and all dimensions and 1 displacement
         mutable SimpleCache< SeparatedConvolutionData<Q,NDIM>, NDIM > data; ///< cache for all terms, dims and displacements
         mutable SimpleCache< SeparatedConvolutionData<Q,NDIM>, 2*NDIM > mod_data; ///< cache for all terms, dims and displacements
+        mutable OperatorNormTable norm_table; ///< norms of the NS form for screening, indexed by displacement
+
+        /// Counts of the ranks of the 1D blocks used by the full tensor apply
+        struct RankStatistics {
+            static const int maxrank = 2*MAXK;
+            std::atomic<bool> enabled;
+            std::atomic<long> dense[maxrank+1];     ///< blocks applied as full matrices, by epsilon-rank
+            std::atomic<long> lowrank[maxrank+1];   ///< blocks applied in factored form, by rank
+            std::atomic<long> flops_dense;          ///< estimated multiply-adds if all blocks were dense
+            std::atomic<long> flops;                ///< estimated multiply-adds of the chosen forms
+
+            RankStatistics() : enabled(false) {reset();}
+
+            RankStatistics(const RankStatistics& other) : enabled(other.enabled.load()) {
+                for (int r=0; r<=maxrank; ++r) {
+                    dense[r].store(other.dense[r].load());
+                    lowrank[r].store(other.lowrank[r].load());
+                }
+                flops_dense.store(other.flops_dense.load());
+                flops.store(other.flops.load());
+            }
+
+            void reset() {
+                for (int r=0; r<=maxrank; ++r) {
+                    dense[r].store(0);
+                    lowrank[r].store(0);
+                }
+                flops_dense.store(0);
+                flops.store(0);
+            }
+        };
+        mutable RankStatistics rank_stats;
+
+        /// Bounds of the NS norms on one level, separable in the two halves of the dimensions
+
+        /// The dimensions are split into [0,NDIM/2) and [NDIM/2,NDIM), e.g. the
+        /// two particles of a pair function.  The displacements of a half are
+        /// numbered lexicographically with translations in [-bmax,bmax].  With
+        /// P_mu the product of max(NSnormf,Tnormf) of the 1D blocks of term mu
+        /// over the dimensions of a half, munorm2_ns is at most scale*P_mu
+        /// (first half) * P_mu (second half), hence the norm of a displacement
+        /// is at most scale*min(amax[0]*ssum[1], ssum[0]*amax[1]).
+        struct ParticleBounds {
+            std::vector<double> amax[2];    ///< max over the terms of P_mu
+            std::vector<double> ssum[2];    ///< root of the sum over the terms of (fac_mu*P_mu)^2
+            double amaxmax[2];              ///< max of amax over the displacements of a half
+            double ssummax[2];              ///< max of ssum over the displacements of a half
+            double scale;                   ///< bounds the sum of the ratios of munorm2_ns
+        };
+
+        /// ParticleBounds of each level, made on demand
+        struct ParticleBoundTable {
+            static const int maxlevel = 64;
+            Mutex mutex;
+            std::shared_ptr<const ParticleBounds> bounds[maxlevel];
+            std::vector<std::size_t> position;  ///< index in get_disp of the displacements in lexicographic order
+            bool disabled;                      ///< the displacements are not a full box
+
+            ParticleBoundTable() : disabled(false) {}
+
+            // The bounds are not copied but made again on demand
+            ParticleBoundTable(const ParticleBoundTable& other) : disabled(false) {}
+        };
+        mutable ParticleBoundTable particle_bounds;
+
+        /// Counts of the displacements screened by screened_disp
+        struct ScreeningStatistics {
+            std::atomic<long> listed;       ///< displacements in the lists that were screened
+            std::atomic<long> touched;      ///< displacements whose individual bound was evaluated
+            std::atomic<long> kept;         ///< displacements returned
+            std::atomic<long> used;         ///< displacements applied, as counted by the caller
+
+            ScreeningStatistics() {reset();}
+
+            ScreeningStatistics(const ScreeningStatistics& other) {
+                listed.store(other.listed.load());
+                touched.store(other.touched.load());
+                kept.store(other.kept.load());
+                used.store(other.used.load());
+            }
+
+            void reset() {
+                listed.store(0);
+                touched.store(0);
+                kept.store(0);
+                used.store(0);
+            }
+        };
+        mutable ScreeningStatistics screen_stats;
+
+        /// Return the ParticleBounds of level n, or null if the displacements are not a full box
+        std::shared_ptr<const ParticleBounds> get_particle_bounds(Level n) const {
+            MADNESS_ASSERT(n < ParticleBoundTable::maxlevel);
+            ScopedMutex<Mutex> guard(particle_bounds.mutex);
+            if (particle_bounds.disabled) return std::shared_ptr<const ParticleBounds>();
+            if (particle_bounds.bounds[n]) return particle_bounds.bounds[n];
+
+            const int bmax = Displacements<NDIM>::bmax_default();
+            const long nb = 2*bmax + 1;
+            const std::size_t half = NDIM/2;
+            const std::size_t dlo[2] = {0, half};
+            const std::size_t dhi[2] = {half, NDIM};
+            long m[2] = {1, 1};
+            for (int h=0; h<2; ++h)
+                for (std::size_t d=dlo[h]; d<dhi[h]; ++d) m[h] *= nb;
+
+            // Map the lexicographic numbering to the (distance sorted) order of get_disp
+            if (particle_bounds.position.empty()) {
+                const std::vector< Key<NDIM> >& disp = get_disp(n);
+                if (long(disp.size()) != m[0]*m[1]) {
+                    particle_bounds.disabled = true;
+                    return std::shared_ptr<const ParticleBounds>();
+                }
+                std::vector<std::size_t> position(disp.size());
+                for (std::size_t i=0; i<disp.size(); ++i) {
+                    long lex = 0;
+                    for (std::size_t d=0; d<NDIM; ++d) {
+                        const Translation l = disp[i].translation()[d];
+                        if (l < -bmax || l > bmax) {
+                            particle_bounds.disabled = true;
+                            return std::shared_ptr<const ParticleBounds>();
+                        }
+                        lex = lex*nb + (l + bmax);
+                    }
+                    position[lex] = i;
+                }
+                particle_bounds.position.swap(position);
+            }
+
+            // The 1D bounds max(NSnormf,Tnormf) of each term, dimension and translation
+            std::vector<double> b1d(rank*NDIM*nb);
+            for (int mu=0; mu<rank; ++mu) {
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    for (long l=-bmax; l<=bmax; ++l) {
+                        const ConvolutionData1D<Q>* op = ops[mu].getop(d)->nonstandard(n, l);
+                        b1d[(mu*NDIM + d)*nb + l + bmax] = std::max(op->NSnormf, op->Tnormf);
+                    }
+                }
+            }
+
+            std::shared_ptr<ParticleBounds> pb(new ParticleBounds);
+            pb->scale = n ? double(NDIM) : 1.0;
+            for (int h=0; h<2; ++h) {
+                pb->amax[h].assign(m[h], 0.0);
+                pb->ssum[h].assign(m[h], 0.0);
+                pb->amaxmax[h] = pb->ssummax[h] = 0.0;
+                for (long i=0; i<m[h]; ++i) {
+                    double amax = 0.0, ssum = 0.0;
+                    for (int mu=0; mu<rank; ++mu) {
+                        double prod = 1.0;
+                        long rest = i;
+                        for (std::size_t d=dhi[h]; d>dlo[h]; --d) {
+                            prod *= b1d[(mu*NDIM + d-1)*nb + rest%nb];
+                            rest /= nb;
+                        }
+                        const double fprod = std::abs(ops[mu].getfac())*prod;
+                        amax = std::max(amax, prod);
+                        ssum += fprod*fprod;
+                    }
+                    pb->amax[h][i] = amax;
+                    pb->ssum[h][i] = sqrt(ssum);
+                    pb->amaxmax[h] = std::max(pb->amaxmax[h], amax);
+                    pb->ssummax[h] = std::max(pb->ssummax[h], pb->ssum[h][i]);
+                }
+            }
+            particle_bounds.bounds[n] = pb;
+            return pb;
+        }
 
     public:
 
@@ -173,10 +345,18 @@ namespace madness {
         };
 
         /// too lazy for extended calling lists
-        struct Transformation {
+        template <typename qT>
+        struct TransformationT {
             long r;             // Effective rank of transformation
-            const Q* U;         // Ptr to matrix
-            const Q* VT;
+            const qT* U;        // Ptr to matrix
+            const qT* VT;
+        };
+        typedef TransformationT<Q> Transformation;
+
+        /// Single precision input and workspace of the mixed precision apply
+        struct FloatApply {
+            Tensor<float> f, f0;                ///< the input coefficients and their s0 part
+            std::vector< Tensor<float> > work;
         };
 
 //        /// return the right block of the upsampled operator (modified NS only)
@@ -213,14 +393,17 @@ namespace madness {
 
 
         /// accumulate into result
-        template <typename T, typename R>
+
+        /// The transformations, input and workspace are either all in the
+        /// precision of the operator or all in single precision
+        template <typename T, typename R, typename qT, typename resultT>
         void apply_transformation(long dimk,
-                                  const Transformation trans[NDIM],
+                                  const TransformationT<qT> trans[NDIM],
                                   const Tensor<T>& f,
                                   Tensor<R>& work1,
                                   Tensor<R>& work2,
                                   const Q mufac,
-                                  Tensor<R>& result) const {
+                                  Tensor<resultT>& result) const {
 
             //PROFILE_MEMBER_FUNC(SeparatedConvolution); // Too fine grain for routine profiling
             long size = 1;
@@ -230,6 +413,19 @@ namespace madness {
             R* restrict w1=work1.ptr();
             R* restrict w2=work2.ptr();
 
+            // At full rank in every dimension use the transform specialized
+            // for (dimk, NDIM) if there is one
+            bool full_rank = true;
+            const qT* U[NDIM];
+            for (std::size_t d=0; d<NDIM; ++d) {
+                full_rank = full_rank && (trans[d].r == dimk) && !trans[d].VT;
+                U[d] = trans[d].U;
+            }
+            if (full_rank && fast_transform_fixed(dimk, NDIM, f.ptr(), U, w1, w2)) {
+                aligned_axpy(size, result.ptr(), w1, mufac);
+                return;
+            }
+
 #ifdef HAVE_IBMBGQ
             mTxmq_padding(dimi, trans[0].r, dimk, dimk, w1, f.ptr(), trans[0].U);
 #else
@@ -275,6 +471,112 @@ namespace madness {
         }
 
 
+        /// The 1D transformations of one separated term for one displacement of a batch
+        template <typename qT>
+        struct BatchTermT {
+            long shift;                     ///< Index of the displacement in the batch
+            TransformationT<qT> trans[NDIM];
+        };
+        typedef BatchTermT<Q> BatchTerm;
+
+        /// Orders batch terms so that those with the same leading transformations are adjacent
+        template <typename qT>
+        static bool batch_order(const BatchTermT<qT>& a, const BatchTermT<qT>& b) {
+            for (std::size_t d=0; d<NDIM; ++d) {
+                if (a.trans[d].U != b.trans[d].U) return std::less<const qT*>()(a.trans[d].U, b.trans[d].U);
+                if (a.trans[d].r != b.trans[d].r) return a.trans[d].r < b.trans[d].r;
+            }
+            return a.shift < b.shift;
+        }
+
+        /// apply_transformation for one separated term and several displacements
+
+        /// The terms are sorted so that the passes over the leading dimensions
+        /// that have the same transformation as the previous term are not
+        /// repeated: the result of the pass over dimension \c d is kept in
+        /// \c work[d] until a term differs in a dimension up to \c d.
+        /// @param[in]  dimk    the size of each dimension of \c f
+        /// @param[in]  terms   the transformations, reordered on return
+        /// @param[in]  f       the input coefficients
+        /// @param      work    NDIM+1 tensors of the size of \c f
+        /// @param[in]  mufac   the factor of the separated term
+        /// @param[in,out] results  one result per displacement, accumulated into
+        template <typename T, typename R, typename qT, typename resultT>
+        void apply_transformation_batch(long dimk,
+                                        std::vector< BatchTermT<qT> >& terms,
+                                        const Tensor<T>& f,
+                                        std::vector< Tensor<R> >& work,
+                                        const Q mufac,
+                                        std::vector< Tensor<resultT> >& results) const {
+
+            std::sort(terms.begin(), terms.end(), batch_order<qT>);
+
+            long size0 = 1;
+            for (std::size_t i=0; i<NDIM; ++i) size0 *= dimk;
+            long sizes[NDIM];               // size after the pass over each dimension
+
+            const BatchTermT<qT>* prev = 0;
+            for (typename std::vector< BatchTermT<qT> >::const_iterator it=terms.begin(); it!=terms.end(); ++it) {
+                const TransformationT<qT>* trans = it->trans;
+
+                // The last pass is always redone since the VT passes overwrite its result
+                std::size_t d0 = 0;
+                if (prev) {
+                    while (d0<NDIM-1 && prev->trans[d0].U==trans[d0].U && prev->trans[d0].r==trans[d0].r) ++d0;
+                }
+                for (std::size_t d=d0; d<NDIM; ++d) {
+                    const long size = d ? sizes[d-1] : size0;
+                    const long dimi = size/dimk;
+                    if (d == 0) {
+#ifdef HAVE_IBMBGQ
+                        mTxmq_padding(dimi, trans[0].r, dimk, dimk, work[0].ptr(), f.ptr(), trans[0].U);
+#else
+                        mTxmq(dimi, trans[0].r, dimk, work[0].ptr(), f.ptr(), trans[0].U, dimk);
+#endif
+                    }
+                    else {
+#ifdef HAVE_IBMBGQ
+                        mTxmq_padding(dimi, trans[d].r, dimk, dimk, work[d].ptr(), work[d-1].ptr(), trans[d].U);
+#else
+                        mTxmq(dimi, trans[d].r, dimk, work[d].ptr(), work[d-1].ptr(), trans[d].U, dimk);
+#endif
+                    }
+                    sizes[d] = trans[d].r * size / dimk;
+                }
+                prev = &*it;
+
+                long size = sizes[NDIM-1];
+                long dimi = size/dimk;
+                R* restrict w1=work[NDIM-1].ptr();
+                R* restrict w2=work[NDIM].ptr();
+
+                // If all blocks are full rank we can skip the transposes
+                bool doit = false;
+                for (std::size_t d=0; d<NDIM; ++d) doit = doit || trans[d].VT;
+
+                if (doit) {
+                    for (std::size_t d=0; d<NDIM; ++d) {
+                        if (trans[d].VT) {
+                            dimi = size/trans[d].r;
+#ifdef HAVE_IBMBGQ
+                            mTxmq_padding(dimi, dimk, trans[d].r, dimk, w2, w1, trans[d].VT);
+#else
+                            mTxmq(dimi, dimk, trans[d].r, w2, w1, trans[d].VT);
+#endif
+                            size = dimk*size/trans[d].r;
+                        }
+                        else {
+                            fast_transpose(dimk, dimi, w1, w2);
+                        }
+                        std::swap(w1,w2);
+                    }
+                }
+                // Assuming here that result is contiguous and aligned
+                aligned_axpy(size, results[it->shift].ptr(), w1, mufac);
+            }
+        }
+
+
         /// accumulate into result
         template <typename T, typename R>
         void apply_transformation3(const Tensor<T> trans2[NDIM],
@@ -352,6 +654,175 @@ namespace madness {
         }
 
 
+        /// Estimate the multiply-adds of apply_transformation
+
+        /// @param[in]  dimk    the size of each dimension
+        /// @param[in]  r       the rank of the block of each dimension
+        /// @param[in]  lowrank bit d is set if dimension d uses the factored block,
+        ///                     otherwise the full matrix
+        static double transformation_cost(long dimk, const long r[NDIM], unsigned lowrank) {
+            double size = 1.0;
+            for (std::size_t d=0; d<NDIM; ++d) size *= dimk;
+            double cost = 0.0;
+            for (std::size_t d=0; d<NDIM; ++d) {
+                const long rd = (lowrank & (1u<<d)) ? r[d] : dimk;
+                cost += size*rd;
+                size = size*rd/dimk;
+            }
+            // The second pass applies VT or transposes, which costs about
+            // as much as a multiply-add per element
+            if (lowrank) {
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    if (lowrank & (1u<<d)) {
+                        cost += size*dimk;
+                        size = size*dimk/r[d];
+                    }
+                    else {
+                        cost += size;
+                    }
+                }
+            }
+            return cost;
+        }
+
+        /// Choose the 1D transformations of the R or T block of one separated term
+
+        /// For each dimension find the rank at which the singular values of
+        /// the block drop below the tolerance.  If
+        /// FunctionDefaults::get_apply_rank_by_flops() the dense or factored
+        /// form of each block is chosen so that the estimated operation
+        /// count of the term is least, otherwise the full matrix is used if
+        /// the rank is above a fixed break even point.
+        /// @param[in]      t_term  true for the T block (dimension k), else the R block
+        /// @param[in]      ops_1d  the 1D blocks of the term
+        /// @param[in,out]  tol     tolerance, made relative to the norm of the block
+        ///                         if the block is not negligible
+        /// @param[out]     trans   the transformations
+        /// @return         false if the block is negligible or of rank zero
+        bool select_transformations(bool t_term, const ConvolutionData1D<Q>* const ops_1d[NDIM],
+                                    double& tol, Transformation trans[NDIM]) const {
+            double norm = 1.0;
+            for (std::size_t d=0; d<NDIM; ++d) norm *= t_term ? ops_1d[d]->Tnorm : ops_1d[d]->Rnorm;
+            if (t_term ? !(norm > 0.0) : !(norm > 1.e-20)) return false;
+
+            tol = tol/(norm*NDIM);  // Errors are relative within here
+
+            // Determine rank of SVD to use or if to use the full matrix
+            long dimk = k;
+            if (!t_term && !modified()) dimk = 2*k;
+
+            long rank[NDIM];
+            for (std::size_t d=0; d<NDIM; ++d) {
+                const Tensor<double>& s = t_term ? ops_1d[d]->Ts : ops_1d[d]->Rs;
+                long r;
+                for (r=0; r<dimk; ++r) {
+                    if (s[r] < tol) break;
+                }
+                //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
+                if (r == 0) return false;
+                rank[d] = r;
+            }
+
+            unsigned lowrank = 0;           // bit d is set if dimension d is factored
+            if (FunctionDefaults<NDIM>::get_apply_rank_by_flops()) {
+                // Try all combinations; ties go to the dense form
+                double best = transformation_cost(dimk, rank, 0);
+                for (unsigned mask=1; mask<(1u<<NDIM); ++mask) {
+                    bool useful = true;
+                    for (std::size_t d=0; d<NDIM; ++d) useful = useful && (!(mask & (1u<<d)) || rank[d] < dimk);
+                    if (!useful) continue;
+                    const double cost = transformation_cost(dimk, rank, mask);
+                    if (cost < best) {
+                        best = cost;
+                        lowrank = mask;
+                    }
+                }
+            }
+            else {
+                long break_even;
+                if (NDIM==1) break_even = long(0.5*dimk);
+                else if (NDIM==2) break_even = long(0.6*dimk);
+                else if (NDIM==3) break_even=long(0.65*dimk);
+                else break_even=long(0.7*dimk);
+                for (std::size_t d=0; d<NDIM; ++d)
+                    if (rank[d] < break_even) lowrank |= (1u<<d);
+            }
+
+            for (std::size_t d=0; d<NDIM; ++d) {
+                if (lowrank & (1u<<d)) {
+                    trans[d].r = rank[d];
+                    trans[d].U = t_term ? ops_1d[d]->TU.ptr() : ops_1d[d]->RU.ptr();
+                    trans[d].VT = t_term ? ops_1d[d]->TVT.ptr() : ops_1d[d]->RVT.ptr();
+                }
+                else {
+                    trans[d].r = dimk;
+                    trans[d].U = t_term ? ops_1d[d]->T.ptr() : ops_1d[d]->R.ptr();
+                    trans[d].VT = 0;
+                }
+            }
+
+            if (rank_stats.enabled.load(std::memory_order_relaxed)) {
+                for (std::size_t d=0; d<NDIM; ++d) {
+                    std::atomic<long>* count = (lowrank & (1u<<d)) ? rank_stats.lowrank : rank_stats.dense;
+                    count[std::min<long>(rank[d], RankStatistics::maxrank)].fetch_add(1, std::memory_order_relaxed);
+                }
+                rank_stats.flops_dense.fetch_add(long(transformation_cost(dimk, rank, 0)), std::memory_order_relaxed);
+                rank_stats.flops.fetch_add(long(transformation_cost(dimk, rank, lowrank)), std::memory_order_relaxed);
+            }
+            return true;
+        }
+
+        /// The single precision copies of transformations made by select_transformations
+
+        /// @return false if a block has no single precision copy, see ConvolutionData1D::make_float
+        static bool float_transformations(const ConvolutionData1D<Q>* const ops_1d[NDIM],
+                                          const Transformation trans[NDIM],
+                                          TransformationT<float> ftrans[NDIM]) {
+            for (std::size_t d=0; d<NDIM; ++d) {
+                const ConvolutionData1D<Q>& op = *ops_1d[d];
+                const Q* U = trans[d].U;
+                ftrans[d].r = trans[d].r;
+                if (U == op.R.ptr()) ftrans[d].U = op.Rf.ptr();
+                else if (U == op.T.ptr()) ftrans[d].U = op.Tf.ptr();
+                else if (U == op.RU.ptr()) ftrans[d].U = op.RUf.ptr();
+                else ftrans[d].U = op.TUf.ptr();
+                if (!trans[d].VT) ftrans[d].VT = 0;
+                else if (trans[d].VT == op.RVT.ptr()) ftrans[d].VT = op.RVTf.ptr();
+                else ftrans[d].VT = op.TVTf.ptr();
+                if (!ftrans[d].U || (trans[d].VT && !ftrans[d].VT)) return false;
+            }
+            return true;
+        }
+
+        /// Return true if apply() uses the single precision blocks, see FunctionDefaults::set_apply_float_thresh
+        static bool use_float_apply() {
+            const double thresh = FunctionDefaults<NDIM>::get_apply_float_thresh();
+            return thresh > 0.0 && FunctionDefaults<NDIM>::get_thresh() >= thresh;
+        }
+
+        /// Prepare the mixed precision apply of real coefficients
+
+        /// @param[in]  f       the input coefficients
+        /// @param[in]  f0      the s0 part of the input
+        /// @param[in]  nwork   the number of workspace tensors
+        /// @param[out] fa      the input in single precision and the workspace
+        /// @return     false if the operator is not applied in mixed precision
+        template <typename T>
+        bool make_float_apply(const Tensor<T>& f, const Tensor<T>& f0, std::size_t nwork,
+                              FloatApply& fa) const {
+            return false;
+        }
+
+        bool make_float_apply(const Tensor<double>& f, const Tensor<double>& f0, std::size_t nwork,
+                              FloatApply& fa) const {
+            if (!std::is_same<Q,double>::value || !use_float_apply()) return false;
+            fa.f = detail::to_float(f);
+            fa.f0 = detail::to_float(f0);
+            fa.work.resize(nwork);
+            for (std::size_t i=0; i<nwork; ++i) fa.work[i] = Tensor<float>(f.ndim(), f.dims(), false);
+            return true;
+        }
+
         /// Apply one of the separated terms, accumulating into the result
         template <typename T>
         void muopxv_fast(ApplyTerms at,
@@ -362,101 +833,30 @@ namespace madness {
                          double tol,
                          const Q mufac,
                          Tensor<TENSOR_RESULT_TYPE(T,Q)>& work1,
-                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& work2) const {
+                         Tensor<TENSOR_RESULT_TYPE(T,Q)>& work2,
+                         FloatApply* fa=0) const {
 
             //PROFILE_MEMBER_FUNC(SeparatedConvolution); // Too fine grain for routine profiling
             Transformation trans[NDIM];
-            Tensor<T> trans2[NDIM];
-
-            double Rnorm = 1.0;
-            for (std::size_t d=0; d<NDIM; ++d) Rnorm *= ops_1d[d]->Rnorm;
+            TransformationT<float> ftrans[NDIM];
 
-            if (at.r_term and (Rnorm > 1.e-20)) {
-
-                tol = tol/(Rnorm*NDIM);  // Errors are relative within here
-
-                // Determine rank of SVD to use or if to use the full matrix
+            if (at.r_term and select_transformations(false, ops_1d, tol, trans)) {
                 long twok = 2*k;
                 if (modified()) twok=k;
-
-                long break_even;
-                if (NDIM==1) break_even = long(0.5*twok);
-                else if (NDIM==2) break_even = long(0.6*twok);
-                else if (NDIM==3) break_even=long(0.65*twok);
-                else break_even=long(0.7*twok);
-                bool rank_is_zero = false;
-                for (std::size_t d=0; d<NDIM; ++d) {
-                    long r;
-                    for (r=0; r<twok; ++r) {
-                        if (ops_1d[d]->Rs[r] < tol) break;
-                    }
-                    if (r >= break_even) {
-                        trans[d].r = twok;
-                        trans[d].U = ops_1d[d]->R.ptr();
-                        trans[d].VT = 0;
-                    }
-                    else {
-                        //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
-                        if (r == 0) {
-                            rank_is_zero = true;
-                            break;
-                        }
-                        trans[d].r = r;
-                        trans[d].U = ops_1d[d]->RU.ptr();
-                        trans[d].VT = ops_1d[d]->RVT.ptr();
-                    }
-                    trans2[d]=ops_1d[d]->R;
-                }
-
-                if (!rank_is_zero)
+                if (fa and float_transformations(ops_1d, trans, ftrans))
+                    apply_transformation(twok, ftrans, fa->f, fa->work[0], fa->work[1], mufac, result);
+                else
                     apply_transformation(twok, trans, f, work1, work2, mufac, result);
-
-                //            apply_transformation2(n, twok, tol, trans2, f, work1, work2, mufac, result);
-//                apply_transformation3(trans2, f, mufac, result);
             }
 
-            double Tnorm = 1.0;
-            for (std::size_t d=0; d<NDIM; ++d) Tnorm *= ops_1d[d]->Tnorm;
-
-            if (at.t_term and (Tnorm>0.0)) {
-                tol = tol/(Tnorm*NDIM);  // Errors are relative within here
-
-                long break_even;
-                if (NDIM==1) break_even = long(0.5*k);
-                else if (NDIM==2) break_even = long(0.6*k);
-                else if (NDIM==3) break_even=long(0.65*k);
-                else break_even=long(0.7*k);
-                bool rank_is_zero = false;
-                for (std::size_t d=0; d<NDIM; ++d) {
-                    long r;
-                    for (r=0; r<k; ++r) {
-                        if (ops_1d[d]->Ts[r] < tol) break;
-                    }
-                    if (r >= break_even) {
-                        trans[d].r = k;
-                        trans[d].U = ops_1d[d]->T.ptr();
-                        trans[d].VT = 0;
-                    }
-                    else {
-                        //r = std::max(2L,r+(r&1L)); // NOLONGER NEED TO FORCE OPERATOR RANK TO BE EVEN
-                        if (r == 0) {
-                            rank_is_zero = true;
-                            break;
-                        }
-                        trans[d].r = r;
-                        trans[d].U = ops_1d[d]->TU.ptr();
-                        trans[d].VT = ops_1d[d]->TVT.ptr();
-                    }
-                    trans2[d]=ops_1d[d]->T;
-                }
-                if (!rank_is_zero)
+            if (at.t_term and select_transformations(true, ops_1d, tol, trans)) {
+                if (fa and float_transformations(ops_1d, trans, ftrans))
+                    apply_transformation(k, ftrans, fa->f0, fa->work[0], fa->work[1], -mufac, result0);
+                else
                     apply_transformation(k, trans, f0, work1, work2, -mufac, result0);
-//                apply_transformation2(n, k, tol, trans2, f0, work1, work2, -mufac, result0);
-//                apply_transformation3(trans2, f0, -mufac, result0);
             }
         }
 
-
         /// Apply one of the separated terms, accumulating into the result
         template <typename T>
         void muopxv_fast2(Level n,
@@ -1034,6 +1434,34 @@ namespace madness {
         	}
         }
 
+        /// Start or stop counting the ranks of the 1D blocks used by the full tensor apply
+        void collect_rank_statistics(bool value) const {
+            rank_stats.enabled.store(value);
+        }
+
+        /// Clear the counts of the ranks of the 1D blocks
+        void reset_rank_statistics() const {
+            rank_stats.reset();
+        }
+
+        /// Return the estimated multiply-adds of the counted terms with the chosen and with dense blocks
+        std::pair<double,double> rank_statistics_flops() const {
+            return std::make_pair(double(rank_stats.flops.load()), double(rank_stats.flops_dense.load()));
+        }
+
+        /// Print the distribution of the ranks of the 1D blocks counted by this process
+        void print_rank_statistics() const {
+            print("rank of 1D operator blocks        dense    low-rank");
+            for (int r=0; r<=RankStatistics::maxrank; ++r) {
+                const long nd = rank_stats.dense[r].load();
+                const long nl = rank_stats.lowrank[r].load();
+                if (nd || nl) printf("   %4d                    %12ld %12ld\n", r, nd, nl);
+            }
+            const std::pair<double,double> f = rank_statistics_flops();
+            print("estimated multiply-adds", f.first, "all dense", f.second,
+                  "ratio", (f.second > 0.0) ? f.first/f.second : 1.0);
+        }
+
         const BoundaryConditions<NDIM>& get_bc() const {return bc;}
 
         const std::vector< Key<NDIM> >& get_disp(Level n) const {
@@ -1047,6 +1475,119 @@ namespace madness {
             return getop(n, d, source_key)->norm;
         }
 
+        /// return the operator norm for displacement idisp of get_disp(n)
+
+        /// Same as norm(n, get_disp(n)[idisp], source_key), but in the NS form
+        /// the norm is looked up in a dense table that is filled in on first use.
+        double disp_norm(Level n, std::size_t idisp, const Key<NDIM>& source_key) const {
+            if (modified()) return getop_modified(n, get_disp(n)[idisp], source_key)->norm;
+            double opnorm = norm_table.get(n, idisp);
+            if (opnorm < 0.0) {
+                const std::vector< Key<NDIM> >& disp = get_disp(n);
+                opnorm = getop_ns(n, disp[idisp])->norm;
+                norm_table.set(n, disp, idisp, opnorm);
+            }
+            return opnorm;
+        }
+
+        /// return the number of operator norms in the screening table
+        std::size_t norm_table_size() const {return norm_table.count();}
+
+        /// return the indices into get_disp(n) of the displacements whose norm may exceed tol
+
+        /// The displacements are screened with the separable bounds of
+        /// ParticleBounds without looking up their norms: first whole blocks
+        /// of displacements that share the translations of the first half of
+        /// the dimensions, then the single displacements of the remaining
+        /// blocks.  All displacements with disp_norm(n,i,source) > tol are
+        /// returned, in the order of get_disp(n).  In the modified NS form
+        /// and for periodic sums nothing is screened.
+        std::vector<std::size_t> screened_disp(Level n, double tol) const {
+            const std::size_t ndisp = get_disp(n).size();
+            std::vector<std::size_t> result;
+            std::shared_ptr<const ParticleBounds> pb;
+            if (not (modified() or isperiodicsum)) pb = get_particle_bounds(n);
+            if (not pb) {
+                result.resize(ndisp);
+                for (std::size_t i=0; i<ndisp; ++i) result[i] = i;
+                screen_stats.listed += ndisp;
+                screen_stats.touched += ndisp;
+                screen_stats.kept += ndisp;
+                return result;
+            }
+
+            // keep a little slack for the rounding of the norms
+            const double t = tol/(pb->scale*(1.0 + 1e-12));
+            const std::vector<double>& a0 = pb->amax[0];
+            const std::vector<double>& s0 = pb->ssum[0];
+            const std::vector<double>& a1 = pb->amax[1];
+            const std::vector<double>& s1 = pb->ssum[1];
+            const std::vector<std::size_t>& position = particle_bounds.position;
+            const std::size_t m0 = a0.size(), m1 = a1.size();
+            long touched = 0;
+            for (std::size_t i0=0; i0<m0; ++i0) {
+                if (std::min(a0[i0]*pb->ssummax[1], s0[i0]*pb->amaxmax[1]) <= t) continue;
+                touched += m1;
+                for (std::size_t i1=0; i1<m1; ++i1) {
+                    if (std::min(a0[i0]*s1[i1], s0[i0]*a1[i1]) > t) result.push_back(position[i0*m1 + i1]);
+                }
+            }
+            std::sort(result.begin(), result.end());
+            screen_stats.listed += ndisp;
+            screen_stats.touched += touched;
+            screen_stats.kept += result.size();
+            return result;
+        }
+
+        /// Count displacements returned by screened_disp that were actually applied
+        void count_used_disp(long n) const {
+            screen_stats.used += n;
+        }
+
+        /// Clear the counts of screened_disp
+        void reset_screening_statistics() const {
+            screen_stats.reset();
+        }
+
+        /// Print the counts of screened_disp of this process
+        void print_screening_statistics() const {
+            const long listed = screen_stats.listed.load();
+            const long touched = screen_stats.touched.load();
+            const long kept = screen_stats.kept.load();
+            const long used = screen_stats.used.load();
+            print("displacements listed", listed, "touched", touched, "kept", kept, "used", used);
+            if (listed) print("fraction touched", double(touched)/listed, "kept", double(kept)/listed,
+                              "used", double(used)/listed);
+        }
+
+        /// identifies this operator in files of the screening table
+
+        /// Besides k and the rank the norms of a few displacements on level 2
+        /// are recorded, which depend on all terms and on the cell.
+        std::vector<double> norm_table_fingerprint() const {
+            std::vector<double> fp;
+            fp.push_back(NDIM);
+            fp.push_back(k);
+            fp.push_back(rank);
+            fp.push_back(isperiodicsum);
+            const std::vector< Key<NDIM> >& disp = get_disp(2);
+            for (std::size_t i=0; i<std::min<std::size_t>(4,disp.size()); ++i)
+                fp.push_back(getop_ns(2, disp[i])->norm);
+            return fp;
+        }
+
+        /// write the screening table of this process to a file
+        void save_norm_table(const std::string& filename) const {
+            norm_table.save(filename, norm_table_fingerprint());
+        }
+
+        /// read the screening table from a file written by save_norm_table
+
+        /// @return false if the file does not exist or was written for another operator
+        bool load_norm_table(const std::string& filename) {
+            return norm_table.load<NDIM>(filename, norm_table_fingerprint(), isperiodicsum);
+        }
+
         /// return that part of a hi-dim key that serves as the base for displacements of this operator
 
         /// if the function and the operator have the same dimension return key
@@ -1160,6 +1701,8 @@ namespace madness {
             }
 
             const Tensor<T> f0 = copy(coeff(s0));
+            FloatApply fa;
+            const bool mixed = make_float_apply(*input, f0, 2, fa);
             for (int mu=0; mu<rank; ++mu) {
                 // SeparatedConvolutionInternal keeps data for 1 term and all dimensions and 1 displacement
                 const SeparatedConvolutionInternal<Q,NDIM>& muop =  op->muops[mu];
@@ -1167,7 +1710,7 @@ namespace madness {
                     // ops is of ConvolutionND, returns data for 1 term and all dimensions
                     Q fac = ops[mu].getfac();
                     muopxv_fast(at, muop.ops, *input, f0, r, r0, tol/std::abs(fac), fac,
-                                work1, work2);
+                                work1, work2, mixed ? &fa : 0);
                 }
             }
 
@@ -1179,6 +1722,113 @@ namespace madness {
         }
 
 
+        /// apply this operator on coefficients in full rank form for several displacements
+
+        /// Gives the same results as calling apply() for each displacement,
+        /// but pads and copies the input and allocates the workspace once,
+        /// and does the passes of the 1D transformations that displacements
+        /// have in common (the same 1D block in the leading dimensions) once.
+        /// @param[in]  source  the source key
+        /// @param[in]  shifts  the displacements, where the source coeffs come from
+        /// @param[in]  coeff   source coeffs in full rank
+        /// @param[in]  tols    thresh/#neigh*cnorm for each displacement
+        /// @return     a tensor of full rank with the result op(coeff) for each displacement
+        template <typename T>
+        std::vector< Tensor<TENSOR_RESULT_TYPE(T,Q)> > apply_batch(const Key<NDIM>& source,
+                                                                   const std::vector< Key<NDIM> >& shifts,
+                                                                   const Tensor<T>& coeff,
+                                                                   const std::vector<double>& tols) const {
+            //PROFILE_MEMBER_FUNC(SeparatedConvolution); // Too fine grain for routine profiling
+            MADNESS_ASSERT(coeff.ndim()==NDIM);
+            MADNESS_ASSERT(shifts.size()==tols.size());
+
+            double cpu0=cpu_time();
+
+            typedef TENSOR_RESULT_TYPE(T,Q) resultT;
+            const Tensor<T>* input = &coeff;
+            Tensor<T> dummy;
+
+            if (not modified()) {
+                if (coeff.dim(0) == k) {
+                    // Leaf nodes with only scaling coefficients, see apply()
+                    dummy = Tensor<T>(v2k);
+                    dummy(s0) = coeff;
+                    input = &dummy;
+                }
+                else {
+                    MADNESS_ASSERT(coeff.dim(0)==2*k);
+                }
+            }
+
+            ApplyTerms at;
+            at.r_term=true;
+            at.t_term=(source.level()>0);
+
+            const long nshift = shifts.size();
+            const std::vector<long>& vr = modified() ? vk : v2k;
+            std::vector<const SeparatedConvolutionData<Q,NDIM>*> op(nshift);
+            std::vector<double> tol(nshift);
+            std::vector< Tensor<resultT> > r(nshift), r0(nshift);
+            for (long s=0; s<nshift; ++s) {
+                op[s] = getop(source.level(), shifts[s], source);
+                tol[s] = 0.01*tols[s]/rank; // Error is per separated term
+                r[s] = Tensor<resultT>(vr);
+                r0[s] = Tensor<resultT>(vk);
+            }
+            std::vector< Tensor<resultT> > work(NDIM+1);
+            for (std::size_t d=0; d<=NDIM; ++d) work[d] = Tensor<resultT>(vr,false);
+
+            const Tensor<T> f0 = copy(coeff(s0));
+            FloatApply fa;
+            const bool mixed = make_float_apply(*input, f0, NDIM+1, fa);
+            long twok = 2*k;
+            if (modified()) twok=k;
+            std::vector<BatchTerm> rterms, tterms;
+            std::vector< BatchTermT<float> > frterms, ftterms;
+            rterms.reserve(nshift);
+            tterms.reserve(nshift);
+            for (int mu=0; mu<rank; ++mu) {
+                const Q fac = ops[mu].getfac();
+                rterms.clear();
+                tterms.clear();
+                frterms.clear();
+                ftterms.clear();
+                for (long s=0; s<nshift; ++s) {
+                    const SeparatedConvolutionInternal<Q,NDIM>& muop =  op[s]->muops[mu];
+                    if (muop.norm > tol[s]) {
+                        // The same sequence of tolerances as in muopxv_fast
+                        double tolmu = tol[s]/std::abs(fac);
+                        BatchTerm term;
+                        BatchTermT<float> fterm;
+                        term.shift = fterm.shift = s;
+                        if (at.r_term and select_transformations(false, muop.ops, tolmu, term.trans)) {
+                            if (mixed and float_transformations(muop.ops, term.trans, fterm.trans))
+                                frterms.push_back(fterm);
+                            else
+                                rterms.push_back(term);
+                        }
+                        if (at.t_term and select_transformations(true, muop.ops, tolmu, term.trans)) {
+                            if (mixed and float_transformations(muop.ops, term.trans, fterm.trans))
+                                ftterms.push_back(fterm);
+                            else
+                                tterms.push_back(term);
+                        }
+                    }
+                }
+                if (!rterms.empty()) apply_transformation_batch(twok, rterms, *input, work, fac, r);
+                if (!tterms.empty()) apply_transformation_batch(long(k), tterms, f0, work, -fac, r0);
+                if (!frterms.empty()) apply_transformation_batch(twok, frterms, fa.f, fa.work, fac, r);
+                if (!ftterms.empty()) apply_transformation_batch(long(k), ftterms, fa.f0, fa.work, -fac, r0);
+            }
+
+            for (long s=0; s<nshift; ++s) r[s](s0).gaxpy(1.0,r0[s],1.0);
+            double cpu1=cpu_time();
+            timer_full.accumulate(cpu1-cpu0);
+
+            return r;
+        }
+
+
         /// apply this operator on only 1 particle of the coefficients in low rank form
 
         /// note the unfortunate mess with NDIM: here NDIM is the operator dimension, and FDIM is the
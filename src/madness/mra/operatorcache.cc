@@ -0,0 +1,277 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file operatorcache.cc
+/// \brief Implements the persistent on-disk cache of 1D operator blocks
+
+#include <madness/mra/operatorcache.h>
+#include <madness/world/worldhash.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace madness {
+
+    namespace {
+
+        const char magic[8] = {'M','A','D','O','P','C','\0','\0'};
+
+        /// Layout of the start of a cache file, followed by the id, the index and the data
+        struct Header {
+            char magic[8];
+            std::int64_t version;
+            std::int64_t idsize;
+            std::int64_t nentry;
+            std::int64_t datasize;
+        };
+
+        Mutex registry_mutex;
+
+        std::string& directory() {
+            static std::string dir(getenv("MAD_OPERATOR_CACHE") ? getenv("MAD_OPERATOR_CACHE") : "");
+            return dir;
+        }
+
+        std::map< std::string, std::weak_ptr<OperatorCacheFile> >& registry() {
+            static std::map< std::string, std::weak_ptr<OperatorCacheFile> > files;
+            return files;
+        }
+
+        void flush_at_exit() {
+            OperatorCacheFile::flush_all();
+        }
+    }
+
+
+    OperatorCacheFile::Mapping::~Mapping() {
+        if (base) munmap(base, length);
+    }
+
+
+    OperatorCacheFile::OperatorCacheFile(const std::string& filename, const idT& id)
+        : filename(filename), id(id), map(map_file()) {}
+
+
+    OperatorCacheFile::~OperatorCacheFile() {
+        flush();
+    }
+
+
+    std::shared_ptr<OperatorCacheFile::Mapping> OperatorCacheFile::map_file() const {
+        std::shared_ptr<Mapping> m(new Mapping);
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return m;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(Header)) {
+            ::close(fd);
+            return m;
+        }
+        void* base = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) return m;
+
+        std::shared_ptr<Mapping> result(new Mapping);
+        result->base = base;
+        result->length = st.st_size;
+
+        const Header* h = static_cast<const Header*>(base);
+        const std::size_t need = sizeof(Header) + sizeof(double)*(h->idsize + h->datasize)
+            + sizeof(Entry)*h->nentry;
+        if (std::memcmp(h->magic, magic, sizeof(magic)) != 0 || h->version != version
+            || h->idsize != std::int64_t(id.size()) || need != result->length) return m;
+
+        const double* fileid = reinterpret_cast<const double*>(h + 1);
+        if (!std::equal(id.begin(), id.end(), fileid)) return m;
+
+        result->index = reinterpret_cast<const Entry*>(fileid + h->idsize);
+        result->nentry = h->nentry;
+        result->data = reinterpret_cast<const double*>(result->index + h->nentry);
+        return result;
+    }
+
+
+    const double* OperatorCacheFile::find(Level n, Translation l, std::size_t& size) const {
+        std::shared_ptr<Mapping> m;
+        {
+            ScopedMutex<Mutex> guard(mutex);
+            m = map;
+        }
+        Entry e;
+        e.n = n;
+        e.l = l;
+        const Entry* end = m->index + m->nentry;
+        const Entry* p = std::lower_bound(m->index, end, e);
+        if (p == end || p->n != e.n || p->l != e.l) return 0;
+        size = p->size;
+        return m->data + p->offset;
+    }
+
+
+    void OperatorCacheFile::insert(Level n, Translation l, const std::vector<double>& data) {
+        Entry e;
+        e.n = n;
+        e.l = l;
+        e.offset = 0;
+        e.size = data.size();
+        ScopedMutex<Mutex> guard(mutex);
+        pending.push_back(std::make_pair(e, data));
+    }
+
+
+    std::size_t OperatorCacheFile::size() const {
+        ScopedMutex<Mutex> guard(mutex);
+        return map->nentry;
+    }
+
+
+    void OperatorCacheFile::flush() {
+        ScopedMutex<Mutex> guard(mutex);
+        if (pending.empty()) return;
+
+        // Merge the index of the file and the pending blocks
+        std::vector< std::pair<Entry, const double*> > blocks;
+        for (std::size_t i=0; i<map->nentry; ++i)
+            blocks.push_back(std::make_pair(map->index[i], map->data + map->index[i].offset));
+        for (std::size_t i=0; i<pending.size(); ++i)
+            blocks.push_back(std::make_pair(pending[i].first, &pending[i].second[0]));
+        std::stable_sort(blocks.begin(), blocks.end(),
+                         [](const std::pair<Entry, const double*>& a, const std::pair<Entry, const double*>& b) {
+                             return a.first < b.first;
+                         });
+
+        std::vector<Entry> index;
+        std::int64_t datasize = 0;
+        for (std::size_t i=0; i<blocks.size(); ++i) {
+            if (!index.empty() && !(index.back() < blocks[i].first)) {   // duplicate
+                blocks[i].second = 0;
+                continue;
+            }
+            Entry e = blocks[i].first;
+            e.offset = datasize;
+            datasize += e.size;
+            index.push_back(e);
+        }
+
+        Header h;
+        std::memcpy(h.magic, magic, sizeof(magic));
+        h.version = version;
+        h.idsize = id.size();
+        h.nentry = index.size();
+        h.datasize = datasize;
+
+        // Write a new file and rename it so that readers never see a partial file
+        std::ostringstream tmpname;
+        tmpname << filename << ".tmp." << getpid() << "." << this;
+        std::FILE* f = std::fopen(tmpname.str().c_str(), "wb");
+        if (!f) return;
+        bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1;
+        ok = ok && std::fwrite(&id[0], sizeof(double), id.size(), f) == id.size();
+        ok = ok && std::fwrite(&index[0], sizeof(Entry), index.size(), f) == index.size();
+        for (std::size_t i=0; ok && i<blocks.size(); ++i) {
+            if (blocks[i].second) {
+                const std::size_t size = blocks[i].first.size;
+                ok = std::fwrite(blocks[i].second, sizeof(double), size, f) == size;
+            }
+        }
+        ok = (std::fclose(f) == 0) && ok;
+        if (!ok || std::rename(tmpname.str().c_str(), filename.c_str()) != 0) {
+            std::remove(tmpname.str().c_str());
+            return;
+        }
+
+        retired.push_back(map);
+        map = map_file();
+        pending.clear();
+    }
+
+
+    std::shared_ptr<OperatorCacheFile> OperatorCacheFile::open(const std::string& prefix, const idT& id) {
+        ScopedMutex<Mutex> guard(registry_mutex);
+        const std::string& dir = directory();
+        if (dir.empty()) return std::shared_ptr<OperatorCacheFile>();
+
+        std::ostringstream name;
+        name << dir << "/" << prefix << "-" << std::hex << hash_range(id.begin(), id.end()) << ".madopc";
+
+        // The registry must exist before the exit handler is registered
+        // so that it is destroyed after the handler ran
+        std::map< std::string, std::weak_ptr<OperatorCacheFile> >& files = registry();
+        static bool registered = false;
+        if (!registered) {
+            std::atexit(flush_at_exit);
+            registered = true;
+        }
+
+        std::weak_ptr<OperatorCacheFile>& entry = files[name.str()];
+        std::shared_ptr<OperatorCacheFile> file = entry.lock();
+        if (file) {
+            if (file->id != id) return std::shared_ptr<OperatorCacheFile>();   // hash collision
+            return file;
+        }
+        file.reset(new OperatorCacheFile(name.str(), id));
+        entry = file;
+        return file;
+    }
+
+
+    std::string OperatorCacheFile::get_directory() {
+        ScopedMutex<Mutex> guard(registry_mutex);
+        return directory();
+    }
+
+
+    void OperatorCacheFile::set_directory(const std::string& dir) {
+        ScopedMutex<Mutex> guard(registry_mutex);
+        directory() = dir;
+    }
+
+
+    void OperatorCacheFile::flush_all() {
+        std::vector< std::shared_ptr<OperatorCacheFile> > files;
+        {
+            ScopedMutex<Mutex> guard(registry_mutex);
+            std::map< std::string, std::weak_ptr<OperatorCacheFile> >::iterator it;
+            for (it=registry().begin(); it!=registry().end(); ++it) {
+                std::shared_ptr<OperatorCacheFile> file = it->second.lock();
+                if (file) files.push_back(file);
+            }
+        }
+        for (std::size_t i=0; i<files.size(); ++i) files[i]->flush();
+    }
+
+}
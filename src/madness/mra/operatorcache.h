@@ -0,0 +1,141 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+#ifndef MADNESS_MRA_OPERATORCACHE_H__INCLUDED
+#define MADNESS_MRA_OPERATORCACHE_H__INCLUDED
+
+/// \file operatorcache.h
+/// \brief Persistent on-disk cache of the blocks of 1D convolution operators
+
+#include <madness/world/worldmutex.h>
+#include <cmath>
+#include <madness/mra/key.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace madness {
+
+    /// Memory-mapped file holding the blocks of one 1D convolution
+
+    /// The blocks of a 1D operator are addressed by level and translation,
+    /// and each block is an array of doubles whose meaning is up to the
+    /// operator.  The operator itself is identified by a vector of doubles
+    /// (type, k, exponent, ...) that is stored in the file, so that a file
+    /// written for another operator is never used.
+    ///
+    /// The file is mapped read-only and is therefore shared by all ranks of
+    /// a node through the page cache.  Blocks computed during the run are
+    /// kept in memory and written by flush(), which merges them with the
+    /// blocks of the file into a new file that atomically replaces the old
+    /// one.  Several processes may flush the same file; each writes a
+    /// complete file and the last rename wins.  All open files are flushed
+    /// at program exit.
+    ///
+    /// The cache is enabled by setting the environment variable
+    /// \c MAD_OPERATOR_CACHE to the directory of the files, or by
+    /// set_directory().
+    class OperatorCacheFile {
+    public:
+        typedef std::vector<double> idT;
+
+    private:
+        static const std::int64_t version = 2;
+
+        /// Index entry of a block in the file
+        struct Entry {
+            std::int64_t n;         ///< level
+            std::int64_t l;         ///< translation
+            std::int64_t offset;    ///< offset of the data in doubles from the start of the data
+            std::int64_t size;      ///< number of doubles
+            bool operator<(const Entry& b) const {return (n < b.n) || (n == b.n && l < b.l);}
+        };
+
+        /// A read-only mapping of a cache file
+        struct Mapping {
+            void* base;
+            std::size_t length;
+            const Entry* index;
+            std::size_t nentry;
+            const double* data;
+            Mapping() : base(0), length(0), index(0), nentry(0), data(0) {}
+            ~Mapping();
+        };
+
+        const std::string filename;
+        const idT id;
+        mutable Mutex mutex;
+        std::shared_ptr<Mapping> map;                       ///< the file as of the last open or flush
+        std::vector< std::shared_ptr<Mapping> > retired;    ///< older mappings that may still be in use
+        std::vector< std::pair<Entry, std::vector<double> > > pending;   ///< blocks not yet in the file
+
+        std::shared_ptr<Mapping> map_file() const;
+
+        OperatorCacheFile(const std::string& filename, const idT& id);
+
+    public:
+        ~OperatorCacheFile();
+
+        /// Return the data of block (n,l) and its size, or null if not in the file
+        const double* find(Level n, Translation l, std::size_t& size) const;
+
+        /// Add block (n,l), to be written by the next flush
+        void insert(Level n, Translation l, const std::vector<double>& data);
+
+        /// Write the blocks of the file and those inserted since into a new file
+        void flush();
+
+        /// Return the name of the file
+        const std::string& name() const {return filename;}
+
+        /// Return the number of blocks in the mapped file
+        std::size_t size() const;
+
+        /// Return the cache file of an operator, or null if the cache is disabled
+
+        /// @param[in] prefix first part of the file name, e.g. the operator type
+        /// @param[in] id identifies the operator and is stored in the file
+        static std::shared_ptr<OperatorCacheFile> open(const std::string& prefix, const idT& id);
+
+        /// Return the directory of the cache, empty if the cache is disabled
+        static std::string get_directory();
+
+        /// Set the directory of the cache, empty to disable it
+
+        /// Only operators constructed afterwards are affected
+        static void set_directory(const std::string& dir);
+
+        /// Flush all open cache files
+        static void flush_all();
+    };
+
+}
+#endif // MADNESS_MRA_OPERATORCACHE_H__INCLUDED
@@ -0,0 +1,224 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+#ifndef MADNESS_MRA_OPNORMTABLE_H__INCLUDED
+#define MADNESS_MRA_OPNORMTABLE_H__INCLUDED
+
+/// \file opnormtable.h
+/// \brief Dense per-level tables of operator norms used for screening
+
+#include <madness/world/worldmutex.h>
+#include <madness/world/worldhash.h>
+#include <madness/world/binary_fstream_archive.h>
+#include <madness/mra/key.h>
+#include <madness/mra/displacements.h>
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace madness {
+
+    /// Dense table of operator norms indexed by level and displacement
+
+    /// The displacements of a level are those of Displacements::get_disp
+    /// and are addressed by their position in that list, so that screening
+    /// is an array lookup instead of a hash lookup of the operator.  The
+    /// table of a level is allocated on first use and the entries are
+    /// filled in lazily; a negative entry has not yet been computed.
+    /// Several threads may fill in the same entry, but always with the same
+    /// value.
+    ///
+    /// The table can be saved to and loaded from disk so that subsequent
+    /// runs start warm.  The file records a fingerprint of the operator and
+    /// a hash of the displacement list of each level, and a table that does
+    /// not match is not loaded.
+    class OperatorNormTable {
+    public:
+        static const int max_level = 64;
+
+    private:
+        static const int version = 1;
+
+        mutable Mutex mutex;
+        std::atomic<std::atomic<double>*> table[max_level];  ///< norms of each level
+        std::size_t size[max_level];                          ///< #displacements of each level
+        hashT disphash[max_level];                            ///< hash of the displacements of each level
+
+        void init() {
+            for (int n=0; n<max_level; ++n) {
+                table[n].store(0, std::memory_order_relaxed);
+                size[n] = 0;
+                disphash[n] = 0;
+            }
+        }
+
+        /// allocate the table of a level, set to "not computed"
+        template <std::size_t NDIM>
+        std::atomic<double>* allocate(Level n, const std::vector< Key<NDIM> >& disp) {
+            ScopedMutex<Mutex> guard(mutex);
+            std::atomic<double>* t = table[n].load(std::memory_order_acquire);
+            if (t) return t;
+
+            t = new std::atomic<double>[disp.size()];
+            for (std::size_t i=0; i<disp.size(); ++i) t[i].store(-1.0, std::memory_order_relaxed);
+            hashT h = 0;
+            for (std::size_t i=0; i<disp.size(); ++i) hash_combine(h, disp[i].hash());
+            size[n] = disp.size();
+            disphash[n] = h;
+            table[n].store(t, std::memory_order_release);
+            return t;
+        }
+
+    public:
+        OperatorNormTable() {
+            init();
+        }
+
+        OperatorNormTable(const OperatorNormTable& other) {
+            init();
+            *this = other;
+        }
+
+        OperatorNormTable& operator=(const OperatorNormTable& other) {
+            if (this == &other) return *this;
+            clear();
+            ScopedMutex<Mutex> guard(other.mutex);
+            for (int n=0; n<max_level; ++n) {
+                const std::atomic<double>* s = other.table[n].load(std::memory_order_acquire);
+                if (!s) continue;
+                std::atomic<double>* t = new std::atomic<double>[other.size[n]];
+                for (std::size_t i=0; i<other.size[n]; ++i)
+                    t[i].store(s[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                size[n] = other.size[n];
+                disphash[n] = other.disphash[n];
+                table[n].store(t, std::memory_order_release);
+            }
+            return *this;
+        }
+
+        ~OperatorNormTable() {
+            clear();
+        }
+
+        /// Discard all tables; not safe against concurrent lookups
+        void clear() {
+            for (int n=0; n<max_level; ++n) {
+                delete [] table[n].load(std::memory_order_acquire);
+                table[n].store(0, std::memory_order_relaxed);
+                size[n] = 0;
+            }
+        }
+
+        /// Return the norm of displacement i of level n, or a negative number if not yet known
+        inline double get(Level n, std::size_t i) const {
+            const std::atomic<double>* t = table[n].load(std::memory_order_acquire);
+            if (!t) return -1.0;
+            return t[i].load(std::memory_order_relaxed);
+        }
+
+        /// Set the norm of displacement i of the displacements disp of level n
+        template <std::size_t NDIM>
+        void set(Level n, const std::vector< Key<NDIM> >& disp, std::size_t i, double norm) {
+            MADNESS_ASSERT(n>=0 && n<max_level && i<disp.size());
+            std::atomic<double>* t = table[n].load(std::memory_order_acquire);
+            if (!t) t = allocate(n, disp);
+            t[i].store(norm, std::memory_order_relaxed);
+        }
+
+        /// Return the number of norms that have been computed
+        std::size_t count() const {
+            std::size_t num = 0;
+            for (int n=0; n<max_level; ++n) {
+                const std::atomic<double>* t = table[n].load(std::memory_order_acquire);
+                if (!t) continue;
+                for (std::size_t i=0; i<size[n]; ++i)
+                    if (t[i].load(std::memory_order_relaxed) >= 0.0) ++num;
+            }
+            return num;
+        }
+
+        /// Write the tables to a file
+
+        /// @param[in] filename the name of the file
+        /// @param[in] fingerprint identifies the operator the norms belong to
+        void save(const std::string& filename, const std::vector<double>& fingerprint) const {
+            archive::BinaryFstreamOutputArchive ar(filename.c_str());
+            ScopedMutex<Mutex> guard(mutex);
+            const int ver = version;
+            ar & ver & fingerprint;
+            for (int n=0; n<max_level; ++n) {
+                const std::atomic<double>* t = table[n].load(std::memory_order_acquire);
+                if (!t) continue;
+                std::vector<double> norms(size[n]);
+                for (std::size_t i=0; i<size[n]; ++i) norms[i] = t[i].load(std::memory_order_relaxed);
+                ar & n & disphash[n] & norms;
+            }
+            ar & int(-1);
+        }
+
+        /// Read the tables written by save, keeping norms that are already known
+
+        /// @param[in] filename the name of the file
+        /// @param[in] fingerprint must match the fingerprint the file was written with
+        /// @param[in] isperiodicsum selects the displacements of the operator
+        /// @return false if the file does not exist or belongs to another operator
+        template <std::size_t NDIM>
+        bool load(const std::string& filename, const std::vector<double>& fingerprint, bool isperiodicsum) {
+            if (!std::ifstream(filename.c_str())) return false;
+            archive::BinaryFstreamInputArchive ar(filename.c_str());
+            int ver;
+            std::vector<double> fp;
+            ar & ver & fp;
+            if (ver != version || fp != fingerprint) return false;
+            while (true) {
+                int n;
+                ar & n;
+                if (n < 0) break;
+                MADNESS_ASSERT(n < max_level);
+                hashT h;
+                std::vector<double> norms;
+                ar & h & norms;
+                const std::vector< Key<NDIM> >& d = Displacements<NDIM>().get_disp(n, isperiodicsum);
+                if (norms.size() != d.size()) continue;
+                std::atomic<double>* t = table[n].load(std::memory_order_acquire);
+                if (!t) t = allocate(n, d);
+                if (disphash[n] != h) continue;     // displacements ordered differently
+                for (std::size_t i=0; i<norms.size(); ++i) {
+                    if (norms[i] >= 0.0 && t[i].load(std::memory_order_relaxed) < 0.0)
+                        t[i].store(norms[i], std::memory_order_relaxed);
+                }
+            }
+            return true;
+        }
+    };
+
+}
+#endif // MADNESS_MRA_OPNORMTABLE_H__INCLUDED
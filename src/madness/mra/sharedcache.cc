@@ -0,0 +1,298 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file sharedcache.cc
+/// \brief Implements the node-level cache of operator blocks in shared memory
+
+#include <madness/mra/sharedcache.h>
+#include <madness/world/MADworld.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace madness {
+
+    namespace {
+
+        const char magic[8] = {'M','A','D','S','H','M','\0','\0'};
+
+        const std::size_t alignment = 64;
+
+        std::size_t round_up(std::size_t n) {
+            return (n + alignment - 1)/alignment*alignment;
+        }
+
+        enum SlotState {EMPTY=0, BUSY=1, READY=2, FAILED=3};
+
+        /// Start of the segment
+        struct Header {
+            char magic[8];
+            std::atomic<std::int64_t> ready;    ///< set once the creator initialized the header
+            std::int64_t nslot;
+            std::int64_t capacity;              ///< bytes of the data region
+            std::atomic<std::int64_t> used;     ///< bytes of the data region allocated
+            std::atomic<std::int64_t> nentry;
+        };
+
+        /// Entry of the hash table; the key is valid once the state is READY
+        struct Slot {
+            std::atomic<std::uint32_t> state;
+            std::int32_t kind;
+            std::int32_t n;
+            std::int32_t pad;
+            std::uint64_t op;
+            std::int64_t l;
+            std::int64_t extra;
+            std::int64_t offset;    ///< bytes from the start of the data region
+            std::int64_t size;      ///< doubles
+        };
+
+        /// A mapped segment
+        struct Segment {
+            void* base;
+            std::size_t length;
+            Header* header;
+            Slot* slots;
+            char* data;
+            Segment() : base(0), length(0), header(0), slots(0), data(0) {}
+            ~Segment() {if (base) munmap(base, length);}
+        };
+
+        std::shared_ptr<Segment> segment;
+
+        bool matches(const Slot& s, const SharedOperatorCache::BlockKey& key) {
+            return s.op == key.op && s.kind == key.kind && s.n == key.n && s.l == key.l
+                && s.extra == key.extra;
+        }
+
+        /// Create the segment or attach to the one made by another rank of the node
+        std::shared_ptr<Segment> map_segment(const std::string& name, std::size_t nbyte) {
+            const std::int64_t nslot = std::max<std::size_t>(1024, nbyte/8192);
+            const std::size_t slotbytes = round_up(sizeof(Slot)*nslot);
+            const std::size_t length = round_up(sizeof(Header)) + slotbytes + nbyte;
+
+            bool creator = true;
+            int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+            if (fd < 0 && errno == EEXIST) {
+                creator = false;
+                fd = shm_open(name.c_str(), O_RDWR, 0600);
+            }
+            if (fd < 0) return std::shared_ptr<Segment>();
+
+            if (creator) {
+                if (ftruncate(fd, length) != 0) {
+                    ::close(fd);
+                    return std::shared_ptr<Segment>();
+                }
+            }
+            else {
+                // Wait for the creator to size the segment
+                struct stat st;
+                for (int i=0; i<10000; ++i) {
+                    if (fstat(fd, &st) == 0 && std::size_t(st.st_size) == length) break;
+                    usleep(1000);
+                }
+                if (std::size_t(st.st_size) != length) {
+                    ::close(fd);
+                    return std::shared_ptr<Segment>();
+                }
+            }
+
+            void* base = mmap(0, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            ::close(fd);
+            if (base == MAP_FAILED) return std::shared_ptr<Segment>();
+
+            std::shared_ptr<Segment> seg(new Segment);
+            seg->base = base;
+            seg->length = length;
+            seg->header = static_cast<Header*>(base);
+            seg->slots = reinterpret_cast<Slot*>(static_cast<char*>(base) + round_up(sizeof(Header)));
+            seg->data = reinterpret_cast<char*>(seg->slots) + slotbytes;
+
+            Header* h = seg->header;
+            if (creator) {
+                // ftruncate zeroed the segment, so all slots are EMPTY
+                std::memcpy(h->magic, magic, sizeof(magic));
+                h->nslot = nslot;
+                h->capacity = nbyte;
+                h->ready.store(1, std::memory_order_release);
+            }
+            else {
+                for (int i=0; i<10000 && h->ready.load(std::memory_order_acquire) != 1; ++i) usleep(1000);
+                if (h->ready.load(std::memory_order_acquire) != 1 || h->nslot != nslot
+                    || std::memcmp(h->magic, magic, sizeof(magic)) != 0) return std::shared_ptr<Segment>();
+            }
+            return seg;
+        }
+    }
+
+
+    hashT SharedOperatorCache::BlockKey::hash() const {
+        hashT h = hash_value(op);
+        hash_combine(h, kind);
+        hash_combine(h, n);
+        hash_combine(h, l);
+        hash_combine(h, extra);
+        return h;
+    }
+
+
+    void SharedOperatorCache::initialize(World& world, std::size_t nbyte) {
+        segment.reset();
+        if (nbyte == 0) return;
+
+        // A name unique to this job, the same on all ranks
+        std::uint64_t token = 0;
+        if (world.rank() == 0) {
+            char host[256];
+            if (gethostname(host, sizeof(host))) host[0] = 0;
+            hashT h = hash_value(std::string(host));
+            hash_combine(h, getpid());
+            hash_combine(h, cpu_time());
+            hash_combine(h, wall_time());
+            token = h;
+        }
+        world.gop.broadcast(token);
+        std::ostringstream name;
+        name << "/madness-opcache-" << std::hex << token;
+
+        nbyte = round_up(nbyte);
+        std::shared_ptr<Segment> seg = map_segment(name.str(), nbyte);
+        int nfail = seg ? 0 : 1;
+        world.gop.sum(nfail);
+
+        // All ranks of the node have mapped the segment, so the name is no
+        // longer needed and the memory is freed when the last rank exits
+        world.gop.fence();
+        shm_unlink(name.str().c_str());
+
+        if (nfail) {
+            if (world.rank() == 0) print("SharedOperatorCache: could not map the segment on", nfail, "ranks");
+            return;
+        }
+        segment = seg;
+    }
+
+
+    bool SharedOperatorCache::enabled() {
+        return bool(segment);
+    }
+
+
+    const double* SharedOperatorCache::find(const BlockKey& key, std::size_t& size) {
+        Segment* seg = segment.get();
+        if (!seg) return 0;
+        const std::int64_t nslot = seg->header->nslot;
+        std::int64_t i = key.hash() % nslot;
+        for (std::int64_t probe=0; probe<nslot; ++probe, i=(i+1)%nslot) {
+            const Slot& s = seg->slots[i];
+            const std::uint32_t state = s.state.load(std::memory_order_acquire);
+            if (state == EMPTY) return 0;
+            if (state == READY && matches(s, key)) {
+                size = s.size;
+                return reinterpret_cast<const double*>(seg->data + s.offset);
+            }
+        }
+        return 0;
+    }
+
+
+    const double* SharedOperatorCache::insert(const BlockKey& key, const double* data, std::size_t size) {
+        Segment* seg = segment.get();
+        if (!seg) return 0;
+        Header* h = seg->header;
+        const std::int64_t nslot = h->nslot;
+        std::int64_t i = key.hash() % nslot;
+        for (std::int64_t probe=0; probe<nslot; ) {
+            Slot& s = seg->slots[i];
+            std::uint32_t state = s.state.load(std::memory_order_acquire);
+            if (state == READY && matches(s, key)) {
+                return reinterpret_cast<const double*>(seg->data + s.offset);
+            }
+            if (state == EMPTY) {
+                if (!s.state.compare_exchange_strong(state, std::uint32_t(BUSY), std::memory_order_acq_rel))
+                    continue;       // lost the race for this slot, look at it again
+
+                const std::int64_t nbyte = round_up(size*sizeof(double));
+                const std::int64_t offset = h->used.fetch_add(nbyte);
+                if (offset + nbyte > h->capacity) {
+                    s.state.store(FAILED, std::memory_order_release);
+                    return 0;
+                }
+                s.op = key.op;
+                s.kind = key.kind;
+                s.n = key.n;
+                s.l = key.l;
+                s.extra = key.extra;
+                s.offset = offset;
+                s.size = size;
+                double* p = reinterpret_cast<double*>(seg->data + offset);
+                std::memcpy(p, data, size*sizeof(double));
+                s.state.store(READY, std::memory_order_release);
+                h->nentry.fetch_add(1);
+                return p;
+            }
+            ++probe;
+            i = (i+1)%nslot;
+        }
+        return 0;
+    }
+
+
+    std::shared_ptr<void> SharedOperatorCache::owner() {
+        return segment;
+    }
+
+
+    bool SharedOperatorCache::contains(const void* p) {
+        Segment* seg = segment.get();
+        if (!seg) return false;
+        const char* c = static_cast<const char*>(p);
+        return c >= seg->data && c < static_cast<const char*>(seg->base) + seg->length;
+    }
+
+
+    std::size_t SharedOperatorCache::size() {
+        return segment ? segment->header->nentry.load() : 0;
+    }
+
+
+    std::size_t SharedOperatorCache::bytes_used() {
+        if (!segment) return 0;
+        return std::min(segment->header->used.load(), segment->header->capacity);
+    }
+
+}
@@ -0,0 +1,115 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+#ifndef MADNESS_MRA_SHAREDCACHE_H__INCLUDED
+#define MADNESS_MRA_SHAREDCACHE_H__INCLUDED
+
+/// \file sharedcache.h
+/// \brief Node-level cache of operator blocks in POSIX shared memory
+
+#include <madness/world/worldhash.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace madness {
+
+    class World;
+
+    /// Write-once cache of operator blocks shared by the processes of a node
+
+    /// The blocks of 1D operators (NS and modified NS forms) are kept in a
+    /// POSIX shared memory segment that all ranks of a node map, so that a
+    /// block is stored once per node instead of once per rank.  The
+    /// operators refer to the blocks in the segment without copying them.
+    ///
+    /// The segment holds an open-addressing hash table and a data region
+    /// that is allocated by bumping an atomic offset.  A rank inserts a
+    /// block by claiming an empty slot with compare-and-swap, copying the
+    /// data and then publishing the slot.  As in SimpleCache the first
+    /// insert of a key wins and published blocks are never modified.  A
+    /// slot that is being written is skipped by lookups, so a rank never
+    /// waits for another one but may compute a block itself.  When the
+    /// segment is full, blocks are only kept locally.
+    ///
+    /// The cache is enabled by initialize(), which startup() calls with the
+    /// size in MB given by the environment variable \c MAD_SHM_OPERATOR_CACHE.
+    class SharedOperatorCache {
+    public:
+        /// Identifies a block
+        struct BlockKey {
+            hashT op;               ///< identifies the operator
+            std::int32_t kind;      ///< kind of block, e.g. NS or modified NS
+            std::int32_t n;         ///< level
+            std::int64_t l;         ///< translation
+            std::int64_t extra;     ///< e.g. the source offset of the modified NS form
+
+            BlockKey(hashT op, int kind, int n, std::int64_t l, std::int64_t extra=0)
+                : op(op), kind(kind), n(n), l(l), extra(extra) {}
+
+            bool operator==(const BlockKey& b) const {
+                return op == b.op && kind == b.kind && n == b.n && l == b.l && extra == b.extra;
+            }
+
+            hashT hash() const;
+        };
+
+        /// Create or attach to the segment of this node; collective on world
+
+        /// @param[in] world all ranks of the job
+        /// @param[in] nbyte size of the data region, 0 disables the cache
+        static void initialize(World& world, std::size_t nbyte);
+
+        /// Return true if the cache is enabled
+        static bool enabled();
+
+        /// Return the block with the key and its size in doubles, or null if not present
+        static const double* find(const BlockKey& key, std::size_t& size);
+
+        /// Insert a block, unless the key is already present
+
+        /// @return the block in the segment (which may be that of an earlier insert), or null if full
+        static const double* insert(const BlockKey& key, const double* data, std::size_t size);
+
+        /// Keeps the segment mapped as long as it is referenced
+        static std::shared_ptr<void> owner();
+
+        /// Return true if p points into the segment
+        static bool contains(const void* p);
+
+        /// Return the number of blocks in the segment
+        static std::size_t size();
+
+        /// Return the number of bytes of the data region in use
+        static std::size_t bytes_used();
+    };
+
+}
+#endif // MADNESS_MRA_SHAREDCACHE_H__INCLUDED
@@ -34,6 +34,7 @@
 #define MADNESS_MRA_SIMPLECACHE_H__INCLUDED
 
 #include <madness/mra/key.h>
+#include <madness/world/lockfreehashmap.h>
 
 namespace madness {
     /// Simplified interface around hash_map to cache stuff for 1D
@@ -44,7 +45,7 @@ namespace madness {
     template <typename Q, std::size_t NDIM>
     class SimpleCache {
     private:
-        typedef ConcurrentHashMap< Key<NDIM>, Q > mapT;
+        typedef ContainerHashMap< Key<NDIM>, Q > mapT;
         typedef std::pair<Key<NDIM>, Q> pairT;
         mapT cache;
 
@@ -36,6 +36,7 @@
 /// \file mra/startup.cc
 
 #include <madness/mra/mra.h>
+#include <madness/mra/sharedcache.h>
 #include <madness/tensor/tensor.h>
 #include <madness/world/timers.h>
 //#include <madness/mra/mraimpl.h> !!!!!!!!!!!!!!!!  NOOOOOOOOOOOOOOOOOOOOOOOOOO !!!!!!!!!!!!!!!!!!!!!!!
@@ -83,6 +84,8 @@ namespace madness {
 
         // Process environment variables
         if (getenv("MRA_DATA_DIR")) data_dir = getenv("MRA_DATA_DIR");
+        if (getenv("MAD_SHM_OPERATOR_CACHE"))
+            SharedOperatorCache::initialize(world, std::size_t(atol(getenv("MAD_SHM_OPERATOR_CACHE")))*1024*1024);
 
         // Need to add an RC file ...
 
@@ -0,0 +1,127 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testapplybatch.cc
+/// \brief Tests and times SeparatedConvolution::apply_batch
+
+/// apply_batch must give the results of apply for each displacement. The
+/// time of applying the Coulomb and BSH operators is printed with and
+/// without batching of the displacements in FunctionImpl::do_apply.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operator.h>
+#include <cmath>
+
+using namespace madness;
+
+static double gaussian(const coord_3d& r) {
+    const double rsq = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+    return std::exp(-10.0*rsq);
+}
+
+/// Compares apply_batch with apply for the first two shells of displacements of one box
+int test_batch(World& world, const SeparatedConvolution<double,3>& op, int k) {
+    const Key<3> source(3, Vector<Translation,3>(4));
+    std::vector< Key<3> > shifts;
+    std::vector<double> tols;
+    const std::vector< Key<3> >& disp = op.get_disp(source.level());
+    for (std::size_t i=0; i<disp.size() && disp[i].distsq()<=2; ++i) {
+        shifts.push_back(disp[i]);
+        tols.push_back(1e-10);
+    }
+
+    Tensor<double> c(2*k, 2*k, 2*k);
+    c.fillrandom();
+    std::vector< Tensor<double> > batch = op.apply_batch(source, shifts, c, tols);
+
+    double maxerr = 0.0;
+    for (std::size_t i=0; i<shifts.size(); ++i) {
+        const Tensor<double> r = op.apply(source, shifts[i], c, tols[i]);
+        maxerr = std::max(maxerr, (r - batch[i]).normf()/std::max(1.0, r.normf()));
+    }
+    if (world.rank() == 0)
+        print("   apply_batch over", shifts.size(), "displacements: relative error", maxerr);
+    return (maxerr > 1e-13) ? 1 : 0;
+}
+
+/// Applies the operator with and without batching, comparing the results and times
+int test_apply(World& world, const SeparatedConvolution<double,3>& op, const Function<double,3>& f,
+               double thresh) {
+    Function<double,3> r[2];
+    double used[2];
+    for (int b=0; b<2; ++b) {
+        FunctionDefaults<3>::set_apply_batch(b == 1);
+        r[b] = apply(op, f);       // fills the operator caches
+        world.gop.fence();
+        const double start = wall_time();
+        r[b] = apply(op, f);
+        world.gop.fence();
+        used[b] = wall_time() - start;
+    }
+    FunctionDefaults<3>::set_apply_batch(true);
+    const double err = (r[1] - r[0]).norm2();
+    if (world.rank() == 0)
+        print("   apply time unbatched", used[0], "batched", used[1], "speedup", used[0]/used[1],
+              "difference", err);
+    return (err > 0.01*thresh) ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    const double thresh = 1e-6;
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_cubic_cell(-20.0, 20.0);
+
+    int nerror = 0;
+    for (int k=8; k<=10; k+=2) {
+        FunctionDefaults<3>::set_k(k);
+        Function<double,3> f = FunctionFactory<double,3>(world).f(gaussian);
+        f.truncate();
+
+        SeparatedConvolution<double,3> coulomb = CoulombOperator(world, 1e-4, thresh);
+        SeparatedConvolution<double,3> bsh = BSHOperator3D(world, 1.0, 1e-4, thresh);
+
+        if (world.rank() == 0) print("k", k, "Coulomb");
+        nerror += test_batch(world, coulomb, k);
+        nerror += test_apply(world, coulomb, f, thresh);
+        if (world.rank() == 0) print("k", k, "BSH");
+        nerror += test_batch(world, bsh, k);
+        nerror += test_apply(world, bsh, f, thresh);
+    }
+
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testapplybuffer.cc
+/// \brief Tests and times the local summation of the results of FunctionImpl::apply
+
+/// The Coulomb and BSH operators are applied with the results of each
+/// thread summed in buffers, with buffers so small that they are flushed
+/// early, and with every result sent at once.  The three must agree to
+/// within rounding.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operator.h>
+#include <cmath>
+
+using namespace madness;
+
+static double gaussians(const coord_3d& r) {
+    const double rsq = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+    const double rsq1 = rsq - 2.0*r[0] + 1.0;     // distance from (1,0,0)
+    return std::exp(-10.0*rsq) + std::exp(-2.0*rsq1);
+}
+
+/// Applies the operator with each buffer size, comparing the results and times
+int test_apply(World& world, const SeparatedConvolution<double,3>& op, const Function<double,3>& f) {
+    const std::size_t save = FunctionDefaults<3>::get_apply_buffer_size();
+    const std::size_t sizes[] = {0, 4096, save};
+    const char* names[] = {"unbuffered", "small buffers", "buffered"};
+    Function<double,3> r[3];
+    double used[3];
+    for (int i=0; i<3; ++i) {
+        FunctionDefaults<3>::set_apply_buffer_size(sizes[i]);
+        r[i] = apply(op, f);        // fills the operator caches
+        world.gop.fence();
+        const double start = wall_time();
+        r[i] = apply(op, f);
+        world.gop.fence();
+        used[i] = wall_time() - start;
+    }
+    FunctionDefaults<3>::set_apply_buffer_size(save);
+
+    int nerror = 0;
+    const double rnorm = r[0].norm2();
+    for (int i=0; i<3; ++i) {
+        const double err = (r[i] - r[0]).norm2()/rnorm;
+        if (world.rank() == 0) print("   ", names[i], "apply time", used[i], "relative difference", err);
+        if (err > 1e-12) ++nerror;
+    }
+    return nerror;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    const double thresh = 1e-6;
+    FunctionDefaults<3>::set_k(8);
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_cubic_cell(-20.0, 20.0);
+
+    Function<double,3> f = FunctionFactory<double,3>(world).f(gaussians);
+    f.truncate();
+    SeparatedConvolution<double,3> coulomb = CoulombOperator(world, 1e-4, thresh);
+    SeparatedConvolution<double,3> bsh = BSHOperator3D(world, 1.0, 1e-4, thresh);
+
+    int nerror = 0;
+    if (world.rank() == 0) print("Coulomb");
+    nerror += test_apply(world, coulomb, f);
+    if (world.rank() == 0) print("BSH");
+    nerror += test_apply(world, bsh, f);
+
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testfusion.cc
+/// \brief Times compress and reconstruct with and without task fusion
+
+/// The tasks of \c compress and \c reconstruct carry a cost hint (see
+/// \c FunctionImpl::transform_cost) so with \c TaskFusion enabled the
+/// many tiny tasks of a 3D tree are run inline or in batches, while in 6D
+/// only the tree traversal tasks are small enough to be fused. The
+/// threshold is taken from `MAD_TASK_FUSION`, default 100 microseconds.
+
+#include <madness/mra/mra.h>
+#include <cmath>
+
+using namespace madness;
+
+template <std::size_t NDIM>
+double gaussian(const Vector<double,NDIM>& r) {
+    double rsq = 0.0;
+    for (std::size_t i=0; i<NDIM; ++i) rsq += r[i]*r[i];
+    return std::exp(-2.0*rsq);
+}
+
+template <std::size_t NDIM>
+int test_fusion(World& world, int k, double thresh, int nrep, unsigned int threshold) {
+    FunctionDefaults<NDIM>::set_k(k);
+    FunctionDefaults<NDIM>::set_thresh(thresh);
+    FunctionDefaults<NDIM>::set_cubic_cell(-6.0, 6.0);
+
+    Function<double,NDIM> f = FunctionFactory<double,NDIM>(world).f(gaussian<NDIM>);
+    const double norm = f.norm2();
+    const std::size_t size = f.size();
+    if (world.rank() == 0)
+        print(NDIM, "D gaussian: k", k, "thresh", thresh, "#coeffs", size,
+              "transform cost hint", f.get_impl()->transform_cost(), "us");
+
+    int nerror = 0;
+    const unsigned int thresholds[2] = {0, threshold};
+    for (unsigned int t : thresholds) {
+        TaskFusion::set_threshold(t);
+        const TaskFusionStats before = TaskFusion::get_stats();
+        const double start = wall_time();
+        for (int rep=0; rep<nrep; ++rep) {
+            f.compress();
+            f.reconstruct();
+        }
+        const double used = wall_time() - start;
+        const TaskFusionStats after = TaskFusion::get_stats();
+        const double err = std::abs(f.norm2() - norm);
+        if (world.rank() == 0)
+            print("   fusion threshold", t, "time", used, "inline", after.ninline - before.ninline,
+                  "fused", after.nfused - before.nfused, "batches", after.nbatch - before.nbatch,
+                  "queued", after.nqueued - before.nqueued, "norm error", err);
+        if (err > thresh) ++nerror;
+    }
+    TaskFusion::set_threshold(0);
+    return nerror;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    unsigned int threshold = TaskFusion::threshold();
+    if (threshold == 0) threshold = 100;
+
+    int nerror = 0;
+    nerror += test_fusion<3>(world, 6, 1e-6, 10, threshold);
+    nerror += test_fusion<6>(world, 4, 1e-1, 1, threshold);
+
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,114 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testmixedapply.cc
+/// \brief Tests and times the mixed precision SeparatedConvolution::apply
+
+/// The Coulomb operator is applied to a normalized Gaussian with the 1D
+/// blocks in double and in single precision.  The two results must agree
+/// to within the truncation threshold, and both errors with respect to the
+/// analytic potential are printed together with the times.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operator.h>
+#include <cmath>
+
+using namespace madness;
+
+static const double expnt = 10.0;
+
+static double gaussian(const coord_3d& r) {
+    const double rsq = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+    return std::pow(expnt/constants::pi, 1.5)*std::exp(-expnt*rsq);
+}
+
+static double potential(const coord_3d& r) {
+    const double rr = std::sqrt(r[0]*r[0] + r[1]*r[1] + r[2]*r[2]);
+    if (rr < 1e-8) return 2.0*std::sqrt(expnt/constants::pi);
+    return std::erf(std::sqrt(expnt)*rr)/rr;
+}
+
+/// Applies the Coulomb operator in double and in mixed precision, comparing the results and times
+int test_apply(World& world, int k, double thresh) {
+    FunctionDefaults<3>::set_k(k);
+    FunctionDefaults<3>::set_thresh(thresh);
+    Function<double,3> f = FunctionFactory<double,3>(world).f(gaussian);
+    f.truncate();
+    Function<double,3> exact = FunctionFactory<double,3>(world).f(potential);
+    SeparatedConvolution<double,3> op = CoulombOperator(world, 1e-4, thresh);
+
+    Function<double,3> r[2];
+    double used[2], err[2];
+    for (int mixed=0; mixed<2; ++mixed) {
+        FunctionDefaults<3>::set_apply_float_thresh(mixed ? thresh : 0.0);
+        r[mixed] = apply(op, f);        // fills the operator caches
+        world.gop.fence();
+        const double start = wall_time();
+        r[mixed] = apply(op, f);
+        world.gop.fence();
+        used[mixed] = wall_time() - start;
+        err[mixed] = (r[mixed] - exact).norm2();
+    }
+    const double diff = (r[1] - r[0]).norm2();
+
+    // Below the threshold of the mixed mode the double precision path is used
+    FunctionDefaults<3>::set_apply_float_thresh(10.0*thresh);
+    const double same = (apply(op, f) - r[0]).norm2();
+    FunctionDefaults<3>::set_apply_float_thresh(0.0);
+
+    if (world.rank() == 0) {
+        print("k", k, "thresh", thresh);
+        print("   error double", err[0], "mixed", err[1], "difference", diff, "off", same);
+        print("   apply time double", used[0], "mixed", used[1], "speedup", used[0]/used[1]);
+    }
+    return (diff > thresh || same > 1e-10) ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    // Blocks computed before the mixed mode is first enabled have no single
+    // precision copy, so enable it before any operator is made
+    FunctionDefaults<3>::set_apply_float_thresh(1.0);
+    FunctionDefaults<3>::set_cubic_cell(-20.0, 20.0);
+
+    int nerror = 0;
+    nerror += test_apply(world, 6, 1e-4);
+    nerror += test_apply(world, 8, 1e-5);
+    nerror += test_apply(world, 8, 1e-6);
+
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
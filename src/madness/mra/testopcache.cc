@@ -0,0 +1,155 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testopcache.cc
+/// \brief Tests the persistent on-disk cache of 1D operator blocks
+
+/// The NS blocks of a set of Gaussian convolutions are computed with an
+/// empty cache, read back from the cache file by new operators, and
+/// compared with blocks computed without the cache.  The times of making
+/// the blocks with a cold and a warm cache are printed.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operatorcache.h>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+
+using namespace madness;
+
+typedef std::shared_ptr< GaussianConvolution1D<double> > opT;
+
+static const int k = 10;
+static const Level nlevel = 8;
+static const Translation lmax = 3;
+
+/// Makes a set of Gaussians like those of the fit of a BSH operator
+static std::vector<opT> make_ops() {
+    std::vector<opT> ops;
+    for (double expnt=1e-2; expnt<1e6; expnt*=1.5)
+        ops.push_back(opT(new GaussianConvolution1D<double>(k, sqrt(expnt/constants::pi), expnt, 0, false)));
+    return ops;
+}
+
+/// Makes the NS blocks of all operators and returns the time used
+static double make_blocks(const std::vector<opT>& ops) {
+    const double start = wall_time();
+    for (std::size_t i=0; i<ops.size(); ++i)
+        for (Level n=0; n<nlevel; ++n)
+            for (Translation l=-lmax; l<=lmax; ++l)
+                ops[i]->nonstandard(n, l);
+    return wall_time() - start;
+}
+
+static double diff(const Tensor<double>& a, const Tensor<double>& b) {
+    if (a.size() != b.size()) return 1.0;
+    if (a.size() == 0) return 0.0;
+    return (a - b).normf();
+}
+
+/// Compares the blocks of ops with those of ref
+static int compare(const std::vector<opT>& ops, const std::vector<opT>& ref) {
+    double maxdiff = 0.0;
+    for (std::size_t i=0; i<ops.size(); ++i) {
+        for (Level n=0; n<nlevel; ++n) {
+            for (Translation l=-lmax; l<=lmax; ++l) {
+                const ConvolutionData1D<double>* a = ops[i]->nonstandard(n, l);
+                const ConvolutionData1D<double>* b = ref[i]->nonstandard(n, l);
+                maxdiff = std::max(maxdiff, diff(a->R, b->R));
+                maxdiff = std::max(maxdiff, diff(a->T, b->T));
+                maxdiff = std::max(maxdiff, diff(a->RU, b->RU));
+                maxdiff = std::max(maxdiff, diff(a->RVT, b->RVT));
+                maxdiff = std::max(maxdiff, diff(a->TU, b->TU));
+                maxdiff = std::max(maxdiff, diff(a->TVT, b->TVT));
+                maxdiff = std::max(maxdiff, diff(a->Rs, b->Rs));
+                maxdiff = std::max(maxdiff, diff(a->Ts, b->Ts));
+                maxdiff = std::max(maxdiff, std::abs(a->Rnorm - b->Rnorm));
+                maxdiff = std::max(maxdiff, std::abs(a->NSnormf - b->NSnormf));
+            }
+        }
+    }
+    print("   largest difference to fresh blocks", maxdiff);
+    return (maxdiff == 0.0) ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    int nerror = 0;
+    if (world.rank() == 0) {
+        char dir[] = "/tmp/testopcacheXXXXXX";
+        if (!mkdtemp(dir)) MADNESS_EXCEPTION("testopcache: mkdtemp failed", 0);
+
+        // Reference blocks without the cache
+        OperatorCacheFile::set_directory("");
+        std::vector<opT> ref = make_ops();
+        double used_ref = make_blocks(ref);
+
+        // Cold cache: blocks are computed and written when the operators go
+        OperatorCacheFile::set_directory(dir);
+        std::vector<std::string> files;
+        double used_cold;
+        {
+            std::vector<opT> cold = make_ops();
+            used_cold = make_blocks(cold);
+            for (std::size_t i=0; i<cold.size(); ++i) files.push_back(cold[i]->diskcache->name());
+        }
+
+        // Warm cache: blocks are read from the files
+        std::vector<opT> warm = make_ops();
+        std::size_t nblock = 0;
+        for (std::size_t i=0; i<warm.size(); ++i) nblock += warm[i]->diskcache->size();
+        double used_warm = make_blocks(warm);
+        print("   blocks in", files.size(), "files", nblock);
+        print("   time without cache", used_ref, "cold", used_cold, "warm", used_warm,
+              "speedup", used_ref/used_warm);
+        if (nblock != warm.size()*nlevel*(2*lmax+1)) ++nerror;
+        nerror += compare(warm, ref);
+
+        // A different operator must not use the files
+        OperatorCacheFile::idT id(1, 0.0);
+        std::shared_ptr<OperatorCacheFile> other = OperatorCacheFile::open("gaussian", id);
+        if (other->size() != 0) ++nerror;
+
+        warm.clear();
+        OperatorCacheFile::set_directory("");
+        for (std::size_t i=0; i<files.size(); ++i) std::remove(files[i].c_str());
+        rmdir(dir);
+    }
+
+    world.gop.broadcast(nerror);
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
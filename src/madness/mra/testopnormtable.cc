@@ -0,0 +1,129 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testopnormtable.cc
+/// \brief Tests the operator-norm screening table of SeparatedConvolution
+
+/// The norms looked up in the table must equal those of the operator, and a
+/// table written to disk must be read back by the same operator only.  The
+/// time of the screening lookups is printed with and without the table.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operator.h>
+#include <cstdio>
+
+using namespace madness;
+
+static const Level nlevel = 5;
+
+/// Compares disp_norm with norm for all displacements of the first levels
+int test_lookup(World& world, const SeparatedConvolution<double,3>& op) {
+    int nerror = 0;
+    for (Level n=1; n<nlevel; ++n) {
+        const Key<3> source(n, Vector<Translation,3>(0));
+        const std::vector< Key<3> >& disp = op.get_disp(n);
+        for (std::size_t i=0; i<disp.size(); ++i) {
+            if (op.disp_norm(n, i, source) != op.norm(n, disp[i], source)) ++nerror;
+        }
+    }
+    if (world.rank() == 0) print("   lookup of", op.norm_table_size(), "norms: errors", nerror);
+    return nerror;
+}
+
+/// Times the screening lookups with the hash cache and the table
+void test_time(World& world, const SeparatedConvolution<double,3>& op) {
+    const int nrep = 100;
+    double sum[2] = {0.0, 0.0}, used[2];
+    for (int t=0; t<2; ++t) {
+        const double start = wall_time();
+        for (int rep=0; rep<nrep; ++rep) {
+            for (Level n=1; n<nlevel; ++n) {
+                const Key<3> source(n, Vector<Translation,3>(0));
+                const std::vector< Key<3> >& disp = op.get_disp(n);
+                for (std::size_t i=0; i<disp.size(); ++i)
+                    sum[t] += (t == 0) ? op.norm(n, disp[i], source) : op.disp_norm(n, i, source);
+            }
+        }
+        used[t] = wall_time() - start;
+    }
+    if (world.rank() == 0)
+        print("   screening time cache", used[0], "table", used[1], "speedup", used[0]/used[1]);
+}
+
+/// Writes the table and reads it back into new operators
+int test_file(World& world, const SeparatedConvolution<double,3>& op, double thresh) {
+    int nerror = 0;
+    const std::string filename = "testopnormtable.dat";
+    if (world.rank() == 0) op.save_norm_table(filename);
+    world.gop.fence();
+
+    SeparatedConvolution<double,3> same = CoulombOperator(world, 1e-4, thresh);
+    if (!same.load_norm_table(filename)) ++nerror;
+    if (same.norm_table_size() != op.norm_table_size()) ++nerror;
+    for (Level n=1; n<nlevel; ++n) {
+        const std::vector< Key<3> >& disp = op.get_disp(n);
+        const Key<3> source(n, Vector<Translation,3>(0));
+        for (std::size_t i=0; i<disp.size(); ++i)
+            if (same.disp_norm(n, i, source) != op.disp_norm(n, i, source)) ++nerror;
+    }
+
+    SeparatedConvolution<double,3> other = BSHOperator3D(world, 1.0, 1e-4, thresh);
+    if (other.load_norm_table(filename)) ++nerror;
+    if (other.norm_table_size() != 0) ++nerror;
+
+    world.gop.fence();
+    if (world.rank() == 0) std::remove(filename.c_str());
+    if (world.rank() == 0) print("   save and load: errors", nerror);
+    return nerror;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    const double thresh = 1e-6;
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_k(8);
+    FunctionDefaults<3>::set_cubic_cell(-20.0, 20.0);
+
+    SeparatedConvolution<double,3> coulomb = CoulombOperator(world, 1e-4, thresh);
+
+    int nerror = 0;
+    nerror += test_lookup(world, coulomb);
+    test_time(world, coulomb);
+    nerror += test_file(world, coulomb, thresh);
+
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,112 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testoprank.cc
+/// \brief Tests and times the choice of dense or low-rank 1D operator blocks
+
+/// The Coulomb operator is applied with the 1D blocks chosen by operation
+/// count and by the fixed break even rank.  The results must agree to the
+/// threshold.  The distribution of the ranks of the blocks, the estimated
+/// operation counts and the times are printed.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operator.h>
+#include <cmath>
+
+using namespace madness;
+
+static double gaussian(const coord_3d& r) {
+    const double rsq = r[0]*r[0] + r[1]*r[1] + r[2]*r[2];
+    return std::exp(-10.0*rsq);
+}
+
+/// Applies the operator with both choices of the rank, comparing the results and times
+int test_apply(World& world, const SeparatedConvolution<double,3>& op, const Function<double,3>& f,
+               double thresh) {
+    Function<double,3> r[2];
+    double used[2];
+    std::pair<double,double> flops[2];
+    for (int b=0; b<2; ++b) {
+        FunctionDefaults<3>::set_apply_rank_by_flops(b == 1);
+        r[b] = apply(op, f);       // fills the operator caches
+        world.gop.fence();
+        op.reset_rank_statistics();
+        op.collect_rank_statistics(true);
+        const double start = wall_time();
+        r[b] = apply(op, f);
+        world.gop.fence();
+        used[b] = wall_time() - start;
+        op.collect_rank_statistics(false);
+        flops[b] = op.rank_statistics_flops();
+    }
+    if (world.rank() == 0) op.print_rank_statistics();
+    FunctionDefaults<3>::set_apply_rank_by_flops(false);
+
+    const double err = (r[1] - r[0]).norm2();
+    if (world.rank() == 0) {
+        print("   multiply-adds break even", flops[0].first, "by flops", flops[1].first,
+              "ratio", flops[1].first/flops[0].first);
+        print("   apply time break even", used[0], "by flops", used[1], "speedup", used[0]/used[1],
+              "difference", err);
+    }
+    int nerror = 0;
+    if (err > thresh) ++nerror;
+    if (flops[1].first > flops[0].first) ++nerror;
+    return nerror;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    FunctionDefaults<3>::set_cubic_cell(-20.0, 20.0);
+
+    int nerror = 0;
+    for (int k=6; k<=10; k+=4) {
+        for (double thresh=1e-4; thresh>=1e-6; thresh*=0.01) {
+            FunctionDefaults<3>::set_k(k);
+            FunctionDefaults<3>::set_thresh(thresh);
+            Function<double,3> f = FunctionFactory<double,3>(world).f(gaussian);
+            f.truncate();
+
+            SeparatedConvolution<double,3> coulomb = CoulombOperator(world, 1e-4, thresh);
+
+            if (world.rank() == 0) print("k", k, "thresh", thresh, "Coulomb");
+            nerror += test_apply(world, coulomb, f, thresh);
+        }
+    }
+
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testrestartio.cc
+/// \brief Saves and loads vectors of functions, possibly with different numbers of processes
+
+/// Usage: testrestartio save|load|both [nfunc] [nio] [k] [thresh]
+///
+/// "save" projects nfunc Gaussians and writes them with nio writers to
+/// the archive "restartio", "load" reads the archive and compares with
+/// the Gaussians, and "both" does both in one job.  Running "save" and
+/// "load" with different numbers of processes tests the restart with a
+/// different allocation.  The sizes of the files and the rates are
+/// printed; nfunc, k and thresh set the size of the data.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/vmra.h>
+#include <cstdlib>
+#include <string>
+#include <sys/stat.h>
+
+using namespace madness;
+
+class Gaussian : public FunctionFunctorInterface<double,3> {
+    const double expnt;
+    const coord_3d center;
+public:
+    Gaussian(double expnt, const coord_3d& center) : expnt(expnt), center(center) {}
+
+    double operator()(const coord_3d& r) const {
+        double rsq = 0.0;
+        for (int d=0; d<3; ++d) rsq += (r[d] - center[d])*(r[d] - center[d]);
+        return std::exp(-expnt*rsq);
+    }
+};
+
+static std::vector< Function<double,3> > make_functions(World& world, int nfunc) {
+    std::vector< Function<double,3> > f(nfunc);
+    for (int i=0; i<nfunc; ++i) {
+        coord_3d center;
+        center[0] = 0.1*i;
+        center[1] = -0.05*i;
+        center[2] = 0.0;
+        f[i] = FunctionFactory<double,3>(world)
+            .functor(std::shared_ptr< FunctionFunctorInterface<double,3> >(new Gaussian(1.0 + 0.5*i, center)));
+    }
+    return f;
+}
+
+/// Returns the total size of the files of the archive
+static double archive_bytes(World& world, const char* name) {
+    double bytes = 0.0;
+    if (world.rank() == 0) {
+        struct stat st;
+        for (int i=0; stat(archive::ParallelOutputArchive::file_name(name, i).c_str(), &st) == 0; ++i)
+            bytes += st.st_size;
+    }
+    world.gop.broadcast(bytes, 0);
+    return bytes;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    const std::string mode = (argc > 1) ? argv[1] : "both";
+    const int nfunc = (argc > 2) ? std::atoi(argv[2]) : 4;
+    const int nio = (argc > 3) ? std::atoi(argv[3]) : std::min(world.size(), 10);
+    const int k = (argc > 4) ? std::atoi(argv[4]) : 8;
+    const double thresh = (argc > 5) ? std::atof(argv[5]) : 1e-6;
+    const char* name = "restartio";
+
+    FunctionDefaults<3>::set_k(k);
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_cubic_cell(-10.0, 10.0);
+    if (world.rank() == 0) print("processes", world.size(), "functions", nfunc, "k", k, "thresh", thresh);
+
+    const std::vector< Function<double,3> > exact = make_functions(world, nfunc);
+    int nerror = 0;
+
+    if (mode == "save" || mode == "both") {
+        archive::ParallelOutputArchive::remove(world, name);     // also the files of an earlier save with more writers
+        world.gop.fence();
+        const double start = wall_time();
+        save_function(exact, name, nio);
+        world.gop.fence();
+        const double used = wall_time() - start;
+        const double bytes = archive_bytes(world, name);
+        if (world.rank() == 0) print("saved", bytes/1e9, "GB with", nio, "writers in", used, "s",
+                                     bytes/1e9/used, "GB/s");
+    }
+
+    if (mode == "load" || mode == "both") {
+        std::vector< Function<double,3> > f;
+        world.gop.fence();
+        const double start = wall_time();
+        load_function(world, f, name);
+        world.gop.fence();
+        const double used = wall_time() - start;
+        const double bytes = archive_bytes(world, name);
+        if (world.rank() == 0) print("loaded", bytes/1e9, "GB with", world.size(), "processes in", used, "s",
+                                     bytes/1e9/used, "GB/s");
+        if (int(f.size()) != nfunc) ++nerror;
+        for (int i=0; i<nfunc && i<int(f.size()); ++i) {
+            const double err = (f[i] - exact[i]).norm2()/exact[i].norm2();
+            if (err > 1e-14) {
+                ++nerror;
+                if (world.rank() == 0) print("function", i, "differs by", err);
+            }
+        }
+        if (mode == "both") archive::ParallelInputArchive::remove(world, name);
+    }
+
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,130 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testsepscreen.cc
+/// \brief Tests the separable screening of the displacements of an operator
+
+/// SeparatedConvolution::screened_disp must return every displacement
+/// whose norm exceeds the threshold.  This is checked for the 3D and 6D
+/// BSH operators on a few levels, and the 6D operator is applied with
+/// the screened displacements to a pair function to report how many were
+/// touched and used.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/operator.h>
+#include <cmath>
+
+using namespace madness;
+
+static double gaussian(const coord_3d& r) {
+    return std::exp(-(r[0]*r[0] + r[1]*r[1] + r[2]*r[2]));
+}
+
+/// Checks that the displacements missing from screened_disp have small norms
+template <std::size_t NDIM>
+int test_screened_disp(World& world, const SeparatedConvolution<double,NDIM>& op, std::size_t stride) {
+    int nerror = 0;
+    const double tols[] = {1e-2, 1e-4, 1e-6};
+    for (Level n=1; n<=4; ++n) {
+        const std::vector< Key<NDIM> >& disp = op.get_disp(n);
+        const Key<NDIM> source(n, Vector<Translation,NDIM>(Translation(1) << (n-1)));
+        for (int itol=0; itol<3; ++itol) {
+            const double tol = tols[itol];
+            const std::vector<std::size_t> kept = op.screened_disp(n, tol);
+            std::vector<bool> is_kept(disp.size(), false);
+            for (std::size_t i=0; i<kept.size(); ++i) {
+                if (kept[i] >= disp.size() || (i > 0 && kept[i] <= kept[i-1])) ++nerror;
+                else is_kept[kept[i]] = true;
+            }
+            long nchecked = 0, nlarge = 0;
+            double maxmissed = 0.0;
+            for (std::size_t i=0; i<disp.size(); i+=stride) {
+                const double opnorm = op.disp_norm(n, i, source);
+                ++nchecked;
+                if (opnorm > tol) ++nlarge;
+                if (!is_kept[i]) maxmissed = std::max(maxmissed, opnorm);
+            }
+            if (maxmissed > tol) ++nerror;
+            if (world.rank() == 0) print("   level", n, "tol", tol, "kept", kept.size(), "of", disp.size(),
+                                         "sampled", nchecked, "above tol", nlarge, "largest norm dropped", maxmissed);
+        }
+    }
+    return nerror;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+
+    const double thresh = 1e-3;
+    const double L = 16.0;
+    FunctionDefaults<3>::set_k(5);
+    FunctionDefaults<3>::set_thresh(thresh);
+    FunctionDefaults<3>::set_cubic_cell(-L/2, L/2);
+    FunctionDefaults<6>::set_k(5);
+    FunctionDefaults<6>::set_thresh(thresh);
+    FunctionDefaults<6>::set_cubic_cell(-L/2, L/2);
+
+    SeparatedConvolution<double,3> bsh3 = BSHOperator<3>(world, 1.0, 1e-4, 1e-4);
+    SeparatedConvolution<double,6> bsh6 = BSHOperator<6>(world, 1.0, 1e-4, 1e-4);
+
+    int nerror = 0;
+    if (world.rank() == 0) print("3D BSH");
+    nerror += test_screened_disp(world, bsh3, 1);
+    if (world.rank() == 0) print("6D BSH");
+    nerror += test_screened_disp(world, bsh6, 37);
+
+    // Apply the 6D operator to a small pair function
+    FunctionDefaults<3>::set_k(4);
+    FunctionDefaults<3>::set_thresh(1e-2);
+    FunctionDefaults<6>::set_k(4);
+    FunctionDefaults<6>::set_thresh(1e-2);
+    SeparatedConvolution<double,6> op6 = BSHOperator<6>(world, 1.0, 1e-2, 1e-4);
+    Function<double,3> g = FunctionFactory<double,3>(world).f(gaussian);
+    Function<double,6> pair = hartree_product(g, g);
+    pair.truncate();
+    const double start = wall_time();
+    Function<double,6> r = apply(op6, pair);
+    world.gop.fence();
+    const double used = wall_time() - start;
+    const double rnorm = r.norm2();
+    if (world.rank() == 0) {
+        print("6D apply time", used, "result norm", rnorm);
+        op6.print_screening_statistics();
+    }
+    if (!(rnorm > 0.0)) ++nerror;
+
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
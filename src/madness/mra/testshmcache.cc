@@ -0,0 +1,204 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file testshmcache.cc
+/// \brief Tests the node-level cache of operator blocks in shared memory
+
+/// The NS and modified NS blocks of a set of Gaussian convolutions are
+/// computed with the cache enabled, then made again by new operators that
+/// must find them in the segment without copying them.  All blocks are
+/// compared with blocks computed without the cache.  Run with several
+/// processes per node to share the blocks between ranks.
+
+#include <madness/mra/mra.h>
+#include <madness/mra/sharedcache.h>
+
+using namespace madness;
+
+typedef std::shared_ptr< GaussianConvolution1D<double> > opT;
+
+static const int k = 10;
+static const Level nlevel = 8;
+static const Translation lmax = 3;
+
+/// Makes a set of Gaussians like those of the fit of a BSH operator
+static std::vector<opT> make_ops() {
+    std::vector<opT> ops;
+    for (double expnt=1e-2; expnt<1e6; expnt*=1.5)
+        ops.push_back(opT(new GaussianConvolution1D<double>(k, sqrt(expnt/constants::pi), expnt, 0, false)));
+    return ops;
+}
+
+/// Returns the modified NS block of source translation s and displacement l
+static const ConvolutionData1D<double>* mod_block(const opT& op, Level n, Translation s, Translation l) {
+    return op->mod_nonstandard(Key<2>(n, Vector<Translation,2>{s, s+l}));
+}
+
+/// Makes the blocks of all operators and returns the time used
+static double make_blocks(const std::vector<opT>& ops) {
+    const double start = wall_time();
+    for (std::size_t i=0; i<ops.size(); ++i) {
+        for (Level n=0; n<nlevel; ++n) {
+            for (Translation l=-lmax; l<=lmax; ++l) {
+                ops[i]->nonstandard(n, l);
+                if (n > 0) {
+                    mod_block(ops[i], n, lmax, l);
+                    mod_block(ops[i], n, lmax+1, l);
+                }
+            }
+        }
+    }
+    return wall_time() - start;
+}
+
+static double diff(const Tensor<double>& a, const Tensor<double>& b) {
+    if (a.size() != b.size()) return 1.0;
+    if (a.size() == 0) return 0.0;
+    return (a - b).normf();
+}
+
+static double diff(const ConvolutionData1D<double>* a, const ConvolutionData1D<double>* b) {
+    double d = 0.0;
+    d = std::max(d, diff(a->R, b->R));
+    d = std::max(d, diff(a->T, b->T));
+    d = std::max(d, diff(a->RU, b->RU));
+    d = std::max(d, diff(a->RVT, b->RVT));
+    d = std::max(d, diff(a->TU, b->TU));
+    d = std::max(d, diff(a->TVT, b->TVT));
+    d = std::max(d, diff(a->Rs, b->Rs));
+    d = std::max(d, diff(a->Ts, b->Ts));
+    d = std::max(d, std::abs(a->Rnorm - b->Rnorm));
+    d = std::max(d, std::abs(a->Tnorm - b->Tnorm));
+    d = std::max(d, std::abs(a->NSnormf - b->NSnormf));
+    d = std::max(d, std::abs(a->N_up - b->N_up));
+    d = std::max(d, std::abs(a->N_diff - b->N_diff));
+    d = std::max(d, std::abs(a->N_F - b->N_F));
+    return d;
+}
+
+/// Returns 1 if the nonempty tensors of a block are not in the segment
+static int notshared(const ConvolutionData1D<double>* a) {
+    if (a->R.size() && !SharedOperatorCache::contains(a->R.ptr())) return 1;
+    if (a->T.size() && !SharedOperatorCache::contains(a->T.ptr())) return 1;
+    if (a->RU.size() && !SharedOperatorCache::contains(a->RU.ptr())) return 1;
+    return 0;
+}
+
+/// Compares the blocks of ops with those of ref and checks that they are in the segment
+static int compare(const std::vector<opT>& ops, const std::vector<opT>& ref, World& world) {
+    double maxdiff = 0.0;
+    int nlocal = 0;
+    for (std::size_t i=0; i<ops.size(); ++i) {
+        for (Level n=0; n<nlevel; ++n) {
+            for (Translation l=-lmax; l<=lmax; ++l) {
+                const ConvolutionData1D<double>* a = ops[i]->nonstandard(n, l);
+                maxdiff = std::max(maxdiff, diff(a, ref[i]->nonstandard(n, l)));
+                nlocal += notshared(a);
+                if (n == 0) continue;
+                for (Translation s=lmax; s<=lmax+1; ++s) {
+                    a = mod_block(ops[i], n, s, l);
+                    maxdiff = std::max(maxdiff, diff(a, mod_block(ref[i], n, s, l)));
+                    nlocal += notshared(a);
+                }
+            }
+        }
+    }
+    world.gop.max(maxdiff);
+    world.gop.sum(nlocal);
+    if (world.rank() == 0) {
+        print("   largest difference to fresh blocks", maxdiff);
+        print("   blocks not in the segment", nlocal);
+    }
+    return (maxdiff == 0.0 && nlocal == 0) ? 0 : 1;
+}
+
+/// Returns the bytes of the tensors of the blocks of ops
+static std::size_t local_bytes(const std::vector<opT>& ops) {
+    std::size_t nbyte = 0;
+    for (std::size_t i=0; i<ops.size(); ++i) {
+        for (Level n=0; n<nlevel; ++n) {
+            for (Translation l=-lmax; l<=lmax; ++l) {
+                nbyte += ops[i]->nonstandard(n, l)->pack().size()*sizeof(double);
+                if (n == 0) continue;
+                for (Translation s=lmax; s<=lmax+1; ++s)
+                    nbyte += mod_block(ops[i], n, s, l)->pack().size()*sizeof(double);
+            }
+        }
+    }
+    return nbyte;
+}
+
+int main(int argc, char** argv) {
+    initialize(argc, argv);
+    World world(SafeMPI::COMM_WORLD);
+    startup(world, argc, argv);
+    OperatorCacheFile::set_directory("");
+
+    // Reference blocks without the cache
+    SharedOperatorCache::initialize(world, 0);
+    std::vector<opT> ref = make_ops();
+    const double used_ref = make_blocks(ref);
+
+    int nerror = 0;
+    SharedOperatorCache::initialize(world, std::size_t(256)*1024*1024);
+    if (!SharedOperatorCache::enabled()) {
+        if (world.rank() == 0) print("   shared memory is not available, nothing to test");
+    }
+    else {
+        // Cold cache: the blocks are computed by all ranks and stored once per node
+        std::vector<opT> cold = make_ops();
+        const double used_cold = make_blocks(cold);
+        world.gop.fence();
+
+        // Warm cache: the blocks are found in the segment
+        std::vector<opT> warm = make_ops();
+        const double used_warm = make_blocks(warm);
+        nerror += compare(warm, ref, world);
+
+        if (world.rank() == 0) {
+            print("   blocks in the segment", SharedOperatorCache::size(),
+                  "bytes", SharedOperatorCache::bytes_used(), "bytes per rank without it", local_bytes(ref));
+            print("   time without cache", used_ref, "cold", used_cold, "warm", used_warm,
+                  "speedup", used_ref/used_warm);
+        }
+
+        // The blocks stay valid after the cache is disabled
+        SharedOperatorCache::initialize(world, 0);
+        if (SharedOperatorCache::enabled()) ++nerror;
+        nerror += (diff(warm[0]->nonstandard(1,0), ref[0]->nonstandard(1,0)) == 0.0) ? 0 : 1;
+    }
+
+    world.gop.sum(nerror);
+    if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+    world.gop.fence();
+    finalize();
+    return nerror ? 1 : 0;
+}
@@ -136,8 +136,12 @@ void test_inner(World& world) {
     Tensor<TENSOR_RESULT_TYPE(T,R)> rold = matrix_inner_old(world,left,*pright,sym);
     END_TIMER("old");
 
+    START_TIMER;
+    Tensor<TENSOR_RESULT_TYPE(T,R)> rrow = inner(world,left[0],*pright);
+    END_TIMER("row");
+
     if (world.rank() == 0) 
-        print("error norm",(rold-rnew).normf(),"\n");
+        print("error norm",(rold-rnew).normf(),"row error norm",(rrow-rnew(0,_)).normf(),"\n");
 }
 
 template <std::size_t NDIM>
@@ -403,15 +403,34 @@ namespace madness {
         if (fence) world.gop.fence();
     }
 
-    /// Computes the 2-norms of a vector of functions
+    namespace detail {
+        inline std::vector<double> sqrt_elements(const std::vector<double>& v) {
+            std::vector<double> r(v.size());
+            for (unsigned int i=0; i<v.size(); ++i) r[i] = sqrt(v[i]);
+            return r;
+        }
+    }
+
+    /// Starts computing the 2-norms of a vector of functions
+
+    /// The local contributions are computed before returning and the global
+    /// sum proceeds asynchronously, so the caller can overlap it with the
+    /// next step and call \c get() on the result when the norms are needed.
     template <typename T, std::size_t NDIM>
-    std::vector<double> norm2s(World& world,
-                              const std::vector< Function<T,NDIM> >& v) {
+    Future< std::vector<double> > norm2s_async(World& world,
+                                               const std::vector< Function<T,NDIM> >& v) {
         PROFILE_BLOCK(Vnorm2);
         std::vector<double> norms(v.size());
         for (unsigned int i=0; i<v.size(); ++i) norms[i] = v[i].norm2sq_local();
-        world.gop.sum(&norms[0], norms.size());
-        for (unsigned int i=0; i<v.size(); ++i) norms[i] = sqrt(norms[i]);
+        return world.taskq.add(&detail::sqrt_elements, world.gop.isum(norms),
+                               TaskAttributes::hipri());
+    }
+
+    /// Computes the 2-norms of a vector of functions
+    template <typename T, std::size_t NDIM>
+    std::vector<double> norm2s(World& world,
+                              const std::vector< Function<T,NDIM> >& v) {
+        std::vector<double> norms = norm2s_async(world, v).get();
         world.gop.fence();
         return norms;
     }
@@ -421,12 +440,11 @@ namespace madness {
     double norm2(World& world,
                               const std::vector< Function<T,NDIM> >& v) {
         PROFILE_BLOCK(Vnorm2);
-        std::vector<double> norms(v.size());
-        for (unsigned int i=0; i<v.size(); ++i) norms[i] = v[i].norm2sq_local();
-        world.gop.sum(&norms[0], norms.size());
-        for (unsigned int i=1; i<v.size(); ++i) norms[0] += norms[i];
+        double norm = 0.0;
+        for (unsigned int i=0; i<v.size(); ++i) norm += v[i].norm2sq_local();
+        norm = world.gop.isum(norm).get();
         world.gop.fence();
-        return sqrt(norms[0]);
+        return sqrt(norm);
     }
 
     inline double conj(double x) {
@@ -575,48 +593,70 @@ namespace madness {
         return r;
     }
 
-    /// Computes the element-wise inner product of two function vectors - q(i) = inner(f[i],g[i])
+    /// Starts computing the element-wise inner product of two function vectors - q(i) = inner(f[i],g[i])
+
+    /// As for \c norm2s_async, only the global sum is left outstanding on return.
     template <typename T, typename R, std::size_t NDIM>
-    Tensor< TENSOR_RESULT_TYPE(T,R) > inner(World& world,
+    Future< std::vector<TENSOR_RESULT_TYPE(T,R)> > inner_async(World& world,
                                             const std::vector< Function<T,NDIM> >& f,
                                             const std::vector< Function<R,NDIM> >& g) {
         PROFILE_BLOCK(Vinnervv);
         long n=f.size(), m=g.size();
         MADNESS_ASSERT(n==m);
-        Tensor< TENSOR_RESULT_TYPE(T,R) > r(n);
+        std::vector<TENSOR_RESULT_TYPE(T,R)> r(n);
 
         compress(world, f);
         compress(world, g);
 
         for (long i=0; i<n; ++i) {
-            r(i) = f[i].inner_local(g[i]);
+            r[i] = f[i].inner_local(g[i]);
         }
 
-        world.taskq.fence();
-        world.gop.sum(r.ptr(),n);
+        return world.gop.isum(r);
+    }
+
+    /// Computes the element-wise inner product of two function vectors - q(i) = inner(f[i],g[i])
+    template <typename T, typename R, std::size_t NDIM>
+    Tensor< TENSOR_RESULT_TYPE(T,R) > inner(World& world,
+                                            const std::vector< Function<T,NDIM> >& f,
+                                            const std::vector< Function<R,NDIM> >& g) {
+        const std::vector<TENSOR_RESULT_TYPE(T,R)> q = inner_async(world, f, g).get();
+        Tensor< TENSOR_RESULT_TYPE(T,R) > r(long(q.size()));
+        for (unsigned int i=0; i<q.size(); ++i) r(i) = q[i];
         world.gop.fence();
         return r;
     }
 
 
-    /// Computes the inner product of a function with a function vector - q(i) = inner(f,g[i])
+    /// Starts computing the inner product of a function with a function vector - q(i) = inner(f,g[i])
+
+    /// As for \c norm2s_async, only the global sum is left outstanding on return.
     template <typename T, typename R, std::size_t NDIM>
-    Tensor< TENSOR_RESULT_TYPE(T,R) > inner(World& world,
+    Future< std::vector<TENSOR_RESULT_TYPE(T,R)> > inner_async(World& world,
                                             const Function<T,NDIM>& f,
                                             const std::vector< Function<R,NDIM> >& g) {
         PROFILE_BLOCK(Vinner);
         long n=g.size();
-        Tensor< TENSOR_RESULT_TYPE(T,R) > r(n);
+        std::vector<TENSOR_RESULT_TYPE(T,R)> r(n);
 
         f.compress();
         compress(world, g);
 
         for (long i=0; i<n; ++i) {
-            r(i) = f.inner_local(g[i]);
+            r[i] = f.inner_local(g[i]);
         }
 
-        world.taskq.fence();
-        world.gop.sum(r.ptr(),n);
+        return world.gop.isum(r);
+    }
+
+    /// Computes the inner product of a function with a function vector - q(i) = inner(f,g[i])
+    template <typename T, typename R, std::size_t NDIM>
+    Tensor< TENSOR_RESULT_TYPE(T,R) > inner(World& world,
+                                            const Function<T,NDIM>& f,
+                                            const std::vector< Function<R,NDIM> >& g) {
+        const std::vector<TENSOR_RESULT_TYPE(T,R)> q = inner_async(world, f, g).get();
+        Tensor< TENSOR_RESULT_TYPE(T,R) > r(long(q.size()));
+        for (unsigned int i=0; i<q.size(); ++i) r(i) = q[i];
         world.gop.fence();
         return r;
     }
@@ -1121,6 +1161,8 @@ namespace madness {
     }
 
     /// load a vector of functions
+
+    /// The functions may have been saved by a job with a different number of processes
     template<typename T, size_t NDIM>
     void load_function(World& world, std::vector<Function<T,NDIM> >& f,
             const std::string name) {
@@ -1133,12 +1175,14 @@ namespace madness {
     }
 
     /// save a vector of functions
+
+    /// @param[in] nio  the number of processes writing a file
     template<typename T, size_t NDIM>
-    void save_function(const std::vector<Function<T,NDIM> >& f, const std::string name) {
+    void save_function(const std::vector<Function<T,NDIM> >& f, const std::string name, int nio=1) {
         if (f.size()>0) {
             World& world=f.front().world();
             if (world.rank()==0) print("saving vector of functions",name);
-            archive::ParallelOutputArchive ar(world, name.c_str(), 1);
+            archive::ParallelOutputArchive ar(world, name.c_str(), nio);
             std::size_t fsize=f.size();
             ar & fsize;
             for (std::size_t i=0; i<fsize; ++i) ar & f[i];
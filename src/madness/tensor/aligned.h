@@ -114,6 +114,21 @@ namespace madness {
         madness::cblas::axpy((integer)n, cs, (complex_real8*)b, 1, (complex_real8*)a, 1);
     }
 
+    /// Accumulates a single precision vector into a double precision one
+    static
+    inline
+    void aligned_axpy(long n, double* restrict a, const float* restrict b, double s) {
+        long n4 = (n>>2)<<2;
+        long rem = n-n4;
+        for (long i=0; i<n4; i+=4,a+=4,b+=4) {
+            a[0] += s*b[0];
+            a[1] += s*b[1];
+            a[2] += s*b[2];
+            a[3] += s*b[3];
+        }
+        for (long i=0; i<rem; ++i) *a++ += s * *b++;
+    }
+
     template <typename T, typename Q>
     static
     inline
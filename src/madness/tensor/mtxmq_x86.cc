@@ -0,0 +1,458 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+
+  $Id$
+*/
+
+/// \file tensor/mtxmq_x86.cc
+/// \brief x86 \c mTxmq kernels with run-time instruction set dispatch
+
+#include <madness/madness_config.h>
+#include <madness/world/madness_exception.h>
+#include <madness/tensor/mxm.h>
+
+#ifdef MADNESS_HAVE_MTXMQ_X86
+
+#include <algorithm>
+#include <atomic>
+#include <complex>
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+
+// The AVX2 and AVX-512 kernels are compiled for their instruction set
+// within this file, whatever the flags of the build, and only called if
+// the CPU supports it.
+#if (defined(__GNUC__) && !defined(__INTEL_COMPILER) && (__GNUC__ >= 5)) || defined(__clang__)
+#  define MADNESS_MTXMQ_PRAGMA(x) _Pragma(#x)
+#  if defined(__clang__)
+#    define MADNESS_MTXMQ_TARGET_BEGIN(isa) \
+        MADNESS_MTXMQ_PRAGMA(clang attribute push(__attribute__((target(isa))), apply_to = function))
+#    define MADNESS_MTXMQ_TARGET_END MADNESS_MTXMQ_PRAGMA(clang attribute pop)
+#  else
+#    define MADNESS_MTXMQ_TARGET_BEGIN(isa) \
+        MADNESS_MTXMQ_PRAGMA(GCC push_options) MADNESS_MTXMQ_PRAGMA(GCC target(isa))
+#    define MADNESS_MTXMQ_TARGET_END MADNESS_MTXMQ_PRAGMA(GCC pop_options)
+#  endif
+#  define MADNESS_MTXMQ_HAVE_TARGETS 1
+#endif
+
+// The (k, NDIM) pairs for which fast_transform_fixed has a kernel. Each
+// pair costs two instantiations per instruction set, so the lists may be
+// changed when building, for example with
+//     -D'MADNESS_FAST_TRANSFORM_K(X,d)=X(8,d) X(16,d)'
+// k must not exceed MADNESS_FAST_TRANSFORM_MAXK and NDIM must not exceed 6.
+// The defaults cover k=6..12 and 2k for filter and unfilter, in 3 and 6
+// dimensions.
+#ifndef MADNESS_FAST_TRANSFORM_K
+#define MADNESS_FAST_TRANSFORM_K(X,d) \
+    X(6,d) X(7,d) X(8,d) X(9,d) X(10,d) X(11,d) X(12,d) \
+    X(14,d) X(16,d) X(18,d) X(20,d) X(22,d) X(24,d)
+#endif
+#ifndef MADNESS_FAST_TRANSFORM_NDIM
+#define MADNESS_FAST_TRANSFORM_NDIM(Y) Y(3) Y(6)
+#endif
+#define MADNESS_FAST_TRANSFORM_MAXK 30
+
+namespace madness {
+
+    namespace {
+
+        /// Specialized transforms indexed by NDIM and k, null where there is none
+        struct Transforms {
+            typedef void (*fnT)(const double*, const double* const*, double*, double*);
+            typedef void (*ffnT)(const float*, const float* const*, float*, float*);
+            fnT dd[7][MADNESS_FAST_TRANSFORM_MAXK+1];   ///< Real tensor and matrices
+            fnT zd[7][MADNESS_FAST_TRANSFORM_MAXK+1];   ///< Complex tensor, real matrices
+            ffnT ff[7][MADNESS_FAST_TRANSFORM_MAXK+1];  ///< Single precision tensor and matrices
+        };
+
+        namespace sse2 {
+
+            struct V {
+                typedef double real;
+                typedef __m128d vec;
+                typedef int mask;
+                static const int W = 2, MR = 4, NV = 3;
+                static vec zero() { return _mm_setzero_pd(); }
+                static vec set1(double x) { return _mm_set1_pd(x); }
+                static vec load(const double* p) { return _mm_loadu_pd(p); }
+                static vec fma(vec a, vec b, vec c) { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+                static void store(double* p, vec x) { _mm_storeu_pd(p, x); }
+                // With two doubles per vector a partial vector has one element
+                static mask make_mask(int n) { return n; }
+                static vec load_n(const double* p, mask) { return _mm_load_sd(p); }
+                static void store_n(double* p, vec x, mask) { _mm_store_sd(p, x); }
+            };
+
+#include <madness/tensor/mtxmq_x86_kernel.h>
+
+        } // namespace sse2
+
+        namespace sse2f {
+
+            struct V {
+                typedef float real;
+                typedef __m128 vec;
+                typedef int mask;
+                static const int W = 4, MR = 4, NV = 3;
+                static vec zero() { return _mm_setzero_ps(); }
+                static vec set1(float x) { return _mm_set1_ps(x); }
+                static vec load(const float* p) { return _mm_loadu_ps(p); }
+                static vec fma(vec a, vec b, vec c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+                static void store(float* p, vec x) { _mm_storeu_ps(p, x); }
+                static mask make_mask(int n) { return n; }
+                static vec load_n(const float* p, mask n) {
+                    alignas(16) float t[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                    for (int i=0; i<n; ++i) t[i] = p[i];
+                    return _mm_load_ps(t);
+                }
+                static void store_n(float* p, vec x, mask n) {
+                    alignas(16) float t[4];
+                    _mm_store_ps(t, x);
+                    for (int i=0; i<n; ++i) p[i] = t[i];
+                }
+            };
+
+#include <madness/tensor/mtxmq_x86_kernel.h>
+
+        } // namespace sse2f
+
+#ifdef MADNESS_MTXMQ_HAVE_TARGETS
+
+        MADNESS_MTXMQ_TARGET_BEGIN("avx2,fma")
+        namespace avx2 {
+
+            struct V {
+                typedef double real;
+                typedef __m256d vec;
+                typedef __m256i mask;
+                static const int W = 4, MR = 4, NV = 3;
+                static vec zero() { return _mm256_setzero_pd(); }
+                static vec set1(double x) { return _mm256_set1_pd(x); }
+                static vec load(const double* p) { return _mm256_loadu_pd(p); }
+                static vec fma(vec a, vec b, vec c) { return _mm256_fmadd_pd(a, b, c); }
+                static void store(double* p, vec x) { _mm256_storeu_pd(p, x); }
+                static mask make_mask(int n) {
+                    return _mm256_cmpgt_epi64(_mm256_set1_epi64x(n), _mm256_set_epi64x(3, 2, 1, 0));
+                }
+                static vec load_n(const double* p, mask m) { return _mm256_maskload_pd(p, m); }
+                static void store_n(double* p, vec x, mask m) { _mm256_maskstore_pd(p, m, x); }
+            };
+
+#include <madness/tensor/mtxmq_x86_kernel.h>
+
+        } // namespace avx2
+
+        namespace avx2f {
+
+            struct V {
+                typedef float real;
+                typedef __m256 vec;
+                typedef __m256i mask;
+                static const int W = 8, MR = 4, NV = 3;
+                static vec zero() { return _mm256_setzero_ps(); }
+                static vec set1(float x) { return _mm256_set1_ps(x); }
+                static vec load(const float* p) { return _mm256_loadu_ps(p); }
+                static vec fma(vec a, vec b, vec c) { return _mm256_fmadd_ps(a, b, c); }
+                static void store(float* p, vec x) { _mm256_storeu_ps(p, x); }
+                static mask make_mask(int n) {
+                    return _mm256_cmpgt_epi32(_mm256_set1_epi32(n), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+                }
+                static vec load_n(const float* p, mask m) { return _mm256_maskload_ps(p, m); }
+                static void store_n(float* p, vec x, mask m) { _mm256_maskstore_ps(p, m, x); }
+            };
+
+#include <madness/tensor/mtxmq_x86_kernel.h>
+
+        } // namespace avx2f
+        MADNESS_MTXMQ_TARGET_END
+
+        MADNESS_MTXMQ_TARGET_BEGIN("avx512f")
+        namespace avx512 {
+
+            struct V {
+                typedef double real;
+                typedef __m512d vec;
+                typedef __mmask8 mask;
+                static const int W = 8, MR = 8, NV = 3;
+                static vec zero() { return _mm512_setzero_pd(); }
+                static vec set1(double x) { return _mm512_set1_pd(x); }
+                static vec load(const double* p) { return _mm512_loadu_pd(p); }
+                static vec fma(vec a, vec b, vec c) { return _mm512_fmadd_pd(a, b, c); }
+                static void store(double* p, vec x) { _mm512_storeu_pd(p, x); }
+                static mask make_mask(int n) { return mask((1u << n) - 1); }
+                static vec load_n(const double* p, mask m) { return _mm512_maskz_loadu_pd(m, p); }
+                static void store_n(double* p, vec x, mask m) { _mm512_mask_storeu_pd(p, m, x); }
+            };
+
+#include <madness/tensor/mtxmq_x86_kernel.h>
+
+        } // namespace avx512
+
+        namespace avx512f {
+
+            struct V {
+                typedef float real;
+                typedef __m512 vec;
+                typedef __mmask16 mask;
+                static const int W = 16, MR = 8, NV = 3;
+                static vec zero() { return _mm512_setzero_ps(); }
+                static vec set1(float x) { return _mm512_set1_ps(x); }
+                static vec load(const float* p) { return _mm512_loadu_ps(p); }
+                static vec fma(vec a, vec b, vec c) { return _mm512_fmadd_ps(a, b, c); }
+                static void store(float* p, vec x) { _mm512_storeu_ps(p, x); }
+                static mask make_mask(int n) { return mask((1u << n) - 1); }
+                static vec load_n(const float* p, mask m) { return _mm512_maskz_loadu_ps(m, p); }
+                static void store_n(float* p, vec x, mask m) { _mm512_mask_storeu_ps(p, m, x); }
+            };
+
+#include <madness/tensor/mtxmq_x86_kernel.h>
+
+        } // namespace avx512f
+        MADNESS_MTXMQ_TARGET_END
+
+#endif // MADNESS_MTXMQ_HAVE_TARGETS
+
+        typedef std::complex<double> complexT;
+
+        /// One implementation of each type combination of \c mTxmq
+        struct Kernels {
+            const char* name;
+            void (*dd)(long, long, long, double*, const double*, const double*, long);
+            void (*zz)(long, long, long, complexT*, const complexT*, const complexT*, long);
+            void (*dz)(long, long, long, complexT*, const double*, const complexT*, long);
+            void (*zd)(long, long, long, complexT*, const complexT*, const double*, long);
+            void (*ff)(long, long, long, float*, const float*, const float*, long);
+        };
+
+        template <typename aT, typename bT, typename cT>
+        void reference(long dimi, long dimj, long dimk, cT* c, const aT* a, const bT* b, long ldb) {
+            mTxmq_reference(dimi, dimj, dimk, c, a, b, ldb);
+        }
+
+        /// Indexed by \c MTxmqKernel
+        const Kernels kernels[] = {
+            {"reference", reference<double,double,double>, reference<complexT,complexT,complexT>,
+                          reference<double,complexT,complexT>, reference<complexT,double,complexT>,
+                          reference<float,float,float>},
+            {"sse2", sse2::mtxmq_dd, sse2::mtxmq_zz, sse2::mtxmq_dz, sse2::mtxmq_zd, sse2f::mtxmq_dd},
+#ifdef MADNESS_MTXMQ_HAVE_TARGETS
+            {"avx2", avx2::mtxmq_dd, avx2::mtxmq_zz, avx2::mtxmq_dz, avx2::mtxmq_zd, avx2f::mtxmq_dd},
+            {"avx512", avx512::mtxmq_dd, avx512::mtxmq_zz, avx512::mtxmq_dz, avx512::mtxmq_zd,
+                       avx512f::mtxmq_dd}
+#else
+            {"avx2", nullptr, nullptr, nullptr, nullptr, nullptr},
+            {"avx512", nullptr, nullptr, nullptr, nullptr, nullptr}
+#endif
+        };
+
+        std::atomic<const Kernels*> current(nullptr);
+
+        MTxmqKernel default_kernel() {
+            const char* name = getenv("MAD_MTXMQ");
+            if (name) {
+                for (int i=MTXMQ_REFERENCE; i<=MTXMQ_AVX512; ++i) {
+                    if (strcmp(name, kernels[i].name) == 0) {
+                        if (!mtxmq_kernel_supported(MTxmqKernel(i)))
+                            MADNESS_EXCEPTION("MAD_MTXMQ names a kernel this CPU or build does not support", i);
+                        return MTxmqKernel(i);
+                    }
+                }
+                MADNESS_EXCEPTION("MAD_MTXMQ is not one of reference, sse2, avx2 or avx512", 0);
+            }
+            for (int i=MTXMQ_AVX512; i>MTXMQ_SSE2; --i)
+                if (mtxmq_kernel_supported(MTxmqKernel(i))) return MTxmqKernel(i);
+            return MTXMQ_SSE2;
+        }
+
+        const Kernels& get_kernels() {
+            const Kernels* p = current.load(std::memory_order_relaxed);
+            if (!p) {
+                p = &kernels[default_kernel()];
+                current.store(p, std::memory_order_relaxed);
+            }
+            return *p;
+        }
+
+        /// Handles the arguments common to all types; returns true if there is work left
+        template <typename cT>
+        bool prepare(long dimi, long dimj, long dimk, cT* c, long& ldb) {
+            if (ldb == -1) ldb = dimj;
+            MADNESS_ASSERT(ldb >= dimj);
+            if (dimi == 0 || dimj == 0) return false;
+            if (dimk == 0) {
+                std::fill(c, c + dimi*dimj, cT(0.0));
+                return false;
+            }
+            return true;
+        }
+
+        /// Flushes denormal inputs and results to zero while in scope
+
+        /// The products of the small elements of operator blocks and of
+        /// coefficients underflow the range of single precision far more
+        /// often than that of double, and the microcode assists for
+        /// denormals make the single precision kernels several times slower.
+        class FlushDenormals {
+            const unsigned int csr;
+        public:
+            FlushDenormals() : csr(_mm_getcsr()) {_mm_setcsr(csr | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);}
+            ~FlushDenormals() {_mm_setcsr(csr);}
+        };
+
+        /// The specialized transforms of each kernel; none for the reference
+        struct TransformTables {
+            Transforms tables[MTXMQ_AVX512+1];
+
+            TransformTables() {
+                memset(tables, 0, sizeof(tables));
+                sse2::fill_transforms(tables[MTXMQ_SSE2]);
+                sse2f::fill_transforms(tables[MTXMQ_SSE2]);
+#ifdef MADNESS_MTXMQ_HAVE_TARGETS
+                avx2::fill_transforms(tables[MTXMQ_AVX2]);
+                avx2f::fill_transforms(tables[MTXMQ_AVX2]);
+                avx512::fill_transforms(tables[MTXMQ_AVX512]);
+                avx512f::fill_transforms(tables[MTXMQ_AVX512]);
+#endif
+            }
+        };
+
+        const Transforms& get_transforms() {
+            static const TransformTables t;
+            return t.tables[get_mtxmq_kernel()];
+        }
+
+        /// The specialized transform for (k, ndim) of one table, or null
+        template <typename fnT>
+        fnT find_transform(const fnT (&table)[7][MADNESS_FAST_TRANSFORM_MAXK+1], long k, long ndim) {
+            if (k < 1 || k > MADNESS_FAST_TRANSFORM_MAXK || ndim < 1 || ndim > 6) return nullptr;
+            return table[ndim][k];
+        }
+
+    } // namespace
+
+    bool fast_transform_fixed(long k, long ndim, const double* t, const double* const* c,
+                              double* result, double* work) {
+        Transforms::fnT f = find_transform(get_transforms().dd, k, ndim);
+        if (!f) return false;
+        f(t, c, result, work);
+        return true;
+    }
+
+    bool fast_transform_fixed(long k, long ndim, const complexT* t, const double* const* c,
+                              complexT* result, complexT* work) {
+        Transforms::fnT f = find_transform(get_transforms().zd, k, ndim);
+        if (!f) return false;
+        f(reinterpret_cast<const double*>(t), c, reinterpret_cast<double*>(result),
+          reinterpret_cast<double*>(work));
+        return true;
+    }
+
+    bool fast_transform_fixed(long k, long ndim, const float* t, const float* const* c,
+                              float* result, float* work) {
+        Transforms::ffnT f = find_transform(get_transforms().ff, k, ndim);
+        if (!f) return false;
+        FlushDenormals ftz;
+        f(t, c, result, work);
+        return true;
+    }
+
+    bool mtxmq_kernel_supported(MTxmqKernel kernel) {
+        switch (kernel) {
+        case MTXMQ_REFERENCE:
+        case MTXMQ_SSE2:
+            return true;
+#ifdef MADNESS_MTXMQ_HAVE_TARGETS
+        case MTXMQ_AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        case MTXMQ_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+        }
+    }
+
+    MTxmqKernel get_mtxmq_kernel() {
+        return MTxmqKernel(&get_kernels() - kernels);
+    }
+
+    void set_mtxmq_kernel(MTxmqKernel kernel) {
+        MADNESS_ASSERT(mtxmq_kernel_supported(kernel));
+        current.store(&kernels[kernel], std::memory_order_relaxed);
+    }
+
+    const char* mtxmq_kernel_name(MTxmqKernel kernel) {
+        MADNESS_ASSERT(kernel >= MTXMQ_REFERENCE && kernel <= MTXMQ_AVX512);
+        return kernels[kernel].name;
+    }
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double* restrict c, const double* a, const double* b, long ldb) {
+        if (prepare(dimi, dimj, dimk, c, ldb))
+            get_kernels().dd(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               complexT* restrict c, const complexT* a, const complexT* b, long ldb) {
+        if (prepare(dimi, dimj, dimk, c, ldb))
+            get_kernels().zz(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               complexT* restrict c, const double* a, const complexT* b, long ldb) {
+        if (prepare(dimi, dimj, dimk, c, ldb))
+            get_kernels().dz(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               complexT* restrict c, const complexT* a, const double* b, long ldb) {
+        if (prepare(dimi, dimj, dimk, c, ldb))
+            get_kernels().zd(dimi, dimj, dimk, c, a, b, ldb);
+    }
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               float* restrict c, const float* a, const float* b, long ldb) {
+        if (prepare(dimi, dimj, dimk, c, ldb)) {
+            FlushDenormals ftz;
+            get_kernels().ff(dimi, dimj, dimk, c, a, b, ldb);
+        }
+    }
+
+} // namespace madness
+
+#endif // MADNESS_HAVE_MTXMQ_X86
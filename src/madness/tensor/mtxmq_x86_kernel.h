@@ -0,0 +1,321 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+
+
+  $Id$
+*/
+
+/// \file tensor/mtxmq_x86_kernel.h
+/// \brief Register-blocked \c mTxmq kernels for one x86 instruction set
+
+// This file is included by mtxmq_x86.cc once per instruction set, inside a
+// namespace that defines the vector traits \c V and, for AVX2 and AVX-512,
+// within a region compiled for that instruction set. There is therefore no
+// include guard. \c V provides
+//
+//    real                          the element type, double or float
+//    vec, mask                     vector of W reals and a tail mask
+//    W, MR, NV                     reals per vector, rows and vectors per tile
+//    zero(), set1(x), load(p), fma(a,b,c), store(p,x)
+//    make_mask(n), load_n(p,m), store_n(p,x,m)   first n<W elements only
+//
+// It also expects \c Transforms and the lists of specialized transforms,
+// \c MADNESS_FAST_TRANSFORM_K and \c MADNESS_FAST_TRANSFORM_NDIM.
+//
+// All pointers and strides are in units of real. Complex numbers are
+// stored as (real, imaginary) pairs; only the real mode is used with float.
+
+typedef V::real real;
+
+/// How the elements of a, b and c are interpreted
+enum Mode {
+    REAL,   ///< Real a; real b and c, or complex b and c as pairs of reals
+    ZZ,     ///< Complex a, b and c
+    ZD      ///< Complex a, real b, complex c
+};
+
+/// Computes an \c mr by \c nv vector tile of c for all k
+
+/// \c a points to a(0,i0) and advances by \c astride per k; \c b points to
+/// b(0,j0) and advances by \c ldb per k; \c c points to c(i0,j0) with
+/// rows \c ldc apart. If \c TAIL only the first \c ntail elements of the
+/// last vector are loaded and stored. A nonzero \c DIMK replaces \c dimk
+/// so that the loop over k may be unrolled.
+template <int MODE, int MR, int NV, bool TAIL, long DIMK=0>
+inline void tile(long dimk, const real* restrict a, long astride,
+                 const real* restrict b, long ldb,
+                 real* restrict c, long ldc, int ntail) {
+    const int W = V::W;
+    const bool cplx = (MODE != REAL);
+    const typename V::mask m = V::make_mask(TAIL ? ntail : W);
+
+    typename V::vec acc[MR][NV], acci[MR][NV];
+    for (int r=0; r<MR; ++r) {
+        for (int v=0; v<NV; ++v) {
+            acc[r][v] = V::zero();
+            if (cplx) acci[r][v] = V::zero();
+        }
+    }
+
+    const long nk = DIMK ? DIMK : dimk;
+    for (long k=0; k<nk; ++k, a+=astride, b+=ldb) {
+        typename V::vec bv[NV];
+        for (int v=0; v<NV; ++v)
+            bv[v] = (TAIL && v==NV-1) ? V::load_n(b+v*W, m) : V::load(b+v*W);
+        for (int r=0; r<MR; ++r) {
+            if (cplx) {
+                const typename V::vec ar = V::set1(a[2*r]);
+                const typename V::vec ai = V::set1(a[2*r+1]);
+                for (int v=0; v<NV; ++v) {
+                    acc[r][v] = V::fma(ar, bv[v], acc[r][v]);
+                    acci[r][v] = V::fma(ai, bv[v], acci[r][v]);
+                }
+            }
+            else {
+                const typename V::vec ar = V::set1(a[r]);
+                for (int v=0; v<NV; ++v)
+                    acc[r][v] = V::fma(ar, bv[v], acc[r][v]);
+            }
+        }
+    }
+
+    for (int r=0; r<MR; ++r) {
+        real* restrict cr = c + r*ldc;
+        for (int v=0; v<NV; ++v) {
+            const bool last = (TAIL && v==NV-1);
+            if (MODE == REAL) {
+                if (last) V::store_n(cr+v*W, acc[r][v], m);
+                else V::store(cr+v*W, acc[r][v]);
+            }
+            else {
+                // The imaginary part of a contributes i*a_im*b
+                real re[W], im[W];
+                V::store(re, acc[r][v]);
+                V::store(im, acci[r][v]);
+                const int n = last ? ntail : W;
+                if (MODE == ZZ) {
+                    real* restrict p = cr + v*W;
+                    for (int q=0; q<n; q+=2) {
+                        p[q  ] = re[q  ] - im[q+1];
+                        p[q+1] = re[q+1] + im[q  ];
+                    }
+                }
+                else {
+                    real* restrict p = cr + 2*v*W;
+                    for (int q=0; q<n; ++q) {
+                        p[2*q  ] = re[q];
+                        p[2*q+1] = im[q];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Selects the tile with \c nv vectors, the last one partial if \c ntail<W
+template <int MODE, int MR>
+inline void tiles(int nv, long dimk, const real* a, long astride,
+                 const real* b, long ldb, real* c, long ldc, int ntail) {
+    const bool tail = (ntail != V::W);
+    switch (nv) {
+    case 1:
+        if (tail) tile<MODE,MR,1,true >(dimk, a, astride, b, ldb, c, ldc, ntail);
+        else      tile<MODE,MR,1,false>(dimk, a, astride, b, ldb, c, ldc, ntail);
+        break;
+    case 2:
+        if (tail) tile<MODE,MR,2,true >(dimk, a, astride, b, ldb, c, ldc, ntail);
+        else      tile<MODE,MR,2,false>(dimk, a, astride, b, ldb, c, ldc, ntail);
+        break;
+    default:
+        if (tail) tile<MODE,MR,V::NV,true >(dimk, a, astride, b, ldb, c, ldc, ntail);
+        else      tile<MODE,MR,V::NV,false>(dimk, a, astride, b, ldb, c, ldc, ntail);
+        break;
+    }
+}
+
+/// c(i,j) = sum(k) a(k,i)*b(k,j) with \c nb reals per row of b
+
+/// For \c ZZ \c nb is twice the number of complex columns; \c ldb is in
+/// reals in every mode.
+template <int MODE>
+void mtxmq(long dimi, long nb, long dimk, real* restrict c,
+           const real* restrict a, const real* restrict b, long ldb) {
+    const int W = V::W;
+    const int MR = (MODE == REAL) ? V::MR : V::MR/2;
+    const long astride = (MODE == REAL) ? dimi : 2*dimi;
+    const long ldc = (MODE == ZD) ? 2*nb : nb;
+    const long cstep = (MODE == ZD) ? 2 : 1; // reals of c per real of b
+
+    for (long i0=0; i0<dimi; i0+=MR) {
+        const long mr = std::min(long(MR), dimi-i0);
+        const real* ai = a + ((MODE == REAL) ? i0 : 2*i0);
+        real* ci = c + i0*ldc;
+        for (long j0=0; j0<nb; j0+=V::NV*W) {
+            const long nj = std::min(long(V::NV*W), nb-j0);
+            const int nv = int((nj + W - 1)/W);
+            const int ntail = int(nj - (nv-1)*W);
+            if (mr == MR) {
+                tiles<MODE,MR>(nv, dimk, ai, astride, b+j0, ldb, ci+j0*cstep, ldc, ntail);
+            }
+            else {
+                for (long r=0; r<mr; ++r)
+                    tiles<MODE,1>(nv, dimk, ai + ((MODE == REAL) ? r : 2*r), astride,
+                                 b+j0, ldb, ci+r*ldc+j0*cstep, ldc, ntail);
+            }
+        }
+    }
+}
+
+/// One row block of \c mtxmq_fixed: \c MR rows of c, all \c NB columns
+template <int MODE, int MR, int NB, int DIMK>
+inline void fixed_rows(const real* a, long astride, const real* b, real* c, long ldc) {
+    const int W = V::W;
+    const int JB = V::NV*W;                                 // reals of b per full tile
+    const int NFULL = NB/JB;
+    const int NREST = NB - NFULL*JB;
+    const int NVR = NREST ? (NREST + W - 1)/W : 1;
+    const int TAILR = NREST - (NVR-1)*W;
+    const long cstep = (MODE == ZD) ? 2 : 1;
+
+    for (int jb=0; jb<NFULL; ++jb)
+        tile<MODE,MR,V::NV,false,DIMK>(DIMK, a, astride, b+jb*JB, NB, c+jb*JB*cstep, ldc, W);
+    if (NREST)
+        tile<MODE,MR,NVR,(TAILR!=W),DIMK>(DIMK, a, astride, b+NFULL*JB, NB,
+                                          c+NFULL*JB*cstep, ldc, TAILR);
+}
+
+/// \c mtxmq with \c dimi, \c nb and \c dimk fixed at compile time and \c ldb=nb
+
+/// Only the \c REAL and \c ZD modes are provided.
+template <int MODE, long DIMI, int NB, int DIMK>
+void mtxmq_fixed(real* restrict c, const real* restrict a, const real* restrict b) {
+    const int MR = (MODE == REAL) ? V::MR : V::MR/2;
+    const long NI = DIMI - DIMI%MR;                        // rows in full blocks
+    const long astride = (MODE == REAL) ? DIMI : 2*DIMI;
+    const long ldc = (MODE == ZD) ? 2*NB : NB;
+    const int ai = (MODE == REAL) ? 1 : 2;                  // reals of a per i
+
+    for (long i0=0; i0<NI; i0+=MR)
+        fixed_rows<MODE,MR,NB,DIMK>(a + ai*i0, astride, b, c + i0*ldc, ldc);
+    for (long i0=NI; i0<DIMI; ++i0)
+        fixed_rows<MODE,1,NB,DIMK>(a + ai*i0, astride, b, c + i0*ldc, ldc);
+}
+
+/// B to the power E at compile time
+template <long B, int E>
+struct Power {
+    static const long value = B*Power<B,E-1>::value;
+};
+
+template <long B>
+struct Power<B,0> {
+    static const long value = 1;
+};
+
+/// Transforms all dimensions of a \c K^NDIM tensor, dimension d by the \c K*K matrix \c c[d]
+
+/// The \c NDIM passes of \c mtxmq_fixed run back to back. Their
+/// intermediate results are kept in a buffer on the stack if two of them
+/// fit in 32 kB, so that they stay in the L1 cache; otherwise they
+/// alternate between \c work and \c result as in \c fast_transform.
+template <int MODE, int K, int NDIM>
+void transform_fixed(const real* t, const real* const* c, real* result, real* work) {
+    static const long DIMI = Power<K,NDIM-1>::value;
+    static const long N = DIMI*K*((MODE == REAL) ? 1 : 2);  // reals per tensor
+    static const bool SMALL = (2*N*sizeof(real) <= 32768);
+
+    alignas(64) real buf[SMALL ? 2*N : 1];
+    real* w0 = work;
+    real* w1 = result;
+    if (SMALL) {
+        w0 = buf;
+        w1 = buf + N;
+    }
+    else if (NDIM & 1) {
+        std::swap(w0, w1);
+    }
+
+    const real* src = t;
+    for (int d=0; d<NDIM; ++d) {
+        real* dst = (d == NDIM-1) ? result : ((d & 1) ? w1 : w0);
+        mtxmq_fixed<MODE,DIMI,K,K>(dst, src, c[d]);
+        src = dst;
+    }
+}
+
+// Entry points with the argument types of madness::mTxmq
+
+inline void mtxmq_dd(long dimi, long dimj, long dimk, real* c,
+                     const real* a, const real* b, long ldb) {
+    mtxmq<REAL>(dimi, dimj, dimk, c, a, b, ldb);
+}
+
+inline void mtxmq_zz(long dimi, long dimj, long dimk, std::complex<real>* c,
+                     const std::complex<real>* a, const std::complex<real>* b, long ldb) {
+    mtxmq<ZZ>(dimi, 2*dimj, dimk, reinterpret_cast<real*>(c),
+              reinterpret_cast<const real*>(a), reinterpret_cast<const real*>(b), 2*ldb);
+}
+
+inline void mtxmq_dz(long dimi, long dimj, long dimk, std::complex<real>* c,
+                     const real* a, const std::complex<real>* b, long ldb) {
+    mtxmq<REAL>(dimi, 2*dimj, dimk, reinterpret_cast<real*>(c),
+                a, reinterpret_cast<const real*>(b), 2*ldb);
+}
+
+inline void mtxmq_zd(long dimi, long dimj, long dimk, std::complex<real>* c,
+                     const std::complex<real>* a, const real* b, long ldb) {
+    mtxmq<ZD>(dimi, dimj, dimk, reinterpret_cast<real*>(c),
+              reinterpret_cast<const real*>(a), b, ldb);
+}
+
+/// Stores the specialized transforms for (K, NDIM) of real tensors
+template <int K, int NDIM>
+inline void set_transforms(Transforms& tr, float) {
+    tr.ff[NDIM][K] = transform_fixed<REAL,K,NDIM>;
+}
+
+/// Stores the specialized transforms for (K, NDIM) of real and complex tensors
+template <int K, int NDIM>
+inline void set_transforms(Transforms& tr, double) {
+    tr.dd[NDIM][K] = transform_fixed<REAL,K,NDIM>;
+    tr.zd[NDIM][K] = transform_fixed<ZD,K,NDIM>;
+}
+
+/// Fills the table of specialized transforms with the pairs (k, NDIM) of
+/// \c MADNESS_FAST_TRANSFORM_K and \c MADNESS_FAST_TRANSFORM_NDIM
+inline void fill_transforms(Transforms& tr) {
+#define MADNESS_FAST_TRANSFORM_ENTRY(k,d) \
+    static_assert(k <= MADNESS_FAST_TRANSFORM_MAXK && d <= 6, "fast_transform: k or NDIM too large"); \
+    set_transforms<k,d>(tr, real());
+#define MADNESS_FAST_TRANSFORM_ROW(d) MADNESS_FAST_TRANSFORM_K(MADNESS_FAST_TRANSFORM_ENTRY,d)
+    MADNESS_FAST_TRANSFORM_NDIM(MADNESS_FAST_TRANSFORM_ROW)
+#undef MADNESS_FAST_TRANSFORM_ROW
+#undef MADNESS_FAST_TRANSFORM_ENTRY
+}
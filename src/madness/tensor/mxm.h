@@ -36,6 +36,7 @@
 #define MADNESS_TENSOR_MXM_H__INCLUDED
 
 #include <madness/madness_config.h>
+#include <complex>
 
 #ifdef HAVE_INTEL_MKL
 #include <madness/tensor/cblas.h>
@@ -597,28 +598,111 @@ namespace madness {
         bgpmTxmq(ni, nj, nk, c, a, b);
     }
 
-// #elif defined(X86_64) && !defined(DISABLE_SSE3)
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double* restrict c, const double* a, const double* b);
-
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double_complex* restrict c, const double_complex* a, const double_complex* b);
-
-// #ifndef __INTEL_COMPILER
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double_complex* restrict c, const double_complex* a, const double* b);
-// #endif
-
-// #elif defined(X86_32)
-//     template <>
-//     void mTxmq(long dimi, long dimj, long dimk,
-//                double* restrict c, const double* a, const double* b);
+#elif defined(X86_64)
+
+#define MADNESS_HAVE_MTXMQ_X86 1
+
+    /// Implementations of \c mTxmq on x86
+
+    /// The SSE2, AVX2 and AVX-512 kernels are register blocked for the
+    /// shapes of MADNESS (long \c dimi, short \c dimj and \c dimk) and
+    /// are all compiled into the library whatever the build flags, each
+    /// with a single precision variant for real \c float matrices. By
+    /// default the fastest one the CPU supports is used; the environment
+    /// variable `MAD_MTXMQ` (one of `reference`, `sse2`, `avx2` or
+    /// `avx512`) or \c set_mtxmq_kernel() selects another.
+    enum MTxmqKernel {
+        MTXMQ_REFERENCE,    ///< \c mTxmq_reference
+        MTXMQ_SSE2,         ///< 2 doubles per vector
+        MTXMQ_AVX2,         ///< 4 doubles per vector, fused multiply-add
+        MTXMQ_AVX512        ///< 8 doubles per vector, fused multiply-add
+    };
+
+    /// Test if an \c mTxmq kernel was compiled and the CPU supports it
+
+    /// \param[in] kernel The kernel.
+    /// \return True if \c kernel may be selected.
+    bool mtxmq_kernel_supported(MTxmqKernel kernel);
+
+    /// The kernel used by \c mTxmq
+
+    /// \return The kernel.
+    MTxmqKernel get_mtxmq_kernel();
+
+    /// Select the kernel used by \c mTxmq
+
+    /// \param[in] kernel The kernel, which must be supported.
+    void set_mtxmq_kernel(MTxmqKernel kernel);
+
+    /// Name of an \c mTxmq kernel as used by `MAD_MTXMQ`
+
+    /// \param[in] kernel The kernel.
+    /// \return The name.
+    const char* mtxmq_kernel_name(MTxmqKernel kernel);
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               double* restrict c, const double* a, const double* b, long ldb);
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               std::complex<double>* restrict c, const std::complex<double>* a,
+               const std::complex<double>* b, long ldb);
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               std::complex<double>* restrict c, const double* a,
+               const std::complex<double>* b, long ldb);
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               std::complex<double>* restrict c, const std::complex<double>* a,
+               const double* b, long ldb);
+
+    template <>
+    void mTxmq(long dimi, long dimj, long dimk,
+               float* restrict c, const float* a, const float* b, long ldb);
+
+    bool fast_transform_fixed(long k, long ndim, const double* t, const double* const* c,
+                              double* result, double* work);
+
+    bool fast_transform_fixed(long k, long ndim, const std::complex<double>* t,
+                              const double* const* c, std::complex<double>* result,
+                              std::complex<double>* work);
+
+    bool fast_transform_fixed(long k, long ndim, const float* t, const float* const* c,
+                              float* result, float* work);
+
 #endif // HAVE_IBMBGQ
 
 #endif // HAVE_INTEL_MKL
+
+    /// Transform all dimensions of a \c k^ndim tensor with a kernel specialized for \c k and \c ndim
+
+    /// Computes the same as \c ndim successive calls
+    /// \code
+    ///    mTxmq(k^(ndim-1), k, k, ..., c[d])
+    /// \endcode
+    /// transforming dimension \c d by the \c k*k matrix \c c[d], as in
+    /// \c fast_transform. On x86 the kernels for real (double or float) or
+    /// complex tensors and real matrices are instantiated at build time for a set of \c k and
+    /// \c ndim (see \c MADNESS_FAST_TRANSFORM_K in mtxmq_x86.cc), with their
+    /// loops unrolled for \c k and, for small tensors, the intermediate
+    /// results kept in L1. This overload is used for all other types.
+    ///
+    /// \param[in] k The size of every dimension.
+    /// \param[in] ndim The number of dimensions.
+    /// \param[in] t The input tensor.
+    /// \param[in] c The \c ndim matrices.
+    /// \param[out] result The transformed tensor, distinct from \c t.
+    /// \param work Workspace of the size of \c t, distinct from \c t and \c result.
+    /// \return False, having done nothing, if there is no kernel for
+    ///    \c k, \c ndim and the types or the \c mTxmq kernel is the reference.
+    template <typename T, typename Q, typename R>
+    inline bool fast_transform_fixed(long k, long ndim, const T* t, const Q* const* c,
+                                     R* result, R* work) {
+        return false;
+    }
     
 }    
 #endif // MADNESS_TENSOR_MXM_H__INCLUDED
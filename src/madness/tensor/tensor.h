@@ -35,6 +35,8 @@
 #include <madness/madness_config.h>
 #include <madness/misc/ran.h>
 #include <madness/world/posixmem.h>
+#include <madness/world/numa.h>
+#include <madness/world/poolmem.h>
 
 #include <memory>
 #include <complex>
@@ -372,8 +374,17 @@ namespace madness {
                     _p = new T[_size];
                     _shptr = std::shared_ptr<T>(_p);
 #else
-                    if (posix_memalign((void **) &_p, TENSOR_ALIGNMENT, sizeof(T)*_size)) throw 1;
-                    _shptr.reset(_p, &free);
+                    if (PoolMem::enabled()) {
+                        // Size-class pool; PoolMem::alignment >= TENSOR_ALIGNMENT
+                        _p = static_cast<T*>(PoolMem::allocate(sizeof(T)*_size));
+                        _shptr.reset(_p, &PoolMem::deallocate);
+                    }
+                    else {
+                        if (posix_memalign((void **) &_p, TENSOR_ALIGNMENT, sizeof(T)*_size)) throw 1;
+                        _shptr.reset(_p, &free);
+                    }
+                    // Zeroing below already touches every page from this thread
+                    if (!dozero) NUMATopology::first_touch(_p, sizeof(T)*_size);
 #endif
                 }
                 catch (...) {
@@ -540,6 +551,25 @@ namespace madness {
             allocate(d.size(), d.size() ? &(d[0]) : 0, dozero);
         }
 
+        /// Create a tensor that refers to contiguous data owned by someone else
+
+        /// The data are not copied.  \c owner is kept alive as long as the
+        /// tensor or a copy of it refers to the data.
+        /// @param[in] d Vector containing size of each dimension
+        /// @param[in] p The data
+        /// @param[in] owner Keeps the data alive
+        Tensor(const std::vector<long>& d, T* p, const std::shared_ptr<void>& owner) : _p(0) {
+#ifdef TENSOR_USE_SHARED_ALIGNED_ARRAY
+            allocate(d.size(), d.size() ? &(d[0]) : 0, false);
+            std::copy(p, p+_size, _p);
+#else
+            _id = TensorTypeData<T>::id;
+            set_dims_and_size(d.size(), d.size() ? &(d[0]) : 0);
+            _p = p;
+            _shptr = std::shared_ptr<T>(owner, p);
+#endif
+        }
+
         /// Politically incorrect general constructor.
 
         /// @param[in] nd Number of dimensions
@@ -2410,6 +2440,14 @@ namespace madness {
         long dimi = 1;
         for (int n=1; n<t.ndim(); ++n) dimi *= dimj;
 
+        // Kernels specialized for (k, ndim) if this pair was compiled
+        if (c.dim(0) == dimj) {
+            const Q* cs[TENSOR_MAXDIM];
+            for (int n=0; n<t.ndim(); ++n) cs[n] = pc;
+            if (fast_transform_fixed(dimj, t.ndim(), t.ptr(), cs, result.ptr(), workspace.ptr()))
+                return result;
+        }
+
 #if HAVE_IBMBGQ
         long nij = dimi*dimj;
         if (IS_UNALIGNED(pc) || IS_UNALIGNED(t0) || IS_UNALIGNED(t1)) {
@@ -2440,6 +2478,24 @@ namespace madness {
         return result;
     }
 
+    /// fast_transform() for a \c K^NDIM tensor with \c K and \c NDIM known at compile time
+
+    /// \ingroup tensor
+    /// Checks the dimensions of \c t and \c c and uses the kernel
+    /// specialized for \c K and \c NDIM (see fast_transform_fixed()) if
+    /// there is one, or else the general code of fast_transform().
+    template <long K, long NDIM, class T, class Q>
+    Tensor< TENSOR_RESULT_TYPE(T,Q) >& fast_transform(const Tensor<T>& t, const Tensor<Q>& c,  Tensor< TENSOR_RESULT_TYPE(T,Q) >& result,
+            Tensor< TENSOR_RESULT_TYPE(T,Q) >& workspace) {
+        static_assert(K > 0 && NDIM > 0 && NDIM <= TENSOR_MAXDIM, "fast_transform: bad K or NDIM");
+        TENSOR_ASSERT(t.ndim() == NDIM, "fast_transform: tensor has the wrong number of dimensions", t.ndim(), &t);
+        TENSOR_ASSERT(c.ndim() == 2 && c.dim(0) == K && c.dim(1) == K, "fast_transform: matrix must be K*K", c.dim(0), &c);
+        for (long d=0; d<NDIM; ++d) {
+            TENSOR_ASSERT(t.dim(d) == K, "fast_transform: tensor dimension is not K", t.dim(d), &t);
+        }
+        return fast_transform(t, c, result, workspace);
+    }
+
     /// Return a new tensor holding the absolute value of each element of t
 
     /// \ingroup tensor
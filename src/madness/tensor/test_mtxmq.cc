@@ -45,6 +45,9 @@ int main() {std::cout << "x86 only\n"; return 0;}
 #include <stdlib.h>
 #include <math.h>
 //#include <xmmintrin.h>
+#include <algorithm>
+#include <complex>
+#include <vector>
 
 #include <madness/world/safempi.h>
 #include <madness/world/posixmem.h>
@@ -162,6 +165,260 @@ void trantimer(const char* s, long ni, long nj, long nk, double *a, double *b, d
   printf("%20s %3ld %3ld %3ld %8.2f %8.2f\n",s, ni,nj,nk, fastest, fastest_dgemm);
 }
 
+#ifdef MADNESS_HAVE_MTXMQ_X86
+
+typedef std::complex<double> double_complex;
+
+void ran_fill(int n, double_complex *a) {
+    while (n--) {
+        const double re = ran();
+        *a++ = double_complex(re, ran());
+    }
+}
+
+void ran_fill(int n, float *a) {
+    while (n--) *a++ = ran();
+}
+
+/// Compares one type combination of mTxmq with mTxmq_reference, with and without ldb > dimj
+template <typename aT, typename bT, typename cT>
+bool check_kernel(const char* kernel, const char* types, long nimax, long njmax, long nkmax,
+                  double tol=1e-13) {
+    const long ldbmax = njmax + 3;
+    std::vector<aT> a(nkmax*nimax);
+    std::vector<bT> b(nkmax*ldbmax);
+    std::vector<cT> c(nimax*njmax), d(nimax*njmax);
+    ran_fill(a.size(), a.data());
+    ran_fill(b.size(), b.data());
+
+    for (long ni=1; ni<=nimax; ++ni) {
+        for (long nj=1; nj<=njmax; ++nj) {
+            for (long nk=0; nk<=nkmax; ++nk) {
+                for (long ldb=nj; ldb<=nj+3; ldb+=3) {
+                    for (long i=0; i<ni*nj; ++i) c[i] = d[i] = cT(-1.0);
+                    mTxmq_reference(ni, nj, nk, c.data(), a.data(), b.data(), ldb);
+                    mTxmq(ni, nj, nk, d.data(), a.data(), b.data(), ldb);
+                    for (long i=0; i<ni*nj; ++i) {
+                        const double err = std::abs(d[i]-c[i]);
+                        if (err > tol) {
+                            printf("test_mtxmq: %s %s error %ld %ld %ld ldb=%ld %e\n",
+                                   kernel, types, ni, nj, nk, ldb, err);
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/// Best rate in GF/s of mTxmq for one shape
+template <typename aT, typename bT, typename cT>
+double rate(long ni, long nj, long nk, cT* c, const aT* a, const bT* b, long ldb) {
+    // Flops per multiply-add: 2 (real), 8 (complex*complex), 4 (mixed)
+    const double nflop = 2.0*ni*nj*nk*(TensorTypeData<aT>::iscomplex ? 2 : 1)
+        *(TensorTypeData<bT>::iscomplex ? 2 : 1);
+    const long nloop = std::max(1L, long(2e7/nflop));
+    double fastest = 0.0;
+    for (int t=0; t<5; t++) {
+        double start = SafeMPI::Wtime();
+        for (long loop=0; loop<nloop; ++loop) mTxmq(ni,nj,nk,c,a,b,ldb);
+        start = SafeMPI::Wtime() - start;
+        const double r = 1.e-9*nflop*nloop/start;
+        crap(r,fastest,start);
+        if (r > fastest) fastest = r;
+    }
+    return fastest;
+}
+
+/// Prints GF/s of each supported kernel for one shape
+template <typename aT, typename bT, typename cT>
+void kernel_timer(const char* s, long ni, long nj, long nk, cT* c, const aT* a, const bT* b,
+                  long ldb=-1) {
+    const MTxmqKernel save = get_mtxmq_kernel();
+    printf("%24s %4ld %3ld %3ld", s, ni, nj, nk);
+    for (int kernel=MTXMQ_REFERENCE; kernel<=MTXMQ_AVX512; ++kernel) {
+        if (mtxmq_kernel_supported(MTxmqKernel(kernel))) {
+            set_mtxmq_kernel(MTxmqKernel(kernel));
+            printf(" %8.2f", rate(ni, nj, nk, c, a, b, ldb));
+        }
+        else {
+            printf(" %8s", "-");
+        }
+    }
+    printf("\n");
+    set_mtxmq_kernel(save);
+}
+
+/// Validates every supported kernel and prints a table of their speed
+bool test_kernels() {
+    const MTxmqKernel save = get_mtxmq_kernel();
+    printf("Default mTxmq kernel is %s\n", mtxmq_kernel_name(save));
+    bool ok = true;
+    for (int kernel=MTXMQ_REFERENCE; kernel<=MTXMQ_AVX512; ++kernel) {
+        const char* name = mtxmq_kernel_name(MTxmqKernel(kernel));
+        if (!mtxmq_kernel_supported(MTxmqKernel(kernel))) {
+            printf("Kernel %s is not supported\n", name);
+            continue;
+        }
+        printf("Testing kernel %s ... \n", name);
+        set_mtxmq_kernel(MTxmqKernel(kernel));
+        ok = ok && check_kernel<double,double,double>(name, "ddd", 19, 53, 13);
+        ok = ok && check_kernel<double_complex,double_complex,double_complex>(name, "zzz", 11, 29, 9);
+        ok = ok && check_kernel<double,double_complex,double_complex>(name, "dzz", 11, 29, 9);
+        ok = ok && check_kernel<double_complex,double,double_complex>(name, "zdz", 11, 29, 9);
+        ok = ok && check_kernel<float,float,float>(name, "sss", 19, 53, 13, 1e-4);
+    }
+    set_mtxmq_kernel(save);
+    if (!ok) return false;
+    printf("... OK!\n");
+
+    // Shapes of the two-scale and operator transforms: dimk = 2k or k, dimi = dimk^2
+    const long kmax = 60;
+    std::vector<double> a(kmax*kmax*kmax), b(kmax*kmax), c(kmax*kmax*kmax);
+    std::vector<double_complex> za(kmax*kmax*kmax), zb(kmax*kmax), zc(kmax*kmax*kmax);
+    std::vector<float> sa(kmax*kmax*kmax), sb(kmax*kmax), sc(kmax*kmax*kmax);
+    ran_fill(a.size(), a.data());
+    ran_fill(b.size(), b.data());
+    ran_fill(za.size(), za.data());
+    ran_fill(zb.size(), zb.data());
+    ran_fill(sa.size(), sa.data());
+    ran_fill(sb.size(), sb.data());
+
+    printf("%24s %4s %3s %3s %8s %8s %8s %8s (GF/s)\n", "type", "M", "N", "K",
+           "ref", "sse2", "avx2", "avx512");
+    const long ks[] = {4, 6, 8, 10, 12, 14, 16, 20, 24, 28, 30};
+    for (long k : ks)
+        kernel_timer("real (k*k,k)T*(k,k)", k*k, k, k, c.data(), a.data(), b.data());
+    for (long k : ks)
+        kernel_timer("real (4k*k,2k)T*(2k,2k)", 4*k*k, 2*k, 2*k, c.data(), a.data(), b.data());
+    for (long k : ks)
+        kernel_timer("float (4k*k,2k)T*(2k,2k)", 4*k*k, 2*k, 2*k, sc.data(), sa.data(), sb.data());
+    for (long k : ks)
+        kernel_timer("real ldb=2k (2k,k)", 4*k*k, k, 2*k, c.data(), a.data(), b.data(), 2*k);
+    for (long k : ks)
+        kernel_timer("complex*complex", 4*k*k, 2*k, 2*k, zc.data(), za.data(), zb.data());
+    for (long k : ks)
+        kernel_timer("real*complex", 4*k*k, 2*k, 2*k, zc.data(), a.data(), zb.data());
+    for (long k : ks)
+        kernel_timer("complex*real", 4*k*k, 2*k, 2*k, zc.data(), za.data(), b.data());
+    return true;
+}
+
+/// The ndim passes of mTxmq that fast_transform uses without a specialized kernel
+template <typename T, typename C>
+void transform_passes(long k, long ndim, const T* t, const C* const* c, T* result, T* work) {
+    long dimi = 1;
+    for (long d=1; d<ndim; ++d) dimi *= k;
+    T* t0 = (ndim & 1) ? result : work;
+    T* t1 = (ndim & 1) ? work : result;
+    mTxmq(dimi, k, k, t0, t, c[0]);
+    for (long d=1; d<ndim; ++d) {
+        mTxmq(dimi, k, k, t1, t0, c[d]);
+        std::swap(t0, t1);
+    }
+}
+
+/// Best rate in GF/s of a transform of a k^ndim tensor
+template <typename T, typename C>
+double transform_rate(bool fixed, long k, long ndim, const T* t, const C* const* c, T* result, T* work) {
+    long size = 1;
+    for (long d=0; d<ndim; ++d) size *= k;
+    const double nflop = 2.0*size*k*ndim*(sizeof(T)/sizeof(C));
+    const long nloop = std::max(1L, long(2e7/nflop));
+    double fastest = 0.0;
+    for (int tries=0; tries<5; tries++) {
+        double start = SafeMPI::Wtime();
+        for (long loop=0; loop<nloop; ++loop) {
+            if (fixed) fast_transform_fixed(k, ndim, t, c, result, work);
+            else transform_passes(k, ndim, t, c, result, work);
+        }
+        start = SafeMPI::Wtime() - start;
+        const double r = 1.e-9*nflop*nloop/start;
+        crap(r,fastest,start);
+        if (r > fastest) fastest = r;
+    }
+    return fastest;
+}
+
+/// Compares fast_transform_fixed with mTxmq passes and prints the speed of both
+template <typename T, typename C=double>
+bool check_transform(const char* type, long k, long ndim, bool timing, double tol=1e-11) {
+    long size = 1;
+    for (long d=0; d<ndim; ++d) size *= k;
+    std::vector<T> t(size), r0(size), r1(size), work(size);
+    std::vector<C> cbuf(ndim*k*k);
+    ran_fill(t.size(), t.data());
+    ran_fill(cbuf.size(), cbuf.data());
+    const C* c[6];
+    for (long d=0; d<ndim; ++d) c[d] = cbuf.data() + d*k*k;
+
+    transform_passes(k, ndim, t.data(), c, r0.data(), work.data());
+    if (!fast_transform_fixed(k, ndim, t.data(), c, r1.data(), work.data())) {
+        printf("test_mtxmq: no specialized %s transform for k=%ld ndim=%ld\n", type, k, ndim);
+        return false;
+    }
+    for (long i=0; i<size; ++i) {
+        const double err = std::abs(r1[i]-r0[i]);
+        if (err > tol*std::max(1.0, double(std::abs(r0[i])))) {
+            printf("test_mtxmq: %s transform error k=%ld ndim=%ld %ld %e\n", type, k, ndim, i, err);
+            return false;
+        }
+    }
+
+    if (timing) {
+        const double passes = transform_rate(false, k, ndim, t.data(), c, r0.data(), work.data());
+        const double fixed = transform_rate(true, k, ndim, t.data(), c, r1.data(), work.data());
+        printf("%10s %4ld %3ld %8.2f %8.2f %8.2f\n", type, ndim, k, passes, fixed, fixed/passes);
+    }
+    return true;
+}
+
+/// Validates the specialized transforms of every supported kernel and prints their speedup
+bool test_transforms() {
+    const MTxmqKernel save = get_mtxmq_kernel();
+    const long ks[] = {6, 7, 8, 9, 10, 11, 12, 14, 16, 18, 20, 22, 24};
+    const long ks6[] = {6, 7, 8, 9, 10};
+    bool ok = true;
+    for (int kernel=MTXMQ_SSE2; kernel<=MTXMQ_AVX512; ++kernel) {
+        if (!mtxmq_kernel_supported(MTxmqKernel(kernel))) continue;
+        printf("Testing fast_transform_fixed with kernel %s ... \n", mtxmq_kernel_name(MTxmqKernel(kernel)));
+        set_mtxmq_kernel(MTxmqKernel(kernel));
+        for (long k : ks) {
+            ok = ok && check_transform<double>("real", k, 3, false);
+            ok = ok && check_transform<double_complex>("complex", k, 3, false);
+            ok = ok && check_transform<float,float>("float", k, 3, false, 1e-5);
+        }
+        for (long k : ks6) {
+            ok = ok && check_transform<double>("real", k, 6, false);
+            ok = ok && check_transform<double_complex>("complex", k, 6, false);
+            ok = ok && check_transform<float,float>("float", k, 6, false, 1e-5);
+        }
+    }
+    set_mtxmq_kernel(save);
+    if (!ok) return false;
+
+    // The reference kernel has no specialized transforms
+    set_mtxmq_kernel(MTXMQ_REFERENCE);
+    double t[8], r[8], w[8], c[4];
+    const double* cs[3] = {c, c, c};
+    ok = !fast_transform_fixed(2, 3, t, cs, r, w);
+    set_mtxmq_kernel(save);
+    if (!ok) return false;
+    printf("... OK!\n");
+
+    printf("fast_transform with kernel %s: mTxmq passes and specialized (GF/s)\n", mtxmq_kernel_name(save));
+    printf("%10s %4s %3s %8s %8s %8s\n", "type", "NDIM", "k", "passes", "fixed", "speedup");
+    for (long k : ks) check_transform<double>("real", k, 3, true);
+    for (long k : ks6) check_transform<double>("real", k, 6, true);
+    for (long k : ks) check_transform<double_complex>("complex", k, 3, true);
+    for (long k : ks) check_transform<float,float>("float", k, 3, true, 1e-5);
+    return true;
+}
+
+#endif // MADNESS_HAVE_MTXMQ_X86
+
 int main(int argc, char * argv[]) {
     const long nimax=30*30;
     const long njmax=100;
@@ -217,6 +474,11 @@ int main(int argc, char * argv[]) {
     }
     printf("... OK!\n");
 
+#ifdef MADNESS_HAVE_MTXMQ_X86
+    if (!test_kernels()) exit(1);
+    if (!test_transforms()) exit(1);
+#endif
+
     printf("%20s %3s %3s %3s %8s %8s (GF/s)\n", "type", "M", "N", "K", "LOOP", "BLAS");
     for (ni=2; ni<60; ni+=2) timer("(m*m)T*(m*m)", ni,ni,ni,a,b,c);
     for (m=2; m<=30; m+=2) timer("(m*m,m)T*(m*m)", m*m,m,m,a,b,c);
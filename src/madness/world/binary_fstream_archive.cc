@@ -70,6 +70,14 @@ namespace madness {
             os.flush();
         }
 
+        std::uint64_t BinaryFstreamOutputArchive::tell() const {
+            return os.tellp();
+        }
+
+        void BinaryFstreamOutputArchive::seek(std::uint64_t pos) const {
+            os.seekp(pos);
+        }
+
         BinaryFstreamInputArchive::BinaryFstreamInputArchive(const char* filename, std::ios_base::openmode mode)
                 : iobuf() {
             if (filename) open(filename, mode);
@@ -95,5 +103,13 @@ namespace madness {
             }
         }
 
+        std::uint64_t BinaryFstreamInputArchive::tell() const {
+            return is.tellg();
+        }
+
+        void BinaryFstreamInputArchive::seek(std::uint64_t pos) const {
+            is.seekg(pos);
+        }
+
     } // namespace archive
 } // namespace madness
@@ -39,6 +39,7 @@
 */
 
 #include <type_traits>
+#include <cstdint>
 #include <fstream>
 #include <memory>
 #include <madness/world/archive.h>
@@ -93,6 +94,18 @@ namespace madness {
 
             /// Flush the filestream.
             void flush();
+
+            /// Returns the current position in the file, in bytes.
+
+            /// \return The position of the next store.
+            std::uint64_t tell() const;
+
+            /// Moves to a position in the file.
+
+            /// Used to overwrite data stored earlier, e.g. an offset that
+            /// was not known when it was first stored.
+            /// \param[in] pos The position in bytes from the start of the file.
+            void seek(std::uint64_t pos) const;
         };
 
         /// Wraps an archive around a binary filestream for input.
@@ -132,6 +145,16 @@ namespace madness {
 
             /// Close the filestream.
             void close();
+
+            /// Returns the current position in the file, in bytes.
+
+            /// \return The position of the next load.
+            std::uint64_t tell() const;
+
+            /// Moves to a position in the file.
+
+            /// \param[in] pos The position in bytes from the start of the file.
+            void seek(std::uint64_t pos) const;
         };
 
         /// @}
@@ -0,0 +1,146 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file epoch.cc
+ \brief Epoch-based reclamation of memory shared by lock-free data structures.
+ \ingroup threads
+*/
+
+#include <madness/world/epoch.h>
+#include <atomic>
+#include <deque>
+#include <stdint.h>
+
+namespace madness {
+
+    namespace {
+
+        /// An object awaiting deletion.
+        struct Retired {
+            void* p;
+            void (*deleter)(void*);
+            uint64_t epoch; ///< Global epoch when retired
+        };
+
+        /// Per-thread state; never freed since other threads scan it.
+        struct Record {
+            /// (epoch << 1) | active, so a scanner reads both atomically
+            std::atomic<uint64_t> state;
+            int nest; ///< Critical section nesting depth (owner only)
+            std::deque<Retired> limbo; ///< Retired objects, oldest first (owner only)
+            Record* next; ///< Registry link, immutable once published
+
+            Record() : state(0), nest(0), next(nullptr) {}
+        };
+
+        /// Retire this many objects between attempts to reclaim.
+        const std::size_t reclaim_interval = 64;
+
+        std::atomic<uint64_t> global_epoch(0);
+        std::atomic<Record*> records(nullptr);
+        thread_local Record* thread_record = nullptr;
+
+        Record* get_record() {
+            if (!thread_record) {
+                Record* r = new Record();
+                Record* head = records.load(std::memory_order_relaxed);
+                do {
+                    r->next = head;
+                } while (!records.compare_exchange_weak(head, r,
+                        std::memory_order_release, std::memory_order_relaxed));
+                thread_record = r;
+            }
+            return thread_record;
+        }
+
+        /// Advance the global epoch if every active thread has observed it.
+        void try_advance() {
+            uint64_t e = global_epoch.load();
+            for (Record* r = records.load(std::memory_order_acquire); r; r = r->next) {
+                const uint64_t s = r->state.load();
+                if ((s & 1) && (s >> 1) != e) return;
+            }
+            global_epoch.compare_exchange_strong(e, e + 1);
+        }
+
+        /// Free the calling thread's objects that no other thread can reference.
+        void reclaim(Record* r) {
+            const uint64_t e = global_epoch.load();
+            while (!r->limbo.empty() && r->limbo.front().epoch + 2 <= e) {
+                const Retired x = r->limbo.front();
+                r->limbo.pop_front();
+                x.deleter(x.p);
+            }
+        }
+
+    } // namespace
+
+    void EpochReclaimer::enter() {
+        Record* r = get_record();
+        if (r->nest++ == 0) {
+            r->state.store((global_epoch.load() << 1) | 1);
+            // Publish before reading any shared pointer
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    void EpochReclaimer::exit() {
+        Record* r = thread_record;
+        if (--(r->nest) == 0) {
+            r->state.store(r->state.load(std::memory_order_relaxed) & ~uint64_t(1),
+                    std::memory_order_release);
+        }
+    }
+
+    void EpochReclaimer::retire(void* p, void (*deleter)(void*)) {
+        Record* r = get_record();
+        Retired x = {p, deleter, global_epoch.load()};
+        r->limbo.push_back(x);
+        if ((r->limbo.size() % reclaim_interval) == 0) {
+            try_advance();
+            reclaim(r);
+        }
+    }
+
+    void EpochReclaimer::flush() {
+        Record* r = get_record();
+        if (r->limbo.empty() || r->nest) return;
+        // Two advances make everything retired so far reclaimable
+        for (int i = 0; i < 2; ++i) try_advance();
+        reclaim(r);
+    }
+
+    std::size_t EpochReclaimer::pending() {
+        return get_record()->limbo.size();
+    }
+
+} // namespace madness
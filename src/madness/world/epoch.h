@@ -0,0 +1,97 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_EPOCH_H__INCLUDED
+#define MADNESS_WORLD_EPOCH_H__INCLUDED
+
+/**
+ \file epoch.h
+ \brief Epoch-based reclamation of memory shared by lock-free data structures.
+ \ingroup threads
+*/
+
+#include <cstddef>
+
+namespace madness {
+
+    /// Epoch-based memory reclamation (Fraser, 2004).
+
+    /// A thread reading a lock-free structure does so inside a critical
+    /// section delimited by a \c Guard. A node unlinked from the structure
+    /// is passed to \c retire() and actually freed only once every thread
+    /// that was inside a critical section when it was unlinked has left it,
+    /// i.e. after the global epoch has advanced twice.
+    ///
+    /// Critical sections may nest and must be short; a thread blocked
+    /// inside one delays (but never prevents) reclamation by all threads.
+    /// Each thread keeps its own list of retired nodes and frees them
+    /// itself. All functions are static and thread safe.
+    class EpochReclaimer {
+        EpochReclaimer() = delete;
+
+    public:
+        /// RAII critical section.
+        class Guard {
+            Guard(const Guard&) = delete;
+            Guard& operator=(const Guard&) = delete;
+        public:
+            Guard() { EpochReclaimer::enter(); }
+            ~Guard() { EpochReclaimer::exit(); }
+        };
+
+        /// Enter a critical section.
+        static void enter();
+
+        /// Leave a critical section.
+        static void exit();
+
+        /// Schedule memory for deletion once no thread can still reference it.
+
+        /// \param[in] p The unlinked object.
+        /// \param[in] deleter Function called with \c p to free it.
+        static void retire(void* p, void (*deleter)(void*));
+
+        /// Try to free everything retired by the calling thread.
+
+        /// Useful after retiring many objects, e.g. when clearing a
+        /// container. Objects still potentially referenced by other threads
+        /// are kept.
+        static void flush();
+
+        /// Number of objects retired by the calling thread and not yet freed.
+
+        /// \return The number of objects.
+        static std::size_t pending();
+    };
+
+}
+
+#endif // MADNESS_WORLD_EPOCH_H__INCLUDED
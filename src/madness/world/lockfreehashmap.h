@@ -0,0 +1,685 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_LOCKFREEHASHMAP_H__INCLUDED
+#define MADNESS_WORLD_LOCKFREEHASHMAP_H__INCLUDED
+
+/// \file lockfreehashmap.h
+/// \brief Defines and implements a lock-free, resizable concurrent hashmap
+
+#include <madness/madness_config.h>
+#include <madness/world/worldhashmap.h>
+#include <madness/world/epoch.h>
+#include <atomic>
+#include <cstdint>
+#include <iterator>
+#include <stdio.h>
+
+namespace madness {
+
+    template <class keyT, class valueT, class hashfunT>
+    class LockFreeHashMap;
+
+    namespace LockFreeHash_private {
+
+        // All entries live in a single linked list sorted by the bit-reversed
+        // hash ("split order", Shalev and Shavit, JACM 53, 2006).  Bucket b
+        // points to a dummy node in the list that precedes every entry whose
+        // hash ends in the bits of b.  Doubling the number of buckets only
+        // requires inserting new dummies, which is done lazily, so no entry
+        // ever moves.  The list is that of Harris and Michael: a deleted node
+        // is first marked (low bit of its next pointer) and then unlinked.
+        // Unlinked nodes are freed by EpochReclaimer.
+
+        /// Link of the split-ordered list
+        class node {
+        public:
+            const uint64_t so_key;                  ///< Split-order key; odd for entries, even for dummies
+            std::atomic<std::uintptr_t> next;       ///< Next node, low bit set if this node is deleted
+
+            explicit node(uint64_t so_key) : so_key(so_key), next(0) {}
+
+            bool is_dummy() const { return !(so_key & 1); }
+
+            static node* ptr(std::uintptr_t p) {
+                return reinterpret_cast<node*>(p & ~std::uintptr_t(1));
+            }
+
+            static std::uintptr_t bits(const node* p) {
+                return reinterpret_cast<std::uintptr_t>(p);
+            }
+
+            static bool marked(std::uintptr_t p) { return p & 1; }
+        };
+
+        template <typename keyT, typename valueT>
+        class entry : public node, public madness::MutexReaderWriter {
+        public:
+            typedef std::pair<const keyT, valueT> datumT;
+            datumT datum;
+
+            entry(uint64_t so_key, const datumT& datum)
+                    : node(so_key), datum(datum) {}
+
+            /// Deleter for EpochReclaimer
+            static void destroy(void* p) {
+                delete static_cast<entry*>(p);
+            }
+        };
+
+        /// iterator for hash
+        template <class hashT> class LockFreeHashIterator {
+        public:
+            typedef typename std::conditional<std::is_const<hashT>::value,
+                    typename std::add_const<typename hashT::entryT>::type,
+                    typename hashT::entryT>::type entryT;
+            typedef typename std::conditional<std::is_const<hashT>::value,
+                    typename std::add_const<typename hashT::datumT>::type,
+                    typename hashT::datumT>::type datumT;
+            typedef std::forward_iterator_tag iterator_category;
+            typedef datumT value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef datumT* pointer;
+            typedef datumT& reference;
+
+        private:
+            hashT* h;               // Associated hash table
+            entryT* entry;          // Current entry ... zero means at end
+
+            template <class otherHashT>
+            friend class LockFreeHashIterator;
+
+            /// First live entry at or after the node p (caller holds an epoch guard)
+            static entryT* live_from(std::uintptr_t p) {
+                node* n = node::ptr(p);
+                while (n) {
+                    const std::uintptr_t next = n->next.load(std::memory_order_acquire);
+                    if (!n->is_dummy() && !node::marked(next)) break;
+                    n = node::ptr(next);
+                }
+                return static_cast<entryT*>(n);
+            }
+
+        public:
+
+            /// Makes invalid iterator
+            LockFreeHashIterator() : h(0), entry(0) {}
+
+            /// Makes begin/end iterator
+            LockFreeHashIterator(hashT* h, bool begin)
+                    : h(h), entry(0) {
+                if (begin) {
+                    EpochReclaimer::Guard guard;
+                    entry = live_from(h->head->next.load(std::memory_order_acquire));
+                }
+            }
+
+            /// Makes iterator to specific entry
+            LockFreeHashIterator(hashT* h, entryT* entry)
+                    : h(h), entry(entry) {}
+
+            /// Copy constructor
+            LockFreeHashIterator(const LockFreeHashIterator& other)
+                    : h(other.h), entry(other.entry) {}
+
+            /// Implicit conversion of another hash type to this hash type
+
+            /// This allows implicit conversion from hash types to const hash
+            /// types.
+            template <class otherHashT>
+            LockFreeHashIterator(const LockFreeHashIterator<otherHashT>& other)
+                    : h(other.h), entry(other.entry) {}
+
+            LockFreeHashIterator& operator++() {
+                if (!entry) return *this;
+                EpochReclaimer::Guard guard;
+                entry = live_from(entry->next.load(std::memory_order_acquire));
+                return *this;
+            }
+
+            LockFreeHashIterator operator++(int) {
+                LockFreeHashIterator old(*this);
+                operator++();
+                return old;
+            }
+
+            /// Difference between iterators \em only supported for this=start and other=end
+
+            /// This exists to support construction of range for parallel iteration
+            /// over the entire container.
+            int distance(const LockFreeHashIterator& other) const {
+                MADNESS_ASSERT(h == other.h  &&  other == h->end()  &&  *this == h->begin());
+                return h->size();
+            }
+
+            /// Only positive increments are supported
+
+            /// This exists to support splitting of range for parallel iteration.
+            /// There are no bins to skip so this is linear in \c n.
+            void advance(int n) {
+                if (n==0 || !entry) return;
+                MADNESS_ASSERT(n>=0);
+                EpochReclaimer::Guard guard;
+                while (n-- && entry)
+                    entry = live_from(entry->next.load(std::memory_order_acquire));
+            }
+
+            bool operator==(const LockFreeHashIterator& a) const {
+                return entry==a.entry;
+            }
+
+            bool operator!=(const LockFreeHashIterator& a) const {
+                return entry!=a.entry;
+            }
+
+            reference operator*() const {
+                MADNESS_ASSERT(entry);
+                return entry->datum;
+            }
+
+            pointer operator->() const {
+                MADNESS_ASSERT(entry);
+                return &entry->datum;
+            }
+        };
+
+    } // End of namespace LockFreeHash_private
+
+    /// A concurrent hashmap with lock-free lookup that grows under load.
+
+    /// This is a drop-in replacement for \c ConcurrentHashMap with the same
+    /// interface, including read- and write-locked accessors.  Differences:
+    ///  - Searching never takes a lock; an accessor only locks its entry.
+    ///  - The number of buckets is doubled whenever the mean load exceeds
+    ///    two entries per bucket.  New buckets are initialized on first use,
+    ///    so growth is incremental and entries never move.
+    ///  - Erased entries are freed by \c EpochReclaimer once no thread can
+    ///    still be reading them.  Iterators and accessors are still
+    ///    invalidated by erasing the entry they refer to.
+    ///  - Iteration order differs (split order rather than bin order) and
+    ///    \c std::advance on an iterator is linear rather than skipping bins.
+    template < class keyT, class valueT, class hashfunT = Hash<keyT> >
+    class LockFreeHashMap {
+    public:
+        typedef LockFreeHashMap<keyT,valueT,hashfunT> hashT;
+        typedef std::pair<const keyT,valueT> datumT;
+        typedef LockFreeHash_private::entry<keyT,valueT> entryT;
+        typedef LockFreeHash_private::LockFreeHashIterator<hashT> iterator;
+        typedef LockFreeHash_private::LockFreeHashIterator<const hashT> const_iterator;
+        typedef Hash_private::HashAccessor<hashT,entryT::WRITELOCK> accessor;
+        typedef Hash_private::HashAccessor<const hashT,entryT::READLOCK> const_accessor;
+
+        friend class LockFreeHash_private::LockFreeHashIterator<hashT>;
+        friend class LockFreeHash_private::LockFreeHashIterator<const hashT>;
+
+    private:
+        typedef LockFreeHash_private::node nodeT;
+        typedef std::atomic<nodeT*> bucketT;
+
+        /// Segment 0 holds bucket 0, segment s>0 holds buckets [2^(s-1),2^s)
+        static const int nsegment = 48;
+        static const std::size_t max_load = 2;
+
+        mutable std::atomic<bucketT*> segments[nsegment];
+        std::atomic<std::size_t> nbuckets; // Power of two
+        std::atomic<long> count;            // Transiently negative if erase overtakes insert
+        nodeT* const head;                  // Dummy of bucket 0
+        hashfunT hashfun;
+
+        static uint64_t reverse_bits(uint64_t x) {
+            x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+            x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+            x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+            x = ((x >> 8) & 0x00FF00FF00FF00FFull) | ((x & 0x00FF00FF00FF00FFull) << 8);
+            x = ((x >> 16) & 0x0000FFFF0000FFFFull) | ((x & 0x0000FFFF0000FFFFull) << 16);
+            return (x >> 32) | (x << 32);
+        }
+
+        static uint64_t so_regular(std::size_t h) {
+            return reverse_bits(uint64_t(h) | (uint64_t(1) << 63));
+        }
+
+        static uint64_t so_dummy(std::size_t bucket) {
+            return reverse_bits(bucket);
+        }
+
+        static std::size_t initial_nbuckets(int n) {
+            std::size_t nb = 16;
+            while (nb < std::size_t(n)) nb <<= 1;
+            return nb;
+        }
+
+        bucketT& bucket_slot(std::size_t b) const {
+            int s = 0;
+            std::size_t first = 0;
+            if (b) {
+#ifdef __GNUC__
+                s = 64 - __builtin_clzll(b);
+#else
+                s = 1;
+                while ((std::size_t(1) << s) <= b) ++s;
+#endif
+                first = std::size_t(1) << (s - 1);
+            }
+            bucketT* seg = segments[s].load(std::memory_order_acquire);
+            if (!seg) {
+                const std::size_t size = (s == 0) ? 1 : first;
+                bucketT* fresh = new bucketT[size];
+                for (std::size_t i=0; i<size; ++i) fresh[i].store(0, std::memory_order_relaxed);
+                if (segments[s].compare_exchange_strong(seg, fresh, std::memory_order_acq_rel))
+                    seg = fresh;
+                else
+                    delete [] fresh;
+            }
+            return seg[b - first];
+        }
+
+        /// Returns the dummy of bucket b, inserting it (and its parents) if necessary
+        nodeT* get_bucket(std::size_t b) const {
+            bucketT& slot = bucket_slot(b);
+            nodeT* dummy = slot.load(std::memory_order_acquire);
+            if (dummy) return dummy;
+
+            // The parent bucket is b with its most significant bit cleared
+            std::size_t msb = 1;
+            while ((msb << 1) <= b) msb <<= 1;
+            nodeT* parent = get_bucket(b & ~msb);
+
+            nodeT* fresh = new nodeT(so_dummy(b));
+            std::atomic<std::uintptr_t>* prev;
+            nodeT* curr;
+            while (true) {
+                if (search(parent, fresh->so_key, 0, prev, curr)) {
+                    delete fresh; // Another thread inserted it
+                    dummy = curr;
+                    break;
+                }
+                fresh->next.store(nodeT::bits(curr), std::memory_order_relaxed);
+                std::uintptr_t expected = nodeT::bits(curr);
+                if (prev->compare_exchange_strong(expected, nodeT::bits(fresh),
+                        std::memory_order_release, std::memory_order_relaxed)) {
+                    dummy = fresh;
+                    break;
+                }
+            }
+            slot.store(dummy, std::memory_order_release);
+            return dummy;
+        }
+
+        nodeT* bucket_of(std::size_t h) const {
+            return get_bucket(h & (nbuckets.load(std::memory_order_acquire) - 1));
+        }
+
+        static void retire(nodeT* n) {
+            EpochReclaimer::retire(static_cast<entryT*>(n), &entryT::destroy);
+        }
+
+        /// Find the node with the given split-order key (and key, if an entry)
+
+        /// On return \c curr is the match or the first node after it, and
+        /// \c prev is the link pointing to \c curr.  Marked nodes met on the
+        /// way are unlinked.  The caller must hold an epoch guard.
+        bool search(nodeT* start, uint64_t so, const keyT* key,
+                    std::atomic<std::uintptr_t>*& prev, nodeT*& curr) const {
+        retry:
+            prev = &start->next;
+            curr = nodeT::ptr(prev->load(std::memory_order_acquire));
+            while (curr) {
+                const std::uintptr_t next = curr->next.load(std::memory_order_acquire);
+                if (prev->load(std::memory_order_acquire) != nodeT::bits(curr)) goto retry;
+                if (nodeT::marked(next)) {
+                    std::uintptr_t expected = nodeT::bits(curr);
+                    if (!prev->compare_exchange_strong(expected, next & ~std::uintptr_t(1),
+                            std::memory_order_acq_rel, std::memory_order_relaxed))
+                        goto retry;
+                    retire(curr);
+                    curr = nodeT::ptr(next);
+                    continue;
+                }
+                if (curr->so_key > so) return false;
+                if (curr->so_key == so && (!key || static_cast<entryT*>(curr)->datum.first == *key))
+                    return true;
+                prev = &curr->next;
+                curr = nodeT::ptr(next);
+            }
+            return false;
+        }
+
+        /// Read-only search (caller holds an epoch guard)
+        entryT* lookup(const keyT& key) const {
+            const std::size_t h = hashfun(key);
+            const uint64_t so = so_regular(h);
+            nodeT* n = nodeT::ptr(bucket_of(h)->next.load(std::memory_order_acquire));
+            while (n && n->so_key <= so) {
+                const std::uintptr_t next = n->next.load(std::memory_order_acquire);
+                if (n->so_key == so && !nodeT::marked(next) &&
+                        static_cast<entryT*>(n)->datum.first == key)
+                    return static_cast<entryT*>(n);
+                n = nodeT::ptr(next);
+            }
+            return 0;
+        }
+
+        entryT* find_entry(const keyT& key, int lockmode) const {
+            EpochReclaimer::Guard guard;
+            madness::MutexWaiter waiter;
+            while (true) {
+                entryT* result = lookup(key);
+                if (!result) return 0;
+                if (result->try_lock(lockmode)) {
+                    // Lost a race with erase?
+                    if (!nodeT::marked(result->next.load(std::memory_order_acquire)))
+                        return result;
+                    result->unlock(lockmode);
+                }
+                else {
+                    waiter.wait();
+                }
+            }
+        }
+
+        std::pair<entryT*,bool> insert_entry(const datumT& datum, int lockmode) {
+            EpochReclaimer::Guard guard;
+            madness::MutexWaiter waiter;
+            const std::size_t h = hashfun(datum.first);
+            const uint64_t so = so_regular(h);
+            entryT* fresh = 0;
+            while (true) {
+                std::atomic<std::uintptr_t>* prev;
+                nodeT* curr;
+                if (search(bucket_of(h), so, &datum.first, prev, curr)) {
+                    entryT* result = static_cast<entryT*>(curr);
+                    if (result->try_lock(lockmode)) {
+                        if (!nodeT::marked(result->next.load(std::memory_order_acquire))) {
+                            delete fresh; // Never published
+                            return std::pair<entryT*,bool>(result,false);
+                        }
+                        result->unlock(lockmode);
+                    }
+                    else {
+                        waiter.wait();
+                    }
+                    continue;
+                }
+
+                if (!fresh) {
+                    fresh = new entryT(so, datum);
+                    fresh->try_lock(lockmode); // Lock before it is visible
+                }
+                fresh->next.store(nodeT::bits(curr), std::memory_order_relaxed);
+                std::uintptr_t expected = nodeT::bits(curr);
+                if (prev->compare_exchange_strong(expected, nodeT::bits(fresh),
+                        std::memory_order_release, std::memory_order_relaxed)) {
+                    const long n = count.fetch_add(1, std::memory_order_relaxed) + 1;
+                    std::size_t nb = nbuckets.load(std::memory_order_relaxed);
+                    if (n > long(max_load*nb) && nb < (std::size_t(1) << (nsegment-1)))
+                        nbuckets.compare_exchange_strong(nb, nb << 1);
+                    return std::pair<entryT*,bool>(fresh,true);
+                }
+            }
+        }
+
+        bool erase_entry(const keyT& key, int lockmode) {
+            EpochReclaimer::Guard guard;
+            const std::size_t h = hashfun(key);
+            const uint64_t so = so_regular(h);
+            while (true) {
+                nodeT* start = bucket_of(h);
+                std::atomic<std::uintptr_t>* prev;
+                nodeT* curr;
+                if (!search(start, so, &key, prev, curr)) return false;
+
+                // Logically delete by marking, then try to unlink
+                std::uintptr_t next = curr->next.load(std::memory_order_acquire);
+                if (nodeT::marked(next)) continue;
+                if (!curr->next.compare_exchange_strong(next, next | 1,
+                        std::memory_order_acq_rel, std::memory_order_relaxed))
+                    continue;
+                static_cast<entryT*>(curr)->unlock(lockmode);
+                count.fetch_sub(1, std::memory_order_relaxed);
+
+                std::uintptr_t expected = nodeT::bits(curr);
+                if (prev->compare_exchange_strong(expected, next,
+                        std::memory_order_acq_rel, std::memory_order_relaxed))
+                    retire(curr);
+                else
+                    search(start, so, &key, prev, curr); // Unlinks it
+                return true;
+            }
+        }
+
+    public:
+        LockFreeHashMap(int n=1021, const hashfunT& hf = hashfunT())
+                : nbuckets(initial_nbuckets(n))
+                , count(0)
+                , head(new nodeT(0))
+                , hashfun(hf) {
+            for (int s=0; s<nsegment; ++s) segments[s].store(0, std::memory_order_relaxed);
+            bucket_slot(0).store(head, std::memory_order_release);
+        }
+
+        LockFreeHashMap(const hashT& h)
+                : nbuckets(h.nbuckets.load())
+                , count(0)
+                , head(new nodeT(0))
+                , hashfun(h.hashfun) {
+            for (int s=0; s<nsegment; ++s) segments[s].store(0, std::memory_order_relaxed);
+            bucket_slot(0).store(head, std::memory_order_release);
+            *this = h;
+        }
+
+        virtual ~LockFreeHashMap() {
+            nodeT* n = head;
+            while (n) {
+                nodeT* next = nodeT::ptr(n->next.load(std::memory_order_relaxed));
+                if (n->is_dummy()) delete n;
+                else delete static_cast<entryT*>(n);
+                n = next;
+            }
+            for (int s=0; s<nsegment; ++s) delete [] segments[s].load(std::memory_order_relaxed);
+        }
+
+        hashT& operator=(const hashT& h) {
+            if (this != &h) {
+                this->clear();
+                hashfun = h.hashfun;
+                for (const_iterator p=h.begin(); p!=h.end(); ++p) {
+                    insert(*p);
+                }
+            }
+            return *this;
+        }
+
+        std::pair<iterator,bool> insert(const datumT& datum) {
+            std::pair<entryT*,bool> result = insert_entry(datum,entryT::NOLOCK);
+            return std::pair<iterator,bool>(iterator(this,result.first),result.second);
+        }
+
+        /// Returns true if new pair was inserted; false if key is already in the map and the datum was not inserted
+        bool insert(accessor& result, const datumT& datum) {
+            result.release();
+            std::pair<entryT*,bool> r = insert_entry(datum,entryT::WRITELOCK);
+            result.set(r.first);
+            return r.second;
+        }
+
+        /// Returns true if new pair was inserted; false if key is already in the map and the datum was not inserted
+        bool insert(const_accessor& result, const datumT& datum) {
+            result.release();
+            std::pair<entryT*,bool> r = insert_entry(datum,entryT::READLOCK);
+            result.set(r.first);
+            return r.second;
+        }
+
+        /// Returns true if new pair was inserted; false if key is already in the map
+        inline bool insert(accessor& result, const keyT& key) {
+            return insert(result, datumT(key,valueT()));
+        }
+
+        /// Returns true if new pair was inserted; false if key is already in the map
+        inline bool insert(const_accessor& result, const keyT& key) {
+            return insert(result, datumT(key,valueT()));
+        }
+
+        std::size_t erase(const keyT& key) {
+            if (erase_entry(key,entryT::NOLOCK)) return 1;
+            else return 0;
+        }
+
+        void erase(const iterator& it) {
+            if (it == end()) MADNESS_EXCEPTION("LockFreeHashMap: erase(iterator): at end", true);
+            erase(it->first);
+        }
+
+        void erase(accessor& item) {
+            erase_entry(item->first,entryT::WRITELOCK);
+            item.unset();
+        }
+
+        void erase(const_accessor& item) {
+            item.convert_read_lock_to_write_lock();
+            erase_entry(item->first,entryT::WRITELOCK);
+            item.unset();
+        }
+
+        iterator find(const keyT& key) {
+            entryT* entry = find_entry(key,entryT::NOLOCK);
+            if (!entry) return end();
+            else return iterator(this,entry);
+        }
+
+        const_iterator find(const keyT& key) const {
+            const entryT* entry = find_entry(key,entryT::NOLOCK);
+            if (!entry) return end();
+            else return const_iterator(this,entry);
+        }
+
+        bool find(accessor& result, const keyT& key) {
+            result.release();
+            entryT* entry = find_entry(key,entryT::WRITELOCK);
+            bool foundit = entry;
+            if (foundit) result.set(entry);
+            return foundit;
+        }
+
+        bool find(const_accessor& result, const keyT& key) const {
+            result.release();
+            entryT* entry = find_entry(key,entryT::READLOCK);
+            bool foundit = entry;
+            if (foundit) result.set(entry);
+            return foundit;
+        }
+
+        /// Erases all entries; the buckets are kept
+        void clear() {
+            {
+                EpochReclaimer::Guard guard;
+                nodeT* n = nodeT::ptr(head->next.load(std::memory_order_acquire));
+                while (n) {
+                    // A marked node still links to its successor, and it
+                    // cannot be freed while we hold the guard
+                    const std::uintptr_t next = n->next.load(std::memory_order_acquire);
+                    if (!n->is_dummy() && !nodeT::marked(next))
+                        erase_entry(static_cast<entryT*>(n)->datum.first,entryT::NOLOCK);
+                    n = nodeT::ptr(n->next.load(std::memory_order_acquire));
+                }
+            }
+            EpochReclaimer::flush();
+        }
+
+        size_t size() const {
+            const long n = count.load(std::memory_order_relaxed);
+            return (n > 0) ? n : 0;
+        }
+
+        valueT& operator[](const keyT& key) {
+            std::pair<iterator,bool> it = insert(datumT(key,valueT()));
+            return it.first->second;
+        }
+
+        iterator begin() {
+            return iterator(this,true);
+        }
+
+        const_iterator begin() const {
+            return const_iterator(this,true);
+        }
+
+        iterator end() {
+            return iterator(this,false);
+        }
+
+        const_iterator end() const {
+            return const_iterator(this,false);
+        }
+
+        hashfunT& get_hash() const { return hashfun; }
+
+        /// Number of buckets (grows with the number of entries)
+        std::size_t bucket_count() const {
+            return nbuckets.load(std::memory_order_relaxed);
+        }
+
+        void print_stats() const {
+            printf("LockFreeHashMap: %lu entries in %lu buckets\n",
+                   (unsigned long) size(), (unsigned long) bucket_count());
+        }
+    };
+
+
+    /// The hashmap used by \c WorldContainer and the operator caches
+
+    /// This is \c LockFreeHashMap if MADNESS was configured with
+    /// `ENABLE_LOCKFREE_HASHMAP`, otherwise \c ConcurrentHashMap.
+#ifdef MADNESS_LOCKFREE_HASHMAP
+    template < class keyT, class valueT, class hashfunT = Hash<keyT> >
+    using ContainerHashMap = LockFreeHashMap<keyT,valueT,hashfunT>;
+#else
+    template < class keyT, class valueT, class hashfunT = Hash<keyT> >
+    using ContainerHashMap = ConcurrentHashMap<keyT,valueT,hashfunT>;
+#endif
+
+}
+
+namespace std {
+
+    template <typename hashT, typename distT>
+    inline void advance( madness::LockFreeHash_private::LockFreeHashIterator<hashT>& it, const distT& dist ) {
+        it.advance(dist);
+    }
+
+    template <typename hashT>
+    inline int distance(const madness::LockFreeHash_private::LockFreeHashIterator<hashT>& it, const madness::LockFreeHash_private::LockFreeHashIterator<hashT>& jt) {
+        return it.distance(jt);
+    }
+}
+
+#endif // MADNESS_WORLD_LOCKFREEHASHMAP_H__INCLUDED
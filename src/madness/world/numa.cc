@@ -0,0 +1,147 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file numa.cc
+ \brief Minimal NUMA topology discovery and placement policy.
+ \ingroup threads
+*/
+
+#include <madness/world/numa.h>
+#include <madness/world/thread.h>
+#include <madness/world/madness_exception.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#ifndef ON_A_MAC
+#include <sched.h>
+#endif
+
+namespace madness {
+
+    std::vector< std::vector<int> > NUMATopology::node_cpus;
+    std::vector<int> NUMATopology::cpu_node;
+    NUMAPolicy NUMATopology::policy_ = NUMA_NONE;
+    std::size_t NUMATopology::page_size = 4096;
+
+    std::vector<int> NUMATopology::parse_cpulist(const char* s) {
+        std::vector<int> result;
+        while (*s) {
+            char* end;
+            const long lo = strtol(s, &end, 10);
+            if (end == s) break;
+            long hi = lo;
+            s = end;
+            if (*s == '-') {
+                hi = strtol(s + 1, &end, 10);
+                s = end;
+            }
+            for (long i = lo; i <= hi; ++i)
+                result.push_back(int(i));
+            while (*s == ',' || *s == '\n' || *s == ' ') ++s;
+        }
+        return result;
+    }
+
+    void NUMATopology::initialize() {
+        node_cpus.clear();
+        cpu_node.clear();
+
+        const long psz = sysconf(_SC_PAGESIZE);
+        if (psz > 0) page_size = psz;
+
+        // Nodes are numbered contiguously from 0 on all Linux systems we know of
+        for (int node = 0; ; ++node) {
+            char name[128];
+            snprintf(name, sizeof(name), "/sys/devices/system/node/node%d/cpulist", node);
+            FILE* f = fopen(name, "r");
+            if (!f) break;
+            char buf[4096];
+            const bool ok = (fgets(buf, sizeof(buf), f) != nullptr);
+            fclose(f);
+            std::vector<int> cpus;
+            if (ok) cpus = parse_cpulist(buf);
+            node_cpus.push_back(cpus);
+        }
+
+        // Fall back to one node holding every processor
+        if (node_cpus.empty()) {
+            std::vector<int> cpus(ThreadBase::num_hw_processors());
+            for (std::size_t i = 0; i < cpus.size(); ++i) cpus[i] = i;
+            node_cpus.push_back(cpus);
+        }
+
+        for (std::size_t node = 0; node < node_cpus.size(); ++node) {
+            for (std::size_t i = 0; i < node_cpus[node].size(); ++i) {
+                const int cpu = node_cpus[node][i];
+                if (cpu >= int(cpu_node.size())) cpu_node.resize(cpu + 1, -1);
+                cpu_node[cpu] = node;
+            }
+        }
+
+        policy_ = NUMA_NONE;
+        const char* mad_numa_policy = getenv("MAD_NUMA_POLICY");
+        if (mad_numa_policy) {
+            if (strcmp(mad_numa_policy, "socket") == 0)
+                policy_ = NUMA_SOCKET;
+            else if (strcmp(mad_numa_policy, "none") != 0)
+                MADNESS_EXCEPTION("MAD_NUMA_POLICY must be one of: none, socket", 0);
+        }
+    }
+
+    int NUMATopology::current_node() {
+#if defined(ON_A_MAC) || !defined(__linux__)
+        return 0;
+#else
+        return node_of_cpu(sched_getcpu());
+#endif
+    }
+
+    bool NUMATopology::bind_to_node(int node) {
+#ifndef ON_A_MAC
+        if (node < 0 || node >= nnodes() || node_cpus[node].empty()) return false;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (std::size_t i = 0; i < node_cpus[node].size(); ++i)
+            CPU_SET(node_cpus[node][i], &mask);
+        if (sched_setaffinity(0, sizeof(mask), &mask) == -1) {
+            perror("system error message");
+            std::printf("NUMATopology: bind_to_node: Could not set cpu affinity\n");
+            return false;
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+} // namespace madness
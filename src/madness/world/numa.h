@@ -0,0 +1,151 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_NUMA_H__INCLUDED
+#define MADNESS_WORLD_NUMA_H__INCLUDED
+
+/**
+ \file numa.h
+ \brief Minimal NUMA topology discovery and placement policy.
+ \ingroup threads
+*/
+
+#include <cstddef>
+#include <vector>
+
+namespace madness {
+
+    /// \addtogroup threads
+    /// @{
+
+    /// NUMA placement policies, selected by the `MAD_NUMA_POLICY` environment variable.
+    enum NUMAPolicy {
+        NUMA_NONE,  ///< `none` (default): leave placement to \c MAD_BIND and the OS.
+        NUMA_SOCKET ///< `socket`: pin pool threads per NUMA node, prefer same-node
+                    ///  steals and first-touch large tensor data on the allocating node.
+    };
+
+    /// NUMA topology of this host, read from `/sys/devices/system/node`.
+
+    /// No external library (e.g. hwloc or libnuma) is required. If the
+    /// topology cannot be read the host is treated as a single node holding
+    /// all processors. All functions are static; \c initialize() must be
+    /// called (by \c ThreadPool) while single threaded.
+    class NUMATopology {
+        static std::vector< std::vector<int> > node_cpus; ///< CPUs belonging to each node.
+        static std::vector<int> cpu_node; ///< Node of each CPU (-1 if unknown).
+        static NUMAPolicy policy_; ///< The selected policy.
+        static std::size_t page_size; ///< OS page size in bytes.
+
+        /// Parse a Linux cpulist string such as "0-3,8-11".
+
+        /// \param[in] s The string.
+        /// \return The listed CPUs.
+        static std::vector<int> parse_cpulist(const char* s);
+
+    public:
+        /// Discover the topology and read `MAD_NUMA_POLICY`.
+        static void initialize();
+
+        /// The selected placement policy.
+
+        /// \return The policy.
+        static NUMAPolicy policy() {
+            return policy_;
+        }
+
+        /// Number of NUMA nodes (at least 1).
+
+        /// \return The number of nodes.
+        static int nnodes() {
+            return node_cpus.size();
+        }
+
+        /// CPUs belonging to a node.
+
+        /// \param[in] node The node.
+        /// \return The CPU list.
+        static const std::vector<int>& cpus(int node) {
+            return node_cpus[node];
+        }
+
+        /// Node of a CPU.
+
+        /// \param[in] cpu The CPU.
+        /// \return The node, or 0 if unknown.
+        static int node_of_cpu(int cpu) {
+            return (cpu >= 0 && cpu < int(cpu_node.size()) && cpu_node[cpu] >= 0) ?
+                    cpu_node[cpu] : 0;
+        }
+
+        /// Node on which the calling thread is currently running.
+
+        /// \return The node.
+        static int current_node();
+
+        /// Node to which pool thread \c ind of \c nthread is assigned.
+
+        /// Threads are distributed over nodes in contiguous, balanced blocks.
+        /// \param[in] ind The pool thread index.
+        /// \param[in] nthread The number of pool threads.
+        /// \return The node.
+        static int node_of_pool_thread(int ind, int nthread) {
+            return (nthread > 0) ? int((long(ind) * nnodes()) / nthread) : 0;
+        }
+
+        /// Bind the calling thread to all CPUs of a node.
+
+        /// \param[in] node The node.
+        /// \return True on success.
+        static bool bind_to_node(int node);
+
+        /// Fault in the pages of freshly allocated memory from the calling thread.
+
+        /// Under the Linux first-touch policy a page is placed on the node of
+        /// the thread that first writes it, so touching the pages here puts
+        /// data on the node of the allocating thread rather than of whichever
+        /// thread happens to write it first. Pages already faulted in (e.g.
+        /// recycled heap memory) are not moved. Does nothing unless the policy
+        /// is \c NUMA_SOCKET. The contents of the memory are undefined on return.
+        /// \param[in,out] p Start of the allocation.
+        /// \param[in] nbyte Size of the allocation in bytes.
+        static void first_touch(void* p, std::size_t nbyte) {
+            if (policy_ != NUMA_SOCKET || nbyte < 2*page_size) return;
+            volatile char* c = static_cast<volatile char*>(p);
+            for (std::size_t i = 0; i < nbyte; i += page_size)
+                c[i] = 0;
+        }
+    };
+
+    /// @}
+}
+
+#endif // MADNESS_WORLD_NUMA_H__INCLUDED
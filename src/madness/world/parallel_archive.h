@@ -47,6 +47,9 @@
 #include <unistd.h>
 #include <cstring>
 #include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
 
 namespace madness {
     namespace archive {
@@ -66,6 +69,7 @@ namespace madness {
         class BaseParallelArchive {
             World* world; ///< The world.
             mutable Archive ar; ///< The local archive.
+            std::vector< std::shared_ptr<Archive> > more; ///< Further files read by this process if there are more files than processes.
             int nio; ///< Number of I/O nodes (always includes node zero).
             bool do_fence; ///< If true (default), a read/write of parallel objects fences before and after I/O.
             char fname[256]; ///< Name of the archive.
@@ -120,16 +124,64 @@ namespace madness {
                 return world;
             }
 
+            /// Returns the number of files of the archive.
+
+            /// This is the number of writers, also when reading.
+            /// \return The number of files.
+            int num_files() const {
+                return nio;
+            }
+
+            /// Returns the process that reads the given file sequentially.
+
+            /// If there are fewer processes than files, process \c p reads
+            /// files \c p, \c p+nproc, ... .
+            /// \param[in] ifile The file.
+            /// \return The process reading file \c ifile.
+            ProcessID file_reader(int ifile) const {
+                MADNESS_ASSERT(world);
+                return ifile%world->size();
+            }
+
+            /// Returns the local archive of a file read by this process.
+
+            /// \param[in] ifile The file, which must be read by this process.
+            /// \return A reference to the local archive of the file.
+            Archive& file_archive(int ifile) const {
+                MADNESS_ASSERT(world);
+                MADNESS_ASSERT(ifile < nio && file_reader(ifile) == world->rank());
+                if (ifile == world->rank()) return ar;
+                return *more[ifile/world->size() - 1];
+            }
+
+            /// Returns the name of a file of the archive.
+
+            /// \param[in] ifile The file.
+            /// \return The name of the file.
+            std::string file_name(int ifile) const {
+                return file_name(fname, ifile);
+            }
+
+            /// Returns the name of a file of the archive with the given base name.
+
+            /// \param[in] filename Base name of the archive.
+            /// \param[in] ifile The file.
+            /// \return The name of the file.
+            static std::string file_name(const char* filename, int ifile) {
+                char buf[256];
+                MADNESS_ASSERT(strlen(filename)+7 <= sizeof(buf));
+                sprintf(buf, "%s.%5.5d", filename, ifile);
+                return buf;
+            }
+
             /// Opens the parallel archive.
 
             /// \attention When writing to a new archive, the number of writers
             /// specified is used. When reading from an existing archive,
             /// the number of `ionode`s is adjusted to to be the same as
-            /// the number that wrote the original archive. Presently,
-            /// we don't have logic to handle reading an archive using
-            /// fewer processes originally used to write it. If you
-            /// want to fix this have a look in worlddc.h for the only
-            /// spot that currently needs changing to make that work.
+            /// the number that wrote the original archive. If there are
+            /// fewer processes than writers, each process reads several
+            /// files (see \c file_reader()).
             ///
             /// \note The default number of I/O nodes is one and there is an
             /// arbitrary maximum of 50 set. On IBM BG/P the maximum
@@ -160,7 +212,6 @@ namespace madness {
                 if (world.rank() == 0) {
                     ar.open(buf);
                     ar & nio; // read/write nio from/to the archive
-                    MADNESS_ASSERT(nio <= world.size());
                 }
 
                 // Ensure all agree on value of nio that may also have changed if reading
@@ -171,6 +222,12 @@ namespace madness {
                     ar.open(buf);
                 }
 
+                // Only when reading an archive written by more processes
+                more.clear();
+                for (int ifile=world.rank()+world.size(); ifile<nio; ifile+=world.size()) {
+                    more.push_back(std::shared_ptr<Archive>(new Archive(file_name(ifile).c_str())));
+                }
+
                 // Count #client
                 ProcessID me = world.rank();
                 nclient=0;
@@ -207,6 +264,8 @@ namespace madness {
             void close() {
                 MADNESS_ASSERT(world);
                 if (is_io_node()) ar.close();
+                for (std::size_t i=0; i<more.size(); ++i) more[i]->close();
+                more.clear();
             }
 
             /// Returns a reference to the local archive.
@@ -232,16 +291,14 @@ namespace madness {
             /// Deletes the files associated with the archive of the given name.
 
             /// Presently assumes a shared file system since process zero does the
-            /// deleting.
+            /// deleting.  The archive may have been written by more processes
+            /// than there are in \c world.
             /// \param[in] world The world.
             /// \param[in] filename Base name of the file.
             static void remove(World& world, const char* filename) {
                 if (world.rank() == 0) {
-                    char buf[256];
-                    MADNESS_ASSERT(strlen(filename)+7 <= sizeof(buf));
-                    for (ProcessID p=0; p<world.size(); ++p) {
-                        sprintf(buf, "%s.%5.5d", filename, p);
-                        if (::remove(buf)) break;
+                    for (int ifile=0; ; ++ifile) {
+                        if (::remove(file_name(filename, ifile).c_str())) break;
                     }
                 }
             }
@@ -307,10 +364,11 @@ namespace madness {
         ///
         /// \note Reads of parallel containers (presently only \c WorldContainer) load all data.
         ///
-        /// The number of I/O nodes or readers is presently ignored. It is
-        /// forced to be the same as the original number of writers and,
-        /// therefore, you cannot presently read an archive from a parallel job
-        /// with fewer total processes than the number of writers.
+        /// The number of I/O nodes or readers is ignored. It is forced to be
+        /// the same as the original number of writers; if the job has fewer
+        /// processes than there were writers, each process reads several
+        /// files. Containers stored with an index (see \c worlddc.h) are
+        /// read by all processes of the job, each loading its own entries.
         class ParallelInputArchive : public BaseParallelArchive<BinaryFstreamInputArchive>, public  BaseInputArchive {
         public:
             /// Default constructor.
@@ -0,0 +1,253 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file poolmem.cc
+ \brief Thread-local size-class memory pool for numerical data blocks.
+*/
+
+#include <madness/world/poolmem.h>
+#include <madness/world/worldmutex.h>
+#include <madness/world/madness_exception.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace madness {
+
+    namespace {
+
+        const std::size_t min_class_bytes = 64;              ///< Smallest class
+        const int max_class_log2 = 22;                       ///< Largest class is 4 MB
+        const int nsub = 4;                                  ///< Classes per power of two
+        const int nclass = (max_class_log2 - 6)*nsub + 1;    ///< Number of classes
+        const int large_class = -1;                          ///< Marks unpooled blocks
+        const std::size_t max_cached_bytes = std::size_t(1) << 22; ///< Per class per thread
+        const unsigned int block_magic = 0x9001c0deu;
+
+        struct Pool;
+
+        /// Header preceding every block; padded so the user data stays aligned.
+        union BlockHeader {
+            struct {
+                Pool* owner;          ///< Thread pool that allocated the block
+                BlockHeader* next;    ///< Free-list link
+                int cls;              ///< Size class or large_class
+                unsigned int magic;   ///< Sanity check
+            } h;
+            char pad[PoolMem::alignment];
+        };
+
+        static_assert(sizeof(BlockHeader) == PoolMem::alignment,
+                "PoolMem block header must be exactly one alignment unit");
+
+        /// Bytes of user data in class \c c.
+        std::size_t class_bytes(int c) {
+            if (c == 0) return min_class_bytes;
+            const int e = (c - 1)/nsub + 6;
+            const int sub = (c - 1)%nsub + 1;
+            return (std::size_t(1) << e) + sub*(std::size_t(1) << (e - 2));
+        }
+
+        /// Smallest class holding \c nbyte bytes, or large_class if too big.
+        int size_class(std::size_t nbyte) {
+            if (nbyte <= min_class_bytes) return 0;
+            if (nbyte > (std::size_t(1) << max_class_log2)) return large_class;
+            // 2^e < nbyte <= 2^(e+1)
+            int e = 6;
+            while ((std::size_t(1) << (e + 1)) < nbyte) ++e;
+            const std::size_t step = std::size_t(1) << (e - 2);
+            const int sub = int((nbyte - (std::size_t(1) << e) + step - 1)/step);
+            return (e - 6)*nsub + sub;
+        }
+
+        BlockHeader* system_allocate(std::size_t nbyte) {
+            void* p = nullptr;
+            if (posix_memalign(&p, PoolMem::alignment, nbyte + sizeof(BlockHeader)))
+                throw std::bad_alloc();
+            return static_cast<BlockHeader*>(p);
+        }
+
+        /// Per-thread free lists.
+
+        /// Only the owning thread touches \c free_list, \c nfree_list and the
+        /// plain counters; other threads only push onto \c remote.
+        struct Pool {
+            BlockHeader* free_list[nclass];
+            std::size_t nfree_list[nclass];
+            std::atomic<BlockHeader*> remote; ///< Blocks freed by other threads
+            std::atomic<uint64_t> nfree_remote;
+            uint64_t nalloc, nhit, nfree, nlarge;
+            std::atomic<uint64_t> cached_bytes; ///< Read by get_stats
+            Pool* next_pool; ///< Registry link
+
+            Pool() : remote(nullptr), nfree_remote(0), nalloc(0), nhit(0), nfree(0),
+                     nlarge(0), cached_bytes(0), next_pool(nullptr)
+            {
+                for (int c = 0; c < nclass; ++c) {
+                    free_list[c] = nullptr;
+                    nfree_list[c] = 0;
+                }
+            }
+
+            /// Maximum number of cached blocks of class \c c.
+            static std::size_t max_cached(int c) {
+                const std::size_t n = max_cached_bytes/class_bytes(c);
+                return (n < 2) ? 2 : n;
+            }
+
+            /// Cache a block or return it to the system. Owner only.
+            void put(BlockHeader* b) {
+                const int c = b->h.cls;
+                if (nfree_list[c] < max_cached(c)) {
+                    b->h.next = free_list[c];
+                    free_list[c] = b;
+                    ++(nfree_list[c]);
+                    cached_bytes.fetch_add(class_bytes(c), std::memory_order_relaxed);
+                }
+                else {
+                    free(b);
+                }
+            }
+
+            /// Move all remotely freed blocks to the local lists. Owner only.
+            void drain_remote() {
+                BlockHeader* b = remote.exchange(nullptr, std::memory_order_acquire);
+                while (b) {
+                    BlockHeader* next = b->h.next;
+                    put(b);
+                    b = next;
+                }
+            }
+
+            /// Push a block freed by another thread (lock-free Treiber stack).
+
+            /// The owner only ever takes the whole list, so there is no ABA problem.
+            void push_remote(BlockHeader* b) {
+                BlockHeader* head = remote.load(std::memory_order_relaxed);
+                do {
+                    b->h.next = head;
+                } while (!remote.compare_exchange_weak(head, b,
+                        std::memory_order_release, std::memory_order_relaxed));
+                nfree_remote.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void* allocate(std::size_t nbyte) {
+                ++nalloc;
+                const int c = size_class(nbyte);
+                BlockHeader* b;
+                if (c == large_class) {
+                    ++nlarge;
+                    b = system_allocate(nbyte);
+                }
+                else {
+                    if (!free_list[c] && remote.load(std::memory_order_relaxed))
+                        drain_remote();
+                    b = free_list[c];
+                    if (b) {
+                        free_list[c] = b->h.next;
+                        --(nfree_list[c]);
+                        cached_bytes.fetch_sub(class_bytes(c), std::memory_order_relaxed);
+                        ++nhit;
+                    }
+                    else {
+                        b = system_allocate(class_bytes(c));
+                    }
+                }
+                b->h.owner = this;
+                b->h.next = nullptr;
+                b->h.cls = c;
+                b->h.magic = block_magic;
+                return b + 1;
+            }
+        };
+
+        thread_local Pool* thread_pool = nullptr; ///< Pool of the calling thread
+        Pool* pool_registry = nullptr;            ///< All pools ever created
+        Mutex pool_registry_mutex;
+
+        /// Return the pool of the calling thread, creating it on first use.
+        Pool* get_thread_pool() {
+            if (!thread_pool) {
+                Pool* pool = new Pool();
+                ScopedMutex<Mutex> guard(pool_registry_mutex);
+                pool->next_pool = pool_registry;
+                pool_registry = pool;
+                thread_pool = pool;
+            }
+            return thread_pool;
+        }
+
+        bool default_enabled() {
+            const char* mad_tensor_pool = getenv("MAD_TENSOR_POOL");
+            return mad_tensor_pool && strcmp(mad_tensor_pool, "0") != 0;
+        }
+
+    } // namespace
+
+    bool PoolMem::enabled_ = default_enabled();
+
+    void* PoolMem::allocate(std::size_t nbyte) {
+        return get_thread_pool()->allocate(nbyte);
+    }
+
+    void PoolMem::deallocate(void* p) {
+        if (!p) return;
+        BlockHeader* b = static_cast<BlockHeader*>(p) - 1;
+        MADNESS_ASSERT(b->h.magic == block_magic);
+        if (b->h.cls == large_class) {
+            free(b);
+        }
+        else if (b->h.owner == thread_pool) {
+            ++(b->h.owner->nfree);
+            b->h.owner->put(b);
+        }
+        else {
+            b->h.owner->push_remote(b);
+        }
+    }
+
+    PoolMemStats PoolMem::get_stats() {
+        PoolMemStats stats;
+        ScopedMutex<Mutex> guard(pool_registry_mutex);
+        for (const Pool* pool = pool_registry; pool; pool = pool->next_pool) {
+            stats.nalloc += pool->nalloc;
+            stats.nhit += pool->nhit;
+            stats.nfree += pool->nfree;
+            stats.nfree_remote += pool->nfree_remote.load(std::memory_order_relaxed);
+            stats.nlarge += pool->nlarge;
+            stats.cached_bytes += pool->cached_bytes.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+} // namespace madness
@@ -0,0 +1,124 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_POOLMEM_H__INCLUDED
+#define MADNESS_WORLD_POOLMEM_H__INCLUDED
+
+/**
+ \file poolmem.h
+ \brief Thread-local size-class memory pool for numerical data blocks.
+*/
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace madness {
+
+    /// Statistics for \c PoolMem, summed over all threads.
+    struct PoolMemStats {
+        uint64_t nalloc;        ///< #calls to allocate
+        uint64_t nhit;          ///< #allocations satisfied from a free list
+        uint64_t nfree;         ///< #calls to deallocate by the owning thread
+        uint64_t nfree_remote;  ///< #calls to deallocate by another thread
+        uint64_t nlarge;        ///< #allocations too large to be pooled
+        uint64_t cached_bytes;  ///< Bytes currently held in free lists
+
+        PoolMemStats()
+                : nalloc(0), nhit(0), nfree(0), nfree_remote(0), nlarge(0), cached_bytes(0) {}
+    };
+
+    /// Thread-local, size-class pooled allocator.
+
+    /// Intended for the storage of \c Tensor (and hence \c GenTensor and
+    /// \c SRConf) data, where a handful of fixed sizes such as k^NDIM and
+    /// (2k)^NDIM are allocated and freed millions of times.
+    ///
+    /// Requests are rounded up to one of a set of size classes (four per
+    /// power of two, so at most 25% waste) between 64 bytes and 4 MB.
+    /// Each thread owns a free list per class; allocation and a free by
+    /// the allocating thread take no locks. A block freed by another
+    /// thread is pushed on the owner's lock-free remote-free list and
+    /// reclaimed the next time the owner runs out of blocks of that
+    /// class. Each thread caches at most about 4 MB per class; anything
+    /// beyond that, and any request larger than the largest class, goes
+    /// straight to the system allocator.
+    ///
+    /// Memory returned is aligned to 64 bytes. Thread pools are never
+    /// destroyed since blocks may outlive the thread that allocated them.
+    ///
+    /// The pool is off by default; set the environment variable
+    /// `MAD_TENSOR_POOL=1` or call \c set_enabled() to turn it on.
+    /// Blocks remember how they were allocated, so toggling is safe at
+    /// any time.
+    class PoolMem {
+        static bool enabled_; ///< True if callers should use the pool.
+
+    public:
+        static const std::size_t alignment = 64; ///< Alignment of returned memory.
+
+        /// Allocate at least \c nbyte bytes.
+
+        /// \param[in] nbyte The number of bytes.
+        /// \return Pointer to the memory.
+        /// \throw std::bad_alloc if the system allocator fails.
+        static void* allocate(std::size_t nbyte);
+
+        /// Return memory obtained from \c allocate().
+
+        /// May be called from any thread.
+        /// \param[in] p The pointer (may be null).
+        static void deallocate(void* p);
+
+        /// Test if the pool is enabled.
+
+        /// \return True if enabled.
+        static bool enabled() {
+            return enabled_;
+        }
+
+        /// Enable or disable use of the pool by its clients.
+
+        /// \param[in] value The new setting.
+        static void set_enabled(bool value) {
+            enabled_ = value;
+        }
+
+        /// Collect statistics from all threads.
+
+        /// Counters are read without synchronization so are approximate
+        /// while other threads are allocating.
+        /// \return The statistics.
+        static PoolMemStats get_stats();
+    };
+
+}
+
+#endif // MADNESS_WORLD_POOLMEM_H__INCLUDED
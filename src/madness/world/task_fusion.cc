@@ -0,0 +1,210 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file task_fusion.cc
+ \brief Adaptive inlining and fusion of tiny ready tasks.
+ \ingroup taskq
+*/
+
+#include <madness/world/task_fusion.h>
+#include <madness/world/thread.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#if defined(HAVE_INTEL_TBB) || HAVE_PARSEC || defined(MADNESS_TASK_PROFILING)
+#define MADNESS_TASK_FUSION_UNAVAILABLE
+#endif
+
+namespace madness {
+
+    namespace {
+
+        const int max_inline_depth = 4; ///< Deepest nesting of inline task execution
+
+        /// Per-thread fusion state
+        struct State {
+            int depth;      ///< Number of open scopes
+            int inline_depth; ///< Nesting of inline execution
+            std::vector<PoolTaskInterface*> batch;
+
+            State() : depth(0), inline_depth(0) { }
+        };
+
+        thread_local State state;
+
+        std::atomic<uint64_t> ninline(0);
+        std::atomic<uint64_t> nfused(0);
+        std::atomic<uint64_t> nbatch(0);
+        std::atomic<uint64_t> nqueued(0);
+
+        unsigned int env_value(const char* name, unsigned int dflt) {
+            const char* value = getenv(name);
+            if (!value) return dflt;
+            unsigned int result = 0;
+            if (sscanf(value, "%u", &result) != 1)
+                MADNESS_EXCEPTION("task fusion environment variable is not a non-negative integer", 0);
+            return result;
+        }
+
+        unsigned int default_threshold() {
+#ifdef MADNESS_TASK_FUSION_UNAVAILABLE
+            return 0;
+#else
+            return env_value("MAD_TASK_FUSION", 0);
+#endif
+        }
+
+        unsigned int default_batch_size() {
+            const unsigned int n = env_value("MAD_TASK_FUSION_BATCH", 16);
+            return (n > 0) ? n : 1;
+        }
+
+    } // namespace
+
+    unsigned int TaskFusion::threshold_ = default_threshold();
+    unsigned int TaskFusion::batch_size_ = default_batch_size();
+
+#ifndef MADNESS_TASK_FUSION_UNAVAILABLE
+
+    /// Runs a batch of tasks one after the other
+    class TaskFusion::FusedTask : public PoolTaskInterface {
+        std::vector<PoolTaskInterface*> tasks;
+
+    public:
+        explicit FusedTask(const std::vector<PoolTaskInterface*>& tasks)
+            : PoolTaskInterface(TaskAttributes()), tasks(tasks)
+        { }
+
+        void run(const TaskThreadEnv& /*info*/) {
+            for (PoolTaskInterface* task : tasks) {
+                if (task->run_multi_threaded()) delete task;
+            }
+        }
+
+        virtual ~FusedTask() { }
+
+    private:
+        virtual void get_id(std::pair<void*,unsigned short>& id) const {
+            PoolTaskInterface::make_id(id, &FusedTask::run);
+        }
+    };
+
+#endif // MADNESS_TASK_FUSION_UNAVAILABLE
+
+    void TaskFusion::flush_batch() {
+#ifndef MADNESS_TASK_FUSION_UNAVAILABLE
+        State& s = state;
+        if (s.batch.empty()) return;
+        if (s.batch.size() == 1) {
+            nqueued.fetch_add(1, std::memory_order_relaxed);
+            ThreadPool::add(s.batch.front());
+        }
+        else {
+            nfused.fetch_add(s.batch.size(), std::memory_order_relaxed);
+            nbatch.fetch_add(1, std::memory_order_relaxed);
+            ThreadPool::add(new FusedTask(s.batch));
+        }
+        s.batch.clear();
+#endif // MADNESS_TASK_FUSION_UNAVAILABLE
+    }
+
+    TaskFusion::Scope::Scope() : active_(threshold_ != 0) {
+        if (active_) ++state.depth;
+    }
+
+    TaskFusion::Scope::~Scope() {
+#ifndef MADNESS_TASK_FUSION_UNAVAILABLE
+        if (active_) {
+            // Tasks run inline leave their batch to the task that ran them
+            State& s = state;
+            --s.depth;
+            if (s.inline_depth == 0) flush_batch();
+        }
+#endif
+    }
+
+    void TaskFusion::submit(PoolTaskInterface* task, bool allow_inline) {
+#ifdef MADNESS_TASK_FUSION_UNAVAILABLE
+        ThreadPool::add(task);
+#else
+        State& s = state;
+        if (s.depth == 0) {
+            // Not inside a task so nothing would flush a batch
+            nqueued.fetch_add(1, std::memory_order_relaxed);
+            ThreadPool::add(task);
+            return;
+        }
+
+        const std::size_t nthread = ThreadPool::size();
+        const std::size_t backlog = ThreadPool::queue_size();
+        if (allow_inline && (s.inline_depth < max_inline_depth) && (backlog >= 2*nthread)) {
+            // Every thread has work queued so running now loses no parallelism
+            ninline.fetch_add(1, std::memory_order_relaxed);
+            ++s.inline_depth;
+            if (task->run_multi_threaded()) delete task;
+            --s.inline_depth;
+            return;
+        }
+
+        s.batch.push_back(task);
+        if ((s.batch.size() >= batch_size_) || (backlog < nthread))
+            flush_batch();
+#endif // MADNESS_TASK_FUSION_UNAVAILABLE
+    }
+
+    void TaskFusion::flush() {
+        flush_batch();
+    }
+
+    void TaskFusion::set_threshold(unsigned int cost) {
+#ifndef MADNESS_TASK_FUSION_UNAVAILABLE
+        threshold_ = cost;
+#endif
+    }
+
+    void TaskFusion::set_batch_size(unsigned int n) {
+        MADNESS_ASSERT(n > 0);
+        batch_size_ = n;
+    }
+
+    TaskFusionStats TaskFusion::get_stats() {
+        TaskFusionStats result;
+        result.ninline = ninline.load(std::memory_order_relaxed);
+        result.nfused = nfused.load(std::memory_order_relaxed);
+        result.nbatch = nbatch.load(std::memory_order_relaxed);
+        result.nqueued = nqueued.load(std::memory_order_relaxed);
+        return result;
+    }
+
+} // namespace madness
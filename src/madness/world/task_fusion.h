@@ -0,0 +1,162 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_TASK_FUSION_H__INCLUDED
+#define MADNESS_WORLD_TASK_FUSION_H__INCLUDED
+
+/**
+ \file task_fusion.h
+ \brief Adaptive inlining and fusion of tiny ready tasks.
+ \ingroup taskq
+*/
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace madness {
+
+    class PoolTaskInterface;
+
+    /// Statistics for \c TaskFusion, summed over all threads.
+    struct TaskFusionStats {
+        uint64_t ninline;   ///< #tasks run inline by the thread that submitted them
+        uint64_t nfused;    ///< #tasks run as part of a fused batch
+        uint64_t nbatch;    ///< #fused batches submitted to the pool
+        uint64_t nqueued;   ///< #eligible tasks submitted to the pool individually
+
+        TaskFusionStats()
+                : ninline(0), nfused(0), nbatch(0), nqueued(0) {}
+    };
+
+    /// Adaptive task granularity for tiny tasks.
+
+    /// Tree traversals such as \c compress, \c reconstruct and
+    /// \c norm_tree create one task per node, and in low dimension many
+    /// of these run for only a few microseconds, so that queueing and
+    /// dequeueing dominate. A task whose \c TaskAttributes carry a cost
+    /// hint (\c TaskAttributes::set_cost) no larger than \c threshold()
+    /// microseconds, that runs on a single thread and whose dependencies
+    /// are satisfied, is handled here instead of going straight to the
+    /// \c ThreadPool.
+    ///
+    /// Only tasks submitted by a thread that is itself executing a task
+    /// are affected; others are queued as usual. If the pool already has
+    /// plenty of work the new task runs inline in the submitting thread,
+    /// up to a fixed nesting depth. Otherwise it is appended to a
+    /// per-thread batch that is submitted to the pool as one task when it
+    /// holds \c batch_size() tasks, when the pool runs short of work,
+    /// when the submitting task finishes, or when the thread waits in
+    /// \c ThreadPool::await. Tasks whose dependencies are satisfied later
+    /// are only ever batched, never run inline.
+    ///
+    /// Since it may be run inline, a task with a cost hint must not need
+    /// a lock that the task submitting it might hold.
+    ///
+    /// Fusion is off by default; set the environment variable
+    /// `MAD_TASK_FUSION=<threshold in microseconds>` (and optionally
+    /// `MAD_TASK_FUSION_BATCH=<batch size>`, default 16) or call
+    /// \c set_threshold(). It is unavailable with TBB, PaRSEC or
+    /// `MADNESS_TASK_PROFILING`.
+    class TaskFusion {
+        static unsigned int threshold_; ///< Largest cost hint of a fusible task, 0 if disabled.
+        static unsigned int batch_size_; ///< Number of tasks that triggers submission of a batch.
+
+        class FusedTask;
+
+        /// Submit the calling thread's batch to the pool.
+        static void flush_batch();
+
+    public:
+        /// Marks the execution of a task by the calling thread.
+
+        /// Tasks submitted while a scope is open may be batched; the batch
+        /// is flushed when the scope closes, unless the task was itself
+        /// run inline.
+        class Scope {
+            bool active_;
+        public:
+            Scope();
+            ~Scope();
+        };
+
+        /// Test if a task may be inlined or fused.
+
+        /// \param[in] cost The cost hint of the task.
+        /// \param[in] nthread The number of threads of the task.
+        /// \return True if the task is eligible.
+        static bool candidate(unsigned int cost, int nthread) {
+            return (cost != 0) && (cost <= threshold_) && (nthread == 1);
+        }
+
+        /// Submit a ready task eligible according to \c candidate().
+
+        /// \param[in] task The task.
+        /// \param[in] allow_inline If true the task may be run before
+        ///     this returns.
+        static void submit(PoolTaskInterface* task, bool allow_inline);
+
+        /// Submit the tasks batched by the calling thread to the pool.
+        static void flush();
+
+        /// The largest cost hint of a task that is fused.
+
+        /// \return The threshold in microseconds, 0 if fusion is disabled.
+        static unsigned int threshold() {
+            return threshold_;
+        }
+
+        /// Set the largest cost hint of a task that is fused.
+
+        /// Ignored where fusion is unavailable.
+        /// \param[in] cost The threshold in microseconds; 0 disables fusion.
+        static void set_threshold(unsigned int cost);
+
+        /// The number of tasks that triggers submission of a batch.
+
+        /// \return The batch size.
+        static unsigned int batch_size() {
+            return batch_size_;
+        }
+
+        /// Set the number of tasks that triggers submission of a batch.
+
+        /// \param[in] n The batch size, at least 1.
+        static void set_batch_size(unsigned int n);
+
+        /// Collect statistics.
+
+        /// \return The statistics.
+        static TaskFusionStats get_stats();
+    };
+
+}
+
+#endif // MADNESS_WORLD_TASK_FUSION_H__INCLUDED
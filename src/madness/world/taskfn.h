@@ -74,7 +74,11 @@ namespace madness {
             PoolTaskInterface* p;
             Submit(PoolTaskInterface* p) : p(p) {}
             void notify() {
-                ThreadPool::add(p);
+                profiling::Tracer::task_ready(p);
+                if (TaskFusion::candidate(p->get_cost(), p->get_nthread()))
+                    TaskFusion::submit(p, false);
+                else
+                    ThreadPool::add(p);
             }
         } submit;
 
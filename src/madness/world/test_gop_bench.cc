@@ -0,0 +1,124 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_gop_bench.cc
+/// \brief Checks and times reduce, broadcast and fence over the binary and hierarchical trees
+
+// Usage: mpirun -np P test_gop_bench [max_elements [nrepeat]]
+//
+// For each tree (binary over all ranks, then hierarchical) and each
+// vector length 1, 32, 1024, ... up to max_elements doubles (default
+// 4M), times a global sum and a broadcast, checking the results, and
+// then times an empty fence.  Times are in microseconds per call.
+//
+// To emulate k ranks per node on fewer nodes set MAD_RANKS_PER_NODE=k,
+// e.g. for the sweep over 1, 2, 4, ... 64 ranks per node
+//     for k in 1 2 4 8 16 32 64; do
+//         MAD_RANKS_PER_NODE=$k mpirun -np 64 test_gop_bench
+//     done
+// The exit status is nonzero if any result is wrong.
+
+#include <madness/world/MADworld.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace madness;
+
+int main(int argc, char** argv) {
+    madness::initialize(argc,argv);
+    long nerror = 0;
+    {
+        World world(SafeMPI::COMM_WORLD);
+        const ProcessID me = world.rank();
+        const int np = world.size();
+
+        double max_elements = 4194304.0;
+        int nrepeat = 10;
+        if (argc > 1) max_elements = atof(argv[1]);
+        if (argc > 2) nrepeat = atoi(argv[2]);
+
+        if (me == 0)
+            printf("  tree           nelem   sum (us)  bcast (us)\n");
+
+        for (int h=0; h<2; ++h) {
+            world.gop.fence();
+            world.gop.set_hierarchical(h);
+            const char* name = h ? "hierarchical" : "binary";
+
+            for (double n = 1.0; n <= max_elements; n *= 32.0) {
+                const std::size_t nelem = std::size_t(n);
+                std::vector<double> v(nelem);
+
+                world.gop.barrier();
+                double tsum = 0.0;
+                for (int r=0; r<nrepeat; ++r) {
+                    for (std::size_t i=0; i<nelem; ++i) v[i] = double(me + i%7);
+                    const double start = wall_time();
+                    world.gop.sum(v.data(), nelem);
+                    tsum += wall_time() - start;
+                    for (std::size_t i=0; i<nelem; ++i)
+                        if (v[i] != 0.5*np*(np-1) + double(np*(i%7))) { ++nerror; break; }
+                }
+
+                world.gop.barrier();
+                double tbcast = 0.0;
+                const ProcessID root = np - 1;
+                for (int r=0; r<nrepeat; ++r) {
+                    for (std::size_t i=0; i<nelem; ++i) v[i] = (me == root) ? double(r + i%5) : -1.0;
+                    const double start = wall_time();
+                    world.gop.broadcast(v.data(), nelem, root);
+                    tbcast += wall_time() - start;
+                    for (std::size_t i=0; i<nelem; ++i)
+                        if (v[i] != double(r + i%5)) { ++nerror; break; }
+                }
+
+                if (me == 0)
+                    printf("  %-12s %9lu %10.1f %11.1f\n", name, (unsigned long) nelem,
+                           1e6*tsum/nrepeat, 1e6*tbcast/nrepeat);
+            }
+
+            world.gop.fence();
+            const double start = wall_time();
+            for (int r=0; r<nrepeat; ++r) world.gop.fence();
+            const double tfence = wall_time() - start;
+            if (me == 0)
+                printf("  %-12s     fence %10.1f\n", name, 1e6*tfence/nrepeat);
+        }
+
+        world.gop.set_hierarchical(false);
+        world.gop.sum(nerror);
+        if (me == 0) printf("%s\n", nerror ? "FAILED" : "PASSED");
+        world.gop.fence();
+    }
+    madness::finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,133 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_hashmap_bench.cc
+/// \brief Compares ConcurrentHashMap and LockFreeHashMap for mixed find/insert
+
+// Usage: test_hashmap_bench [max_entries [max_threads [find_percent]]]
+//
+// For each number of entries n = 1e4, 1e5, ... up to max_entries
+// (default 1e5) and each thread count 1, 2, 4, ... up to max_threads
+// (default 4), the map is prefilled with n/2 keys and then every thread
+// performs a random mix of finds and inserts (default 90% find) of keys
+// in [0,n).  Both maps start with the default number of bins, which is
+// what WorldContainer does.  Throughput is reported in Mop/s.
+//
+// The full sweep requested for tuning is
+//     test_hashmap_bench 100000000 128
+
+#include <madness/world/worldhashmap.h>
+#include <madness/world/lockfreehashmap.h>
+#include <madness/world/timers.h>
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace madness;
+
+namespace {
+
+    const long nop_max = 2000000; // Total operations per measurement
+
+    template <typename mapT>
+    struct Bench {
+        mapT* map;
+        long nkey;
+        long nop;
+        int find_percent;
+        unsigned int seed;
+    };
+
+    template <typename mapT>
+    void* worker(void* arg) {
+        Bench<mapT>& b = *static_cast<Bench<mapT>*>(arg);
+        long nfound = 0;
+        for (long i=0; i<b.nop; ++i) {
+            const long key = rand_r(&b.seed) % b.nkey;
+            if (int(rand_r(&b.seed) % 100) < b.find_percent) {
+                typename mapT::const_accessor acc;
+                if (b.map->find(acc, key)) nfound += (acc->second == key);
+            }
+            else {
+                b.map->insert(typename mapT::datumT(key, key));
+            }
+        }
+        b.seed = nfound; // Keep the finds from being optimized away
+        return 0;
+    }
+
+    /// Returns the throughput in Mop/s
+    template <typename mapT>
+    double run(long n, int nthread, int find_percent) {
+        mapT map;
+        for (long i=0; i<n; i+=2) map.insert(typename mapT::datumT(i, i));
+
+        std::vector< Bench<mapT> > bench(nthread);
+        std::vector<pthread_t> threads(nthread);
+        const long nop = std::max(nop_max / nthread, 1L);
+        for (int t=0; t<nthread; ++t) {
+            Bench<mapT> b = {&map, n, nop, find_percent, 12345u + 7919u*t};
+            bench[t] = b;
+        }
+
+        const double start = wall_time();
+        for (int t=0; t<nthread; ++t)
+            pthread_create(&threads[t], 0, worker<mapT>, &bench[t]);
+        for (int t=0; t<nthread; ++t)
+            pthread_join(threads[t], 0);
+        const double used = wall_time() - start;
+
+        return 1e-6*nop*nthread/used;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const long max_entries = (argc > 1) ? atol(argv[1]) : 100000;
+    const int max_threads = (argc > 2) ? atoi(argv[2]) : 4;
+    const int find_percent = (argc > 3) ? atoi(argv[3]) : 90;
+
+    typedef ConcurrentHashMap<long,long> lockedT;
+    typedef LockFreeHashMap<long,long> lockfreeT;
+
+    printf("  %% find = %d, ops per measurement = %ld\n\n", find_percent, nop_max);
+    printf("     entries  threads   ConcurrentHashMap   LockFreeHashMap   (Mop/s)\n");
+    for (long n=10000; n<=max_entries; n*=10) {
+        for (int nthread=1; nthread<=max_threads; nthread*=2) {
+            const double locked = run<lockedT>(n, nthread, find_percent);
+            const double lockfree = run<lockfreeT>(n, nthread, find_percent);
+            printf("  %10ld  %7d   %17.2f   %15.2f\n", n, nthread, locked, lockfree);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,217 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#include <madness/madness_config.h>
+#ifdef MADNESS_HAS_GOOGLE_TEST
+
+#define MADNESS_DISPLAY_EXCEPTION_BREAK_MESSAGE 0
+#include <madness/world/lockfreehashmap.h>
+#include <madness/world/range.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+    using namespace madness;
+
+    typedef LockFreeHashMap<int,int> mapT;
+    typedef mapT::datumT datumT;
+
+    TEST(LockFreeHashMapTest, InsertFindErase) {
+        mapT a(16);
+        const std::size_t nbucket0 = a.bucket_count();
+        const int n = 10000;
+        for(int i = 0; i < n; ++i) {
+            std::pair<mapT::iterator,bool> r = a.insert(datumT(i,i*99));
+            EXPECT_TRUE(r.second);
+            EXPECT_EQ(i, r.first->first);
+        }
+        EXPECT_EQ(std::size_t(n), a.size());
+        EXPECT_LT(nbucket0, a.bucket_count()); // Must have grown
+
+        for(int i = 0; i < n; ++i) {
+            std::pair<mapT::iterator,bool> r = a.insert(datumT(i,-1));
+            EXPECT_FALSE(r.second);
+            EXPECT_EQ(i*99, r.first->second);
+        }
+
+        const mapT& ca = a;
+        for(int i = 0; i < n; ++i) {
+            mapT::const_iterator it = ca.find(i);
+            ASSERT_TRUE(it != ca.end());
+            EXPECT_EQ(i*99, it->second);
+        }
+        EXPECT_TRUE(a.find(n) == a.end());
+
+        for(int i = 0; i < n; i += 2)
+            EXPECT_EQ(1u, a.erase(i));
+        EXPECT_EQ(0u, a.erase(0));
+        EXPECT_EQ(std::size_t(n/2), a.size());
+        for(int i = 0; i < n; ++i)
+            EXPECT_EQ(i%2 == 1, a.find(i) != a.end());
+
+        a[-1] = 7;
+        EXPECT_EQ(7, a[-1]);
+
+        a.clear();
+        EXPECT_EQ(0u, a.size());
+        EXPECT_TRUE(a.begin() == a.end());
+    }
+
+    TEST(LockFreeHashMapTest, Iteration) {
+        mapT a;
+        const int n = 5000;
+        for(int i = 0; i < n; ++i) a.insert(datumT(i,i));
+
+        std::vector<int> seen(n, 0);
+        for(mapT::iterator it = a.begin(); it != a.end(); ++it) {
+            EXPECT_EQ(it->first, it->second);
+            ++seen[it->first];
+        }
+        for(int i = 0; i < n; ++i) EXPECT_EQ(1, seen[i]);
+
+        // Range splitting as used by WorldContainer's parallel for_each
+        Range<mapT::iterator> left(a.begin(), a.end(), 8);
+        Range<mapT::iterator> right(left, Split());
+        long count = 0;
+        for(Range<mapT::iterator>::iterator it = left.begin(); it != left.end(); ++it) ++count;
+        for(Range<mapT::iterator>::iterator it = right.begin(); it != right.end(); ++it) ++count;
+        EXPECT_EQ(long(n), count);
+
+        mapT b(a);
+        EXPECT_EQ(a.size(), b.size());
+        for(int i = 0; i < n; ++i) EXPECT_TRUE(b.find(i) != b.end());
+    }
+
+    TEST(LockFreeHashMapTest, Accessors) {
+        mapT a;
+        {
+            mapT::accessor acc;
+            EXPECT_TRUE(a.insert(acc, 1));
+            acc->second = 10;
+        }
+        {
+            mapT::accessor acc;
+            EXPECT_FALSE(a.insert(acc, datumT(1, 99)));
+            EXPECT_EQ(10, acc->second);
+        }
+        {
+            mapT::const_accessor acc;
+            EXPECT_TRUE(a.find(acc, 1));
+            EXPECT_EQ(10, acc->second);
+            EXPECT_FALSE(a.find(acc, 2));
+        }
+        {
+            mapT::accessor acc;
+            EXPECT_TRUE(a.find(acc, 1));
+            a.erase(acc);
+        }
+        EXPECT_EQ(0u, a.size());
+        {
+            mapT::const_accessor acc;
+            EXPECT_TRUE(a.insert(acc, 3));
+            a.erase(acc);
+        }
+        EXPECT_TRUE(a.find(3) == a.end());
+    }
+
+    // Concurrent test: threads insert and erase random keys in a small
+    // range and increment values under write accessors
+    const int nthread = 4;
+    const int nkey = 512;
+    const int niter = 200000;
+    LockFreeHashMap<int,long>* shared_map = nullptr;
+
+    struct Result {
+        long ninsert, nerase;
+    };
+
+    void* worker(void* arg) {
+        Result& r = *static_cast<Result*>(arg);
+        unsigned int seed = reinterpret_cast<std::size_t>(arg);
+        r.ninsert = r.nerase = 0;
+        for(int i = 0; i < niter; ++i) {
+            const int key = rand_r(&seed) % nkey;
+            const int op = rand_r(&seed) % 4;
+            if(op == 0) {
+                if(shared_map->insert(LockFreeHashMap<int,long>::datumT(key, 0)).second) ++r.ninsert;
+            }
+            else if(op == 1) {
+                r.nerase += shared_map->erase(key);
+            }
+            else {
+                LockFreeHashMap<int,long>::accessor acc;
+                if(shared_map->find(acc, key)) ++(acc->second);
+            }
+        }
+        return nullptr;
+    }
+
+    TEST(LockFreeHashMapTest, ConcurrentInsertEraseFind) {
+        LockFreeHashMap<int,long> a(4); // Small, so it must grow while in use
+        shared_map = &a;
+        Result result[nthread];
+        pthread_t threads[nthread];
+        for(int t = 0; t < nthread; ++t)
+            pthread_create(&threads[t], nullptr, worker, &result[t]);
+        for(int t = 0; t < nthread; ++t)
+            pthread_join(threads[t], nullptr);
+
+        long net = 0;
+        for(int t = 0; t < nthread; ++t) net += result[t].ninsert - result[t].nerase;
+        EXPECT_EQ(std::size_t(net), a.size());
+
+        std::size_t count = 0;
+        for(LockFreeHashMap<int,long>::iterator it = a.begin(); it != a.end(); ++it) ++count;
+        EXPECT_EQ(a.size(), count);
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+
+    return status;
+}
+
+
+#else
+
+#include <iostream>
+int main() {
+    std::cout << "!!! Error: You need to build with Google test to enable LockFreeHashMap test code\n";
+    return 1;
+}
+
+#endif
@@ -0,0 +1,139 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#include <madness/madness_config.h>
+#ifdef MADNESS_HAS_GOOGLE_TEST
+
+#define MADNESS_DISPLAY_EXCEPTION_BREAK_MESSAGE 0
+#include <madness/world/poolmem.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <cstring>
+#include <vector>
+
+
+namespace {
+
+    using namespace madness;
+
+    bool aligned(void* p) {
+        return (reinterpret_cast<std::size_t>(p) % PoolMem::alignment) == 0;
+    }
+
+    TEST(PoolMemTest, AllocateIsAlignedAndWritable) {
+        const std::size_t sizes[] = {1, 63, 64, 65, 1000, 8*8*8*8, 20*20*20*8, (1ul << 22), (1ul << 22) + 1};
+        for(std::size_t s : sizes) {
+            char* p = static_cast<char*>(PoolMem::allocate(s));
+            ASSERT_NE(nullptr, p);
+            EXPECT_TRUE(aligned(p)) << "size " << s;
+            std::memset(p, 1, s);
+            PoolMem::deallocate(p);
+        }
+        PoolMem::deallocate(nullptr);
+    }
+
+    TEST(PoolMemTest, FreedBlockIsReused) {
+        const PoolMemStats before = PoolMem::get_stats();
+        void* p = PoolMem::allocate(4096);
+        PoolMem::deallocate(p);
+        void* q = PoolMem::allocate(4000); // Same size class
+        EXPECT_EQ(p, q);
+        PoolMem::deallocate(q);
+
+        const PoolMemStats after = PoolMem::get_stats();
+        EXPECT_EQ(before.nalloc + 2, after.nalloc);
+        EXPECT_LE(before.nhit + 1, after.nhit);
+        EXPECT_EQ(before.nfree + 2, after.nfree);
+    }
+
+    TEST(PoolMemTest, LargeBlocksAreNotPooled) {
+        const PoolMemStats before = PoolMem::get_stats();
+        void* p = PoolMem::allocate((1ul << 22) + 1);
+        PoolMem::deallocate(p);
+        const PoolMemStats after = PoolMem::get_stats();
+        EXPECT_EQ(before.nlarge + 1, after.nlarge);
+        EXPECT_EQ(before.cached_bytes, after.cached_bytes);
+    }
+
+    // Blocks allocated here are freed by another thread
+    const int nblock = 1000;
+    std::vector<void*> blocks;
+
+    void* remote_free(void*) {
+        for(int i = 0; i < nblock; ++i)
+            PoolMem::deallocate(blocks[i]);
+        return nullptr;
+    }
+
+    TEST(PoolMemTest, CrossThreadFree) {
+        const PoolMemStats before = PoolMem::get_stats();
+        blocks.resize(nblock);
+        for(int i = 0; i < nblock; ++i) {
+            blocks[i] = PoolMem::allocate(512);
+            std::memset(blocks[i], i, 512);
+        }
+
+        pthread_t thread;
+        pthread_create(&thread, nullptr, remote_free, nullptr);
+        pthread_join(thread, nullptr);
+
+        PoolMemStats after = PoolMem::get_stats();
+        EXPECT_EQ(before.nfree_remote + nblock, after.nfree_remote);
+
+        // The owner reclaims the remotely freed blocks
+        std::vector<void*> again(nblock);
+        for(int i = 0; i < nblock; ++i)
+            again[i] = PoolMem::allocate(512);
+        after = PoolMem::get_stats();
+        EXPECT_LE(before.nhit + nblock, after.nhit);
+        for(int i = 0; i < nblock; ++i)
+            PoolMem::deallocate(again[i]);
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+
+    return status;
+}
+
+
+#else
+
+#include <iostream>
+int main() {
+    std::cout << "!!! Error: You need to build with Google test to enable PoolMem test code\n";
+    return 1;
+}
+
+#endif
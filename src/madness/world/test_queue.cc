@@ -1,6 +1,10 @@
 #include <madness/world/MADworld.h>
 
 // This program is used to do a simple test of the task queue.
+//
+// It doubles as a scheduler throughput benchmark; to measure scaling
+// run it with MAD_NUM_THREADS=1,2,4,...,N, with and without
+// MAD_WORK_STEALING=1, and compare the reported tasks/s.
 
 const int NGEN=100;
 const int NTASK=100000;
@@ -83,9 +87,13 @@ int main(int argc, char** argv) {
     double finish = madness::wall_time();
 
 
-    std::cout << "Total tasks = " << total_count
+    std::cout << "Scheduler = "
+            << (madness::ThreadPool::is_work_stealing() ? "work-stealing" : "shared queue")
+            << "\nThreads = " << madness::ThreadPool::size() + 1
+            << "\nTotal tasks = " << total_count
             << "\nTotal runtime = " << finish - start
-            << " (s)\nTasks per thread:\n";
+            << " (s)\nThroughput = " << double(total_count) / (finish - start)
+            << " (tasks/s)\nTasks per thread:\n";
     for (unsigned long i = 0; i < (madness::ThreadPool::size() + 1); ++i)
         std::cout << i << " " << thread_counters[i] << "\n";
 
@@ -0,0 +1,151 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_rmi_bandwidth.cc
+/// \brief Measures RMI bandwidth of copied and zero-copy sends by message size
+
+// Usage: mpirun -np 2 test_rmi_bandwidth [max_bytes [total_bytes]]
+//
+// Process 0 sends messages of 1KB, 4KB, ... up to max_bytes (default
+// 1GB) to process 1, repeating each size until about total_bytes
+// (default 256MB) have been sent.  Each size is sent two ways:
+//
+//   copy       the payload is copied behind a header into a freshly
+//              allocated buffer and sent with RMI::isend, which is
+//              what serializing a tensor into an AmArg amounts to
+//   zero-copy  a header and the payload in place are sent with
+//              RMI::isendv
+//
+// Bandwidth is reported in MB/s. The behaviour of huge messages before
+// pipelining and concurrent receives was added is approximated by
+// running with MAD_RMI_CHUNK=0 MAD_RMI_HUGE_RECV=1.
+
+#include <madness/world/MADworld.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace madness;
+
+namespace {
+
+    volatile long nrecv = 0; // Only written by the server thread
+
+    void handler(void* /*buf*/, std::size_t /*nbyte*/) {
+        nrecv = nrecv + 1;
+    }
+
+    void* aligned_alloc_or_die(std::size_t nbyte) {
+        void* p = 0;
+        if (posix_memalign(&p, RMI::ALIGNMENT, nbyte))
+            MADNESS_EXCEPTION("test_rmi_bandwidth: allocation failed", 0);
+        return p;
+    }
+
+    /// Sends nrep messages with payload nbyte to process 1 and returns the time taken
+    double measure(World& world, bool zero_copy, std::size_t nbyte, int nrep, const char* payload) {
+        static long nexpected = 0;
+        nexpected += nrep;
+
+        world.gop.barrier();
+        const double start = wall_time();
+
+        if (world.rank() == 0) {
+            std::vector<RMI::Request> req(nrep);
+            std::vector<void*> buf(nrep);
+            for (int i=0; i<nrep; ++i) {
+                if (zero_copy) {
+                    buf[i] = aligned_alloc_or_die(RMI::HEADER_LEN);
+                    const RMI::Segment seg[2] = {{buf[i], RMI::HEADER_LEN}, {payload, nbyte}};
+                    req[i] = RMI::isendv(seg, 2, 1, handler, RMI::ATTR_ORDERED);
+                }
+                else {
+                    buf[i] = aligned_alloc_or_die(RMI::HEADER_LEN + nbyte);
+                    std::memcpy(static_cast<char*>(buf[i]) + RMI::HEADER_LEN, payload, nbyte);
+                    req[i] = RMI::isend(buf[i], RMI::HEADER_LEN + nbyte, 1, handler, RMI::ATTR_ORDERED);
+                }
+            }
+            for (int i=0; i<nrep; ++i) {
+                while (!req[i].Test()) myusleep(10);
+                free(buf[i]);
+            }
+        }
+        else if (world.rank() == 1) {
+            while (nrecv < nexpected) myusleep(10);
+        }
+
+        world.gop.barrier();
+        return wall_time() - start;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    madness::initialize(argc,argv);
+    {
+        World world(SafeMPI::COMM_WORLD);
+
+        double max_bytes = 1073741824.0, total_bytes = 268435456.0;
+        if (argc > 1) max_bytes = atof(argv[1]);
+        if (argc > 2) total_bytes = atof(argv[2]);
+
+        if (world.size() < 2) {
+            if (world.rank() == 0) printf("test_rmi_bandwidth needs at least 2 processes\n");
+        }
+        else {
+            char* payload = 0;
+            if (world.rank() == 0) {
+                payload = static_cast<char*>(aligned_alloc_or_die(std::size_t(max_bytes)));
+                std::memset(payload, 1, std::size_t(max_bytes));
+            }
+
+            if (world.rank() == 0) {
+                printf("  max_msg_len %lu\n", (unsigned long) RMI::max_msg_len());
+                printf("      bytes   nrep      copy MB/s  zero-copy MB/s\n");
+            }
+            for (double n = 1024.0; n <= max_bytes; n *= 4.0) {
+                const std::size_t nbyte = std::size_t(n);
+                const int nrep = std::max(1, std::min(1000, int(total_bytes/n)));
+                const double tcopy = measure(world, false, nbyte, nrep, payload);
+                const double tzero = measure(world, true, nbyte, nrep, payload);
+                if (world.rank() == 0)
+                    printf(" %10lu %6d %14.1f %15.1f\n", (unsigned long) nbyte, nrep,
+                           nrep*n/tcopy/1048576.0, nrep*n/tzero/1048576.0);
+            }
+            free(payload);
+        }
+
+        world.gop.fence();
+    }
+    madness::finalize();
+    return 0;
+}
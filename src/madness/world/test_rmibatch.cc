@@ -0,0 +1,129 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_rmibatch.cc
+/// \brief Tests aggregation of small active messages in RMI
+
+/// Run on one process this only checks that nothing is aggregated;
+/// run on several (e.g., mpirun -np 3) it checks that ordered messages
+/// stay in sequence when mixed with messages too large to batch, and
+/// that replies held in a batch are delivered by the timeout.
+
+#define WORLD_INSTANTIATE_STATIC_TEMPLATES
+#include <madness/world/MADworld.h>
+#include <cstdlib>
+#include <vector>
+
+using namespace madness;
+using namespace std;
+
+class Receiver : public WorldObject<Receiver> {
+    std::vector<int> expected; // Next sequence no. from each process
+    long nerror;
+public:
+    Receiver(World& world)
+        : WorldObject<Receiver>(world), expected(world.size(), 0), nerror(0)
+    {
+        process_pending();
+    }
+
+    void small(ProcessID src, int seq) {
+        if (seq != expected[src]++) ++nerror;
+    }
+
+    void large(ProcessID src, int seq, const std::vector<double>& v) {
+        if (seq != expected[src]++ || v.size() != 65536 || v[12345] != seq) ++nerror;
+    }
+
+    int echo(int i) const {
+        return i;
+    }
+
+    long get_nerror() const {
+        return nerror;
+    }
+};
+
+int main(int argc, char** argv) {
+    setenv("MAD_RMI_BATCH", "16384", 0);
+    madness::initialize(argc,argv);
+    madness::World world(SafeMPI::COMM_WORLD);
+
+    const int nmsg = 20000;
+    const ProcessID me = world.rank();
+    const ProcessID nproc = world.size();
+    long nerror = 0;
+
+    Receiver r(world);
+    world.gop.fence();
+
+    // Ordered messages to every other process, some too large to batch
+    for (int i=0; i<nmsg; ++i) {
+        for (ProcessID p=0; p<nproc; ++p) {
+            if (p == me) continue;
+            if (i%1000 == 999)
+                r.send(p, &Receiver::large, me, i, std::vector<double>(65536, double(i)));
+            else
+                r.send(p, &Receiver::small, me, i);
+        }
+    }
+
+    // Round trips with no fence to push the batches out
+    for (ProcessID p=0; p<nproc; ++p) {
+        if (p == me) continue;
+        if (r.send(p, &Receiver::echo, int(p)).get() != p) ++nerror;
+    }
+
+    world.gop.fence();
+    nerror += r.get_nerror();
+    world.gop.sum(nerror);
+
+    const RMIStats& stats = RMI::get_stats();
+    if (nproc > 1) {
+        if (stats.nbatch_sent == 0 || stats.nbatch_recv == 0) ++nerror;
+        if (stats.nflush_order == 0) ++nerror;
+    }
+    else {
+        if (RMI::batch_size() != 0 || stats.nbatch_sent != 0) ++nerror;
+    }
+
+    if (me == 0) {
+        print("batch size", RMI::batch_size(), "batches sent", stats.nbatch_sent,
+              "messages batched", stats.nmsg_batched, "max per batch", stats.max_msg_per_batch);
+        print("flushes: size", stats.nflush_size, "timeout", stats.nflush_timeout,
+              "fence", stats.nflush_fence, "order", stats.nflush_order);
+        print(nerror ? "FAILED" : "PASSED", nerror);
+    }
+
+    world.gop.fence();
+    madness::finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,122 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_task_fusion.cc
+/// \brief Tests inlining and fusion of tiny tasks
+
+/// Builds the same tree of tiny tasks as \c compress (one task per node
+/// spawning its children, plus one task per interior node combining their
+/// results) with and without fusion, checks the results agree and that
+/// every task with a cost hint is accounted for in the statistics.
+
+#include <madness/world/MADworld.h>
+#include <cstdio>
+#include <vector>
+
+using namespace madness;
+
+const int nchild = 8;
+World* world_ptr = nullptr;
+
+long combine(const std::vector< Future<long> >& v) {
+    long sum = 1;
+    for (const Future<long>& f : v) sum += f.get();
+    return sum;
+}
+
+Future<long> spawn(int level) {
+    if (level == 0) return Future<long>(1);
+    std::vector< Future<long> > v(nchild);
+    for (int i=0; i<nchild; ++i)
+        v[i] = world_ptr->taskq.add(spawn, level-1, TaskAttributes::cost_hint(1, true));
+    return world_ptr->taskq.add(combine, v, TaskAttributes::cost_hint(1));
+}
+
+/// Number of nodes in a tree with \c nlevel levels below the root
+long nnode(int nlevel) {
+    long n = 1, width = 1;
+    for (int level=0; level<nlevel; ++level) {
+        width *= nchild;
+        n += width;
+    }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    madness::initialize(argc,argv);
+    long nerror = 0;
+    {
+        World world(SafeMPI::COMM_WORLD);
+        world_ptr = &world;
+        const int nlevel = 5;
+        const long nexpected = nnode(nlevel);
+        const long ninterior = nnode(nlevel-1);
+        const unsigned int threshold = TaskFusion::threshold();
+
+        TaskFusion::set_threshold(0);
+        double start = wall_time();
+        Future<long> unfused = spawn(nlevel);
+        world.gop.fence();
+        const double time_unfused = wall_time() - start;
+
+        TaskFusion::set_threshold(10);
+        const TaskFusionStats before = TaskFusion::get_stats();
+        start = wall_time();
+        Future<long> fused = spawn(nlevel);
+        world.gop.fence();
+        const double time_fused = wall_time() - start;
+        const TaskFusionStats after = TaskFusion::get_stats();
+
+        const long ninline = after.ninline - before.ninline;
+        const long nfused = after.nfused - before.nfused;
+        const long nbatch = after.nbatch - before.nbatch;
+        const long nqueued = after.nqueued - before.nqueued;
+        if (world.rank() == 0) {
+            print("tree of", nexpected, "nodes: unfused", time_unfused, "s, fused", time_fused, "s");
+            print("inline", ninline, "fused", nfused, "in", nbatch, "batches, queued", nqueued);
+        }
+
+        if (unfused.get() != nexpected) ++nerror;
+        if (fused.get() != nexpected) ++nerror;
+        if (TaskFusion::threshold() != 0) {
+            // Every spawn task but the root's, and every combine task
+            if (ninline + nfused + nqueued != (nexpected - 1) + ninterior) ++nerror;
+            if (nbatch > nfused) ++nerror;
+        }
+        TaskFusion::set_threshold(threshold);
+
+        world.gop.sum(nerror);
+        if (world.rank() == 0) print(nerror ? "FAILED" : "PASSED");
+        world.gop.fence();
+    }
+    madness::finalize();
+    return nerror ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/// \file test_tracer.cc
+/// \brief Tests the event tracer and its Chrome trace output
+
+/// Traces tasks with and without dependencies, remote tasks and a fence,
+/// writes the trace and checks that each kind of event appears in this
+/// process's file.
+
+#include <madness/world/MADworld.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace madness;
+
+int twice(int i) {
+    return 2*i;
+}
+
+int add(int a, int b) {
+    return a + b;
+}
+
+/// Counts the occurrences of \c pattern in \c text
+long count(const std::string& text, const std::string& pattern) {
+    long n = 0;
+    for (std::size_t pos = text.find(pattern); pos != std::string::npos;
+         pos = text.find(pattern, pos + pattern.size()))
+        ++n;
+    return n;
+}
+
+int main(int argc, char** argv) {
+    madness::initialize(argc,argv);
+    long nerror = 0;
+    {
+        World world(SafeMPI::COMM_WORLD);
+        const ProcessID me = world.rank();
+        const int np = world.size();
+        const int ntask = 100;
+
+        world.gop.fence();
+        const bool was_enabled = profiling::Tracer::enabled();
+        profiling::Tracer::enable("test_tracer");
+
+        std::vector< Future<int> > sum(ntask + 1);
+        sum[0].set(0);
+        for (int i=0; i<ntask; ++i) {
+            Future<int> t = world.taskq.add(twice, i);
+            sum[i+1] = world.taskq.add(add, sum[i], t); // Depends on the previous tasks
+            world.taskq.add((me + 1) % np, twice, i);
+        }
+        world.gop.fence();
+        if (sum[ntask].get() != ntask*(ntask-1)) ++nerror;
+
+        profiling::Tracer::write(world);
+        if (!was_enabled) profiling::Tracer::disable();
+
+        std::ostringstream filename;
+        filename << "test_tracer." << me << ".json";
+        std::ifstream file(filename.str().c_str());
+        std::stringstream ss;
+        ss << file.rdbuf();
+        const std::string trace = ss.str();
+        file.close();
+        std::remove(filename.str().c_str());
+
+        const long nsubmit = count(trace, "\"name\":\"submit\"");
+        const long nready = count(trace, "\"name\":\"ready\"");
+        const long nrun = count(trace, "\"cat\":\"task\",\"ph\":\"X\"");
+        const long nfence = count(trace, "\"name\":\"fence\"");
+        const long nsend = count(trace, "\"name\":\"send\"");
+        print("rank", me, "submit", nsubmit, "ready", nready, "run", nrun,
+              "fence", nfence, "send", nsend);
+
+        if (trace.find("\"traceEvents\":[") == std::string::npos) ++nerror;
+        if (nsubmit < 3*ntask) ++nerror;
+        if (nready < 1) ++nerror;
+        if (nrun < 3*ntask) ++nerror;
+        if (nfence < 1) ++nerror;
+        if (np > 1 && nsend < ntask) ++nerror;
+
+        world.gop.sum(nerror);
+        if (me == 0) print(nerror ? "FAILED" : "PASSED");
+        world.gop.fence();
+    }
+    madness::finalize();
+    return nerror ? 1 : 0;
+}
@@ -1093,6 +1093,95 @@ void test13(World& world) {
     world.gop.fence();
 }
 
+void test13a(World& world) {
+    PROFILE_FUNC;
+    // Read archives with fewer and with more processes than wrote them
+    const ProcessID me = world.rank();
+    const int nio = std::min(world.size(), 10);
+    const int ntotal = 100*world.size();
+    double a = 0.0, b = 0.0;
+
+    // Written by all processes, read by process zero alone
+    {
+        WorldContainer<int,double> d(world);
+        for (int i=0; i<100; ++i) d.replace(me*100 + i, double(me*100 + i));
+        world.gop.fence();
+        archive::ParallelOutputArchive fout(world, "elastic", nio);
+        fout & 2.0 & d & 3.0;   // the local values check the positions in the files
+        fout.close();
+    }
+    {
+        SafeMPI::Intracomm comm = world.mpi.comm().Split(me == 0 ? 0 : 1, me);
+        World subworld(comm);
+        if (me == 0) {
+            WorldContainer<int,double> c(subworld);
+            archive::ParallelInputArchive fin(subworld, "elastic");
+            fin & a & c & b;
+            fin.close();
+            MADNESS_ASSERT(a == 2.0 && b == 3.0);
+            MADNESS_ASSERT(long(c.size()) == ntotal);
+            for (int key=0; key<ntotal; ++key) MADNESS_ASSERT(c.find(key).get()->second == key);
+        }
+    }
+    world.gop.fence();
+    archive::ParallelOutputArchive::remove(world, "elastic");
+    world.gop.fence();
+
+    // Written by process zero alone, read by all processes
+    {
+        SafeMPI::Intracomm comm = world.mpi.comm().Split(me == 0 ? 0 : 1, me);
+        World subworld(comm);
+        if (me == 0) {
+            WorldContainer<int,double> d(subworld);
+            for (int key=0; key<ntotal; ++key) d.replace(key, double(key));
+            subworld.gop.fence();
+            archive::ParallelOutputArchive fout(subworld, "elastic", 1);
+            fout & 2.0 & d & 3.0;
+            fout.close();
+        }
+    }
+    world.gop.fence();
+    WorldContainer<int,double> c(world);
+    archive::ParallelInputArchive fin(world, "elastic");
+    fin & a & c & b;
+    fin.close();
+    fin.remove();
+    MADNESS_ASSERT(a == 2.0 && b == 3.0);
+    long nlocal = c.size();
+    world.gop.sum(nlocal);
+    MADNESS_ASSERT(nlocal == ntotal);
+    for (int key=me; key<ntotal; key+=world.size()) MADNESS_ASSERT(c.find(key).get()->second == key);
+
+    world.gop.fence();
+    if (me == 0) print("test13a (archive I/O with a different number of processes) OK");
+}
+
+void test14(World& world) {
+    PROFILE_FUNC;
+    const ProcessID me = world.rank();
+    const long np = world.size();
+
+    // Start several reductions before waiting on any of them
+    Future<long> sum = world.gop.isum(long(me+1));
+    Future<long> max = world.gop.imax(long(me));
+    Future<double> min = world.gop.imin(double(me));
+    vector<double> v(100);
+    for (unsigned int i=0; i<v.size(); ++i) v[i] = me + i;
+    Future< vector<double> > vsum = world.gop.isum(v);
+    Future<long> rsum = world.gop.ireduce(long(me), WorldSumOp<long>(), np-1);
+
+    MADNESS_ASSERT(sum.get() == np*(np+1)/2);
+    MADNESS_ASSERT(max.get() == np-1);
+    MADNESS_ASSERT(min.get() == 0.0);
+    MADNESS_ASSERT(vsum.get().size() == v.size());
+    for (unsigned int i=0; i<v.size(); ++i)
+        MADNESS_ASSERT(vsum.get()[i] == 0.5*np*(np-1) + np*i);
+    if (me == np-1) MADNESS_ASSERT(rsum.get() == np*(np-1)/2);
+
+    world.gop.fence();
+    if (me == 0) print("test14 (non-blocking reductions) OK");
+}
+
 inline bool is_odd(int i) {
     return i & 0x1;
 }
@@ -1257,6 +1346,8 @@ int main(int argc, char** argv) {
         //test11(world);
         test12(world);
         test13(world);
+        test13a(world);
+        test14(world);
 
         for (int i=0; i<10; ++i) {
           print("REPETITION",i);
@@ -0,0 +1,165 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#include <madness/madness_config.h>
+#ifdef MADNESS_HAS_GOOGLE_TEST
+
+#define MADNESS_DISPLAY_EXCEPTION_BREAK_MESSAGE 0
+#include <madness/world/wsdeque.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <vector>
+
+
+namespace {
+
+    using namespace madness;
+
+    typedef WSDeque<long*> Deque_;
+
+    // Encode an integer as a non-null pointer
+    long* make(long i) { return reinterpret_cast<long*>((i + 1) * sizeof(long)); }
+    long value(long* p) { return long(reinterpret_cast<std::size_t>(p) / sizeof(long)) - 1; }
+
+    TEST(WSDequeTest, DefaultConstructor) {
+        Deque_ d;
+        EXPECT_EQ(0u, d.size());
+        EXPECT_TRUE(d.empty());
+        EXPECT_EQ(nullptr, d.pop());
+        EXPECT_EQ(nullptr, d.steal());
+    }
+
+    TEST(WSDequeTest, PushPopIsLIFO) {
+        Deque_ d(4);
+        const long n = 100; // Forces several grows
+        for(long i = 0; i < n; ++i) {
+            d.push(make(i));
+            EXPECT_EQ(std::size_t(i + 1), d.size());
+        }
+        EXPECT_LT(0u, d.get_stats().ngrow);
+
+        for(long i = n - 1; i >= 0; --i) {
+            long* p = d.pop();
+            ASSERT_NE(nullptr, p);
+            EXPECT_EQ(i, value(p));
+        }
+        EXPECT_TRUE(d.empty());
+        EXPECT_EQ(nullptr, d.pop());
+    }
+
+    TEST(WSDequeTest, StealIsFIFO) {
+        Deque_ d(4);
+        for(long i = 0; i < 10; ++i)
+            d.push(make(i));
+
+        for(long i = 0; i < 5; ++i) {
+            long* p = d.steal();
+            ASSERT_NE(nullptr, p);
+            EXPECT_EQ(i, value(p));
+        }
+        for(long i = 9; i >= 5; --i) {
+            long* p = d.pop();
+            ASSERT_NE(nullptr, p);
+            EXPECT_EQ(i, value(p));
+        }
+        EXPECT_EQ(nullptr, d.steal());
+        EXPECT_EQ(nullptr, d.pop());
+    }
+
+    // Shared state for the concurrent test
+    const long nitem = 200000;
+    const int nthief = 3;
+    Deque_* shared_deque = nullptr;
+    volatile bool owner_done = false;
+
+    void* thief(void* arg) {
+        std::vector<long>& got = *static_cast<std::vector<long>*>(arg);
+        while(true) {
+            long* p = shared_deque->steal();
+            if(p) got.push_back(value(p));
+            else if(owner_done && shared_deque->empty()) break;
+        }
+        return nullptr;
+    }
+
+    TEST(WSDequeTest, ConcurrentStealNoLossNoDuplicate) {
+        Deque_ d(2);
+        shared_deque = &d;
+        owner_done = false;
+
+        std::vector<std::vector<long> > got(nthief + 1);
+        pthread_t threads[nthief];
+        for(int t = 0; t < nthief; ++t)
+            pthread_create(&threads[t], nullptr, thief, &got[t + 1]);
+
+        // The owner interleaves pushes and pops while the thieves steal
+        for(long i = 0; i < nitem; ++i) {
+            d.push(make(i));
+            if(i % 3 == 0) {
+                long* p = d.pop();
+                if(p) got[0].push_back(value(p));
+            }
+        }
+        while(long* p = d.pop())
+            got[0].push_back(value(p));
+        owner_done = true;
+
+        for(int t = 0; t < nthief; ++t)
+            pthread_join(threads[t], nullptr);
+
+        // Every item must have been taken exactly once
+        std::vector<int> count(nitem, 0);
+        for(std::size_t t = 0; t < got.size(); ++t)
+            for(std::size_t i = 0; i < got[t].size(); ++i)
+                ++count[got[t][i]];
+        for(long i = 0; i < nitem; ++i)
+            ASSERT_EQ(1, count[i]) << "item " << i;
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    int status = RUN_ALL_TESTS();
+
+    return status;
+}
+
+
+#else
+
+#include <iostream>
+int main() {
+    std::cout << "!!! Error: You need to build with Google test to enable WSDeque test code\n";
+    return 1;
+}
+
+#endif
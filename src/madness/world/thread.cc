@@ -74,6 +74,7 @@ namespace madness {
 
     ThreadPool* ThreadPool::instance_ptr = 0;
     double ThreadPool::await_timeout = 900.0;
+    bool ThreadPool::work_stealing = false;
 #if HAVE_INTEL_TBB
     tbb::task_scheduler_init* ThreadPool::tbb_scheduler = 0;
 #endif
@@ -338,13 +339,24 @@ namespace madness {
 #endif
     // The constructor is private to enforce the singleton model
     ThreadPool::ThreadPool(int nthread) :
-            threads(nullptr), main_thread(), nthreads(nthread), finish(false)
+            threads(nullptr), main_thread(), nthreads(nthread), finish(false),
+            nsleepers(0), wakeup_pending(0)
     {
         nfinished = 0;
         instance_ptr = this;
         if (nthreads < 0) nthreads = default_nthread();
         MADNESS_ASSERT(nthreads >= 0);
 
+        // Must be decided before any pool thread starts
+        NUMATopology::initialize();
+        const char* mad_work_stealing = getenv("MAD_WORK_STEALING");
+        if (mad_work_stealing) {
+            int value = 0;
+            if (sscanf(mad_work_stealing, "%d", &value) != 1)
+                MADNESS_EXCEPTION("MAD_WORK_STEALING is not an integer", 0);
+            work_stealing = (value != 0);
+        }
+
         const int rc = pthread_setspecific(ThreadBase::thread_key,
                 static_cast<void*>(&main_thread));
         if(rc != 0)
@@ -403,6 +415,24 @@ namespace madness {
             MADNESS_EXCEPTION("memory allocation failed", 0);
         }
 
+        // Assign threads to NUMA nodes and set the order in which they
+        // steal from each other (same node first)
+        const bool numa_socket = (NUMATopology::policy() == NUMA_SOCKET);
+        for (int i=-1; i<nthreads; ++i) {
+            ThreadPoolThread* const t = (i < 0 ? &main_thread : threads + i);
+            const int node = (i < 0 ? NUMATopology::current_node() :
+                    NUMATopology::node_of_pool_thread(i, nthreads));
+            std::vector<int> victims;
+            for (int j=0; j<nthreads; ++j)
+                if (j != i && (!numa_socket || NUMATopology::node_of_pool_thread(j, nthreads) == node))
+                    victims.push_back(j);
+            const int nlocal = victims.size();
+            for (int j=0; j<nthreads; ++j)
+                if (j != i && numa_socket && NUMATopology::node_of_pool_thread(j, nthreads) != node)
+                    victims.push_back(j);
+            t->set_numa_placement(node, victims, nlocal);
+        }
+
         for (int i=0; i<nthreads; ++i) {
             threads[i].set_pool_thread_index(i);
             threads[i].start(pool_thread_main, (void *)(threads+i));
@@ -438,7 +468,10 @@ namespace madness {
 
     void ThreadPool::thread_main(ThreadPoolThread* const thread) {
         PROFILE_MEMBER_FUNC(ThreadPool);
-        thread->set_affinity(2, thread->get_pool_thread_index());
+        if (NUMATopology::policy() == NUMA_SOCKET)
+            NUMATopology::bind_to_node(thread->numa_node());
+        else
+            thread->set_affinity(2, thread->get_pool_thread_index());
 
 #if !HAVE_PARSEC
 #define MULTITASK
@@ -460,6 +493,91 @@ namespace madness {
         nfinished++;
     }
 
+#if !HAVE_INTEL_TBB
+    bool ThreadPool::run_injected_tasks(bool wait, ThreadPoolThread* const this_thread) {
+        PoolTaskInterface* taskbuf[nmax];
+        const int ntask = queue.pop_front(nmax, taskbuf, wait);
+        for (int i=0; i<ntask; ++i) {
+            if (taskbuf[i])
+                run_one(taskbuf[i], this_thread);
+            else // A wakeup token posted by push_local
+                wakeup_pending.store(0);
+        }
+        return (ntask>0);
+    }
+
+    PoolTaskInterface* ThreadPool::steal(ThreadPoolThread* const this_thread, bool sweep) {
+        const bool is_pool_thread = this_thread && (this_thread->get_pool_thread_index() >= 0);
+
+        // The main thread has no deque of its own and is not a victim
+        ThreadPoolThread* const thief = (is_pool_thread ? this_thread : &main_thread);
+        const std::vector<int>& victims = thief->victims();
+        const int nvictim = victims.size();
+        if (nvictim == 0) return nullptr;
+        const int nlocal = thief->nlocal_victims();
+        const int nremote = nvictim - nlocal;
+
+        PoolTaskInterface* task = nullptr;
+        int i = 0;
+        if (sweep) {
+            // Every local victim from a random start, then every remote one
+            const unsigned int r = thief->random();
+            for (; i<nvictim && !task; ++i) {
+                const int v = (i < nlocal) ? (r + i) % nlocal : nlocal + (r + i) % nremote;
+                task = threads[victims[v]].deque().steal();
+            }
+            --i;
+        }
+        else {
+            const unsigned int r = thief->random();
+            i = (nremote == 0 || (nlocal > 0 && (r & 3u))) ?
+                    int((r >> 2) % nlocal) : nlocal + int((r >> 2) % nremote);
+            task = threads[victims[i]].deque().steal();
+        }
+        if (is_pool_thread) this_thread->deque().record_steal(task != nullptr, i >= nlocal);
+        return task;
+    }
+
+    bool ThreadPool::run_tasks_ws(bool wait, ThreadPoolThread* const this_thread) {
+        // Injected tasks come first since high-priority tasks are there
+        if (!queue.empty() && run_injected_tasks(false, this_thread))
+            return true;
+
+        PoolTaskInterface* task = nullptr;
+        if (this_thread && (this_thread->get_pool_thread_index() >= 0))
+            task = this_thread->deque().pop();
+
+        for (int i=0; (i<(wait ? nspin : 1)) && !task; ++i) {
+            task = steal(this_thread, false);
+            if (!task) {
+                if (!queue.empty()) return run_injected_tasks(false, this_thread);
+                cpu_relax();
+            }
+        }
+
+        if (!task && wait && !finish) {
+            // Announce we are going to sleep and then look once more at
+            // every deque.  Pairs with the fence in push_local so that a
+            // concurrently pushed task is either found here or triggers a
+            // wakeup token.
+            nsleepers.fetch_add(1);
+            task = steal(this_thread, true);
+            if (!task) {
+                const bool result = run_injected_tasks(true, this_thread);
+                nsleepers.fetch_sub(1);
+                return result;
+            }
+            nsleepers.fetch_sub(1);
+        }
+
+        if (task) {
+            run_one(task, this_thread);
+            return true;
+        }
+        return false;
+    }
+#endif // !HAVE_INTEL_TBB
+
     // Forwards thread to bound member function
     void* ThreadPool::pool_thread_main(void *v) {
         instance()->thread_main((ThreadPoolThread*)(v));
@@ -494,6 +612,12 @@ namespace madness {
             }
         }
 
+        if(work_stealing && SafeMPI::COMM_WORLD.Get_rank() == 0)
+            std::cout << "MADNESS thread pool using work-stealing deques.\n";
+        if(NUMATopology::policy() == NUMA_SOCKET && SafeMPI::COMM_WORLD.Get_rank() == 0)
+            std::cout << "MADNESS thread pool bound to " << NUMATopology::nnodes()
+                      << " NUMA node(s) (MAD_NUMA_POLICY=socket).\n";
+
 #ifdef MADNESS_TASK_PROFILING
         // Initialize the output file name for the task profiler.
         profiling::TaskProfiler::output_file_name_ =
@@ -558,4 +682,19 @@ namespace madness {
         return instance()->queue.get_stats();
     }
 
+    // Returns work-stealing statistics
+    WSStats ThreadPool::get_ws_stats() {
+        WSStats result;
+        for (int i=0; i<instance()->nthreads; ++i) {
+            const WSStats& s = instance()->threads[i].deque().get_stats();
+            result.npush += s.npush;
+            result.npop += s.npop;
+            result.nsteal += s.nsteal;
+            result.nsteal_fail += s.nsteal_fail;
+            result.nsteal_remote += s.nsteal_remote;
+            result.ngrow += s.ngrow;
+        }
+        return result;
+    }
+
 } // namespace madness
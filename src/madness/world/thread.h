@@ -39,7 +39,13 @@
 */
 
 #include <madness/world/dqueue.h>
+#include <madness/world/wsdeque.h>
+#include <madness/world/numa.h>
 #include <madness/world/function_traits.h>
+#include <madness/world/timers.h>
+#include <madness/world/tracer.h>
+#include <madness/world/task_fusion.h>
+#include <atomic>
 #include <vector>
 #include <cstddef>
 #include <cstdio>
@@ -285,6 +291,8 @@ namespace madness {
         static const unsigned long GENERATOR = 1ul<<8; ///< Mask for generator bit.
         static const unsigned long STEALABLE = GENERATOR<<1; ///< Mask for stealable bit.
         static const unsigned long HIGHPRIORITY = GENERATOR<<2; ///< Mask for priority bit.
+        static const unsigned long COST = 0xfffful<<16; ///< Mask for the cost hint.
+        static const int COST_SHIFT = 16; ///< Position of the cost hint.
 
         /// Sets the attributes to the desired values.
 
@@ -351,6 +359,26 @@ namespace madness {
                 flags &= ~HIGHPRIORITY;
         }
 
+        /// Sets the cost hint.
+
+        /// The hint is an estimate of the run time of the task in
+        /// microseconds; zero (the default) means unknown. Tasks with a
+        /// small enough hint may be run inline or fused with other tasks
+        /// (see \c TaskFusion).
+        /// \param[in] cost The estimated run time in microseconds; values
+        ///     above 65535 are saturated.
+        void set_cost(unsigned long cost) {
+            if (cost > (COST >> COST_SHIFT)) cost = COST >> COST_SHIFT;
+            flags = (flags & (~COST)) | (cost << COST_SHIFT);
+        }
+
+        /// Get the cost hint.
+
+        /// \return The estimated run time in microseconds, or zero if unknown.
+        unsigned int get_cost() const {
+            return (flags & COST) >> COST_SHIFT;
+        }
+
         /// Set the number of threads.
 
         /// \attention Are you sure this is what you want to call? Only call
@@ -414,6 +442,17 @@ namespace madness {
             t.set_nthread(nthread);
             return t;
         }
+
+        /// Attributes for a task with an estimated run time.
+
+        /// \param[in] cost The estimated run time in microseconds.
+        /// \param[in] hipri True for a high priority task.
+        /// \return The attributes.
+        static TaskAttributes cost_hint(unsigned long cost, bool hipri = false) {
+            TaskAttributes t(hipri ? HIGHPRIORITY : 0ul);
+            t.set_cost(cost);
+            return t;
+        }
     };
 
     /// Used to pass information about the thread environment to a user's task.
@@ -824,6 +863,7 @@ namespace madness {
             public TaskAttributes
     {
         friend class ThreadPool;
+        friend class TaskFusion;
 
     private:
 
@@ -902,6 +942,13 @@ namespace madness {
             id.second = 0ul;
         }
 
+        /// Records the execution of this task, which began at \c start, with the tracer
+        void trace_run(const double start) const {
+            std::pair<void*,unsigned short> id;
+            get_id(id);
+            profiling::Tracer::task_run(this, id.first, id.second, start);
+        }
+
 #ifndef HAVE_INTEL_TBB
 
         Barrier* barrier; ///< Barrier, only allocated for multithreaded tasks.
@@ -916,11 +963,16 @@ namespace madness {
             // A downside is this does not preserve any relationships between thread
             // numbering and the architecture ... more work ahead.
             int nthread = get_nthread();
+            const double trace_start = profiling::Tracer::enabled() ? wall_time() : 0.0;
             if (nthread == 1) {
 #ifdef MADNESS_TASK_PROFILING
                 task_event_->start(id_, nthread, submit_time_);
 #endif // MADNESS_TASK_PROFILING
-                run(TaskThreadEnv(1,0,0));
+                {
+                    TaskFusion::Scope fusion_scope;
+                    run(TaskThreadEnv(1,0,0));
+                }
+                if (trace_start != 0.0) trace_run(trace_start);
 #ifdef MADNESS_TASK_PROFILING
                 task_event_->stop();
 #endif // MADNESS_TASK_PROFILING
@@ -937,6 +989,7 @@ namespace madness {
 #endif // MADNESS_TASK_PROFILING
 
                 run(TaskThreadEnv(nthread, id, barrier));
+                if (trace_start != 0.0) trace_run(trace_start);
 
 #ifdef MADNESS_TASK_PROFILING
                 const bool cleanup = barrier->enter(id);
@@ -1052,7 +1105,9 @@ namespace madness {
         /// \return Description needed.
         tbb::task* execute() {
             const int nthread = get_nthread();
+            const double trace_start = profiling::Tracer::enabled() ? wall_time() : 0.0;
             run( TaskThreadEnv(nthread, 0) );
+            if (trace_start != 0.0) trace_run(trace_start);
             return nullptr;
         }
 
@@ -1125,11 +1180,68 @@ namespace madness {
 #ifdef MADNESS_TASK_PROFILING
         profiling::TaskProfiler profiler_; ///< \todo Description needed.
 #endif // MADNESS_TASK_PROFILING
+        WSDeque<PoolTaskInterface*> deque_; ///< Tasks submitted by this thread (work-stealing mode only).
+        unsigned int seed_; ///< Random state used to pick steal victims.
+        int numa_node_; ///< NUMA node this thread is assigned to.
+        std::vector<int> victims_; ///< Pool threads to steal from, same-node threads first.
+        int nlocal_victims_; ///< Number of leading entries of \c victims_ on this thread's node.
 
     public:
-        ThreadPoolThread() : Thread() { }
+        ThreadPoolThread() : Thread(), deque_(), seed_(0), numa_node_(0), nlocal_victims_(0) { }
         virtual ~ThreadPoolThread() = default;
 
+        /// NUMA node this thread is assigned to.
+
+        /// \return The node.
+        int numa_node() const {
+            return numa_node_;
+        }
+
+        /// Assign this thread to a NUMA node and set the steal order.
+
+        /// \param[in] node The node.
+        /// \param[in] victims Pool thread indices to steal from, same-node threads first.
+        /// \param[in] nlocal The number of leading same-node entries in \c victims.
+        void set_numa_placement(int node, const std::vector<int>& victims, int nlocal) {
+            numa_node_ = node;
+            victims_ = victims;
+            nlocal_victims_ = nlocal;
+        }
+
+        /// Pool threads to steal from, same-node threads first.
+
+        /// \return The victim list.
+        const std::vector<int>& victims() const {
+            return victims_;
+        }
+
+        /// Number of leading same-node entries in \c victims().
+
+        /// \return The number of local victims.
+        int nlocal_victims() const {
+            return nlocal_victims_;
+        }
+
+        /// Work-stealing deque owned by this thread.
+
+        /// \return The deque.
+        WSDeque<PoolTaskInterface*>& deque() {
+            return deque_;
+        }
+
+        /// Cheap per-thread pseudo-random number (xorshift) for victim selection.
+
+        /// \return The next random number.
+        unsigned int random() {
+            unsigned int x = seed_;
+            if (x == 0) x = 2463534242u + 977u*(get_pool_thread_index() + 2);
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            seed_ = x;
+            return x;
+        }
+
 #ifdef MADNESS_TASK_PROFILING
         /// Task profiler accessor.
 
@@ -1152,15 +1264,19 @@ namespace madness {
         // Thread pool data
         ThreadPoolThread *threads; ///< Array of threads.
         ThreadPoolThread main_thread; ///< Placeholder for main thread tls.
-        DQueue<PoolTaskInterface*> queue; ///< Queue of tasks.
+        DQueue<PoolTaskInterface*> queue; ///< Queue of tasks (the injection queue in work-stealing mode).
         int nthreads; ///< Number of threads.
         volatile bool finish; ///< Set to true when time to stop.
         AtomicInt nfinished; ///< Thread pool exit counter.
+        std::atomic<int> nsleepers; ///< Number of pool threads blocked on \c queue (work-stealing mode).
+        std::atomic<int> wakeup_pending; ///< Nonzero while a wakeup token is in \c queue (work-stealing mode).
 
         // Static data
         static ThreadPool* instance_ptr; ///< Singleton pointer.
         static const int nmax = 128; ///< Number of task a worker thread will pop from the task queue
+        static const int nspin = 64; ///< Number of steal attempts an idle worker makes before blocking
         static double await_timeout; ///< Waiter timeout.
+        static bool work_stealing; ///< Use per-thread work-stealing deques (set by \c MAD_WORK_STEALING).
 
 #if defined(HAVE_IBMBGQ) and defined(HPM)
         static unsigned int main_hpmctx; ///< HPM context for main thread.
@@ -1231,6 +1347,9 @@ namespace madness {
             MADNESS_EXCEPTION("run_tasks should not be called when using Intel TBB", 1);
 #else
 
+            if (work_stealing)
+                return run_tasks_ws(wait, this_thread);
+
             PoolTaskInterface* taskbuf[nmax];
             int ntask = queue.pop_front(nmax, taskbuf, wait);
 #ifdef MADNESS_TASK_PROFILING
@@ -1251,6 +1370,65 @@ namespace madness {
 #endif
         }
 
+#if !HAVE_INTEL_TBB
+        /// Run a single task on the calling thread and delete it when done.
+
+        /// \param[in,out] task The task to run.
+        /// \param[in,out] this_thread The calling thread (only used for profiling).
+        void run_one(PoolTaskInterface* const task, ThreadPoolThread* const this_thread) {
+#ifdef MADNESS_TASK_PROFILING
+            task->set_event(this_thread->profiler().new_list(1)->event());
+#endif // MADNESS_TASK_PROFILING
+            if (task->run_multi_threaded())
+                delete task;
+        }
+
+        /// Work-stealing version of \c run_tasks().
+
+        /// The order of preference is: the shared injection queue (which
+        /// holds high-priority, multi-threaded and externally submitted
+        /// tasks), the bottom of the caller's own deque, then the top of a
+        /// random victim's deque. If \c wait is true and nothing could be
+        /// found the thread blocks on the injection queue.
+        /// \param[in] wait Block if there is no work.
+        /// \param[in,out] this_thread The calling thread, or null.
+        /// \return True if a task was run.
+        bool run_tasks_ws(bool wait, ThreadPoolThread* const this_thread);
+
+        /// Pop and run tasks from the injection queue.
+
+        /// \param[in] wait Block if the queue is empty.
+        /// \param[in,out] this_thread The calling thread, or null.
+        /// \return True if any entries were taken from the queue.
+        bool run_injected_tasks(bool wait, ThreadPoolThread* const this_thread);
+
+        /// Attempt to steal a task from another pool thread.
+
+        /// Victims on the thief's own NUMA node are preferred; a single
+        /// attempt goes to a remote node one time in four.
+        /// \param[in,out] this_thread The calling thread, or null.
+        /// \param[in] sweep If true, try every other thread once, same-node
+        ///     threads first; otherwise try a single random victim.
+        /// \return The stolen task or null.
+        PoolTaskInterface* steal(ThreadPoolThread* const this_thread, bool sweep);
+
+        /// Push a task on the calling pool thread's deque.
+
+        /// If any thread is blocked waiting for work a wakeup token is
+        /// posted to the injection queue so that it may come and steal.
+        /// \param[in,out] thread The calling pool thread.
+        /// \param[in] task The task.
+        void push_local(ThreadPoolThread* const thread, PoolTaskInterface* const task) {
+            thread->deque().push(task);
+            // Pairs with the increment of nsleepers in run_tasks_ws ... either
+            // the sleeper sees this task or we see the sleeper.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (nsleepers.load(std::memory_order_relaxed) > 0 &&
+                    wakeup_pending.exchange(1) == 0)
+                queue.push_back(nullptr);
+        }
+#endif // !HAVE_INTEL_TBB
+
         /// \todo Brief description needed.
 
         /// \todo Description needed.
@@ -1326,6 +1504,16 @@ namespace madness {
 #else
             if (!task) MADNESS_EXCEPTION("ThreadPool: inserting a NULL task pointer", 1);
             int task_threads = task->get_nthread();
+            // In work-stealing mode ordinary tasks submitted by a pool thread
+            // stay on that thread; everything else uses the injection queue.
+            if (work_stealing && (task_threads == 1) && !task->is_high_priority()) {
+                ThreadPoolThread* const thread =
+                        static_cast<ThreadPoolThread*>(ThreadBase::this_thread());
+                if (thread && (thread->get_pool_thread_index() >= 0)) {
+                    instance()->push_local(thread, task);
+                    return;
+                }
+            }
             // Currently multithreaded tasks must be shoved on the end of the q
             // to avoid a race condition as multithreaded task is starting up
             if (task->is_high_priority() && (task_threads == 1)) {
@@ -1386,7 +1574,8 @@ namespace madness {
 #ifdef MADNESS_TASK_PROFILING
             ThreadPoolThread* const thread = static_cast<ThreadPoolThread*>(ThreadBase::this_thread());
 #else
-            ThreadPoolThread* const thread = nullptr;
+            ThreadPoolThread* const thread = (work_stealing ?
+                    static_cast<ThreadPoolThread*>(ThreadBase::this_thread()) : nullptr);
 #endif // MADNESS_TASK_PROFILING
 
             return instance()->run_tasks(false, thread);
@@ -1402,9 +1591,16 @@ namespace madness {
 
         /// Returns the number of tasks in the queue.
 
+        /// In work-stealing mode this includes the tasks in the per-thread
+        /// deques and is only approximate.
         /// \return The number of tasks in the queue.
         static std::size_t queue_size() {
-            return instance()->queue.size();
+            std::size_t n = instance()->queue.size();
+            if (work_stealing) {
+                for (int i=0; i<instance()->nthreads; ++i)
+                    n += instance()->threads[i].deque().size();
+            }
+            return n;
         }
 
         /// Returns queue statistics.
@@ -1412,6 +1608,18 @@ namespace madness {
         /// \return Queue statistics.
         static const DQStats& get_stats();
 
+        /// Returns work-stealing statistics summed over all pool threads.
+
+        /// \return Work-stealing statistics (all zero unless in work-stealing mode).
+        static WSStats get_ws_stats();
+
+        /// Test if the pool is using per-thread work-stealing deques.
+
+        /// \return True if work stealing is enabled.
+        static bool is_work_stealing() {
+            return work_stealing;
+        }
+
         /// Gracefully wait for a condition to become true, executing any tasks in the queue.
 
         /// Probe should be an object that, when called, returns the status.
@@ -1427,6 +1635,8 @@ namespace madness {
             int counter = 0;
 
             MutexWaiter waiter;
+            // Tasks batched by this thread may be what we are waiting for
+            if (TaskFusion::threshold()) TaskFusion::flush();
             while (!probe()) {
 
                 const bool working = (dowork ? ThreadPool::run_task() : false);
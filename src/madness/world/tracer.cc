@@ -0,0 +1,336 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+/**
+ \file tracer.cc
+ \brief Runtime-enabled event tracer with Chrome trace export.
+*/
+
+#include <madness/world/tracer.h>
+#include <madness/world/MADworld.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#if defined(__GLIBC__)
+#include <execinfo.h> // for backtrace_symbols
+#endif
+#if defined(__GNUC__)
+#include <cxxabi.h> // for abi::__cxa_demangle
+#endif
+
+namespace madness {
+    namespace profiling {
+
+        std::atomic<bool> Tracer::enabled_(false);
+
+        namespace {
+
+            /// Ring buffer of events owned by one thread
+            struct Buffer {
+                std::unique_ptr<TraceEvent[]> events;
+                const std::size_t capacity;
+                std::atomic<uint64_t> count; ///< Events ever recorded; only the owner writes
+                uint64_t nwritten; ///< Value of \c count at the last \c Tracer::write
+                const int index;
+                std::string name;
+                Buffer* next;
+
+                Buffer(std::size_t capacity, int index, const std::string& name)
+                    : events(new TraceEvent[capacity]), capacity(capacity), count(0), nwritten(0)
+                    , index(index), name(name), next(nullptr)
+                { }
+            };
+
+            std::atomic<Buffer*> buffers(nullptr); ///< Lock-free list of all buffers
+            std::atomic<int> nbuffer(0);
+            std::size_t capacity = std::size_t(1) << 20;
+            std::string prefix = "trace";
+            int nwrite = 0; ///< Number of calls to write
+            double origin = 0.0; ///< Time at which tracing was first enabled
+
+            thread_local Buffer* thread_buffer = nullptr;
+
+            Buffer* get_buffer() {
+                if (!thread_buffer) {
+                    std::ostringstream name;
+                    const ThreadBase* thread = ThreadBase::this_thread();
+                    if (RMI::get_this_thread_is_server())
+                        name << "rmi server";
+                    else if (thread && thread->get_pool_thread_index() >= 0)
+                        name << "pool thread " << thread->get_pool_thread_index();
+                    else if (!thread)
+                        name << "main thread";
+                    else
+                        name << "thread";
+
+                    Buffer* buf = new Buffer(capacity, nbuffer++, name.str());
+                    Buffer* head = buffers.load();
+                    do {
+                        buf->next = head;
+                    } while (!buffers.compare_exchange_weak(head, buf));
+                    thread_buffer = buf;
+                }
+                return thread_buffer;
+            }
+
+            std::string demangle(const char* symbol) {
+#if defined(__GNUC__)
+                int status = 0;
+                char* name = abi::__cxa_demangle(symbol, 0, 0, &status);
+                if (status == 0 && name) {
+                    std::string result(name);
+                    free(name);
+                    return result;
+                }
+#endif
+                return std::string(symbol);
+            }
+
+            std::string function_name(const void* fn) {
+                std::ostringstream s;
+#if defined(__GLIBC__)
+                // Symbols look like "module(mangled+0x...) [0x...]"
+                void* addr = const_cast<void*>(fn);
+                char** symbols = backtrace_symbols(&addr, 1);
+                if (symbols) {
+                    std::string sym(symbols[0]);
+                    free(symbols);
+                    const std::size_t open = sym.find('(');
+                    const std::size_t plus = sym.find('+', open);
+                    if (open != std::string::npos && plus != std::string::npos && plus > open + 1)
+                        return demangle(sym.substr(open + 1, plus - open - 1).c_str());
+                }
+#endif
+                s << fn;
+                return s.str();
+            }
+
+            /// Escapes a string for inclusion in JSON
+            std::string json_string(const std::string& str) {
+                std::string result = "\"";
+                for (std::size_t i = 0; i < str.size(); ++i) {
+                    const char c = str[i];
+                    if (c == '"' || c == '\\') {
+                        result += '\\';
+                        result += c;
+                    }
+                    else if (static_cast<unsigned char>(c) < 0x20) {
+                        result += ' ';
+                    }
+                    else {
+                        result += c;
+                    }
+                }
+                result += '"';
+                return result;
+            }
+
+            /// Caches the names of code ids, which are expensive to look up
+            class NameCache {
+                std::map<const void*, std::string> names;
+            public:
+                const std::string& operator()(const void* id, int kind) {
+                    std::map<const void*, std::string>::iterator it = names.find(id);
+                    if (it == names.end()) {
+                        std::string name;
+                        if (kind == 1 && id)
+                            name = function_name(id);
+                        else if (kind == 2 && id)
+                            name = demangle(static_cast<const char*>(id));
+                        else
+                            name = "unknown";
+                        it = names.insert(std::make_pair(id, json_string(name))).first;
+                    }
+                    return it->second;
+                }
+            };
+
+        } // namespace
+
+        void Tracer::record(TraceEventType type, const void* object, const void* id,
+                            int id_kind, int peer, std::size_t nbyte,
+                            double start, double duration)
+        {
+            Buffer* buf = get_buffer();
+            const uint64_t n = buf->count.load(std::memory_order_relaxed);
+            TraceEvent& event = buf->events[n % buf->capacity];
+            event.time = (duration > 0.0) ? start : wall_time();
+            event.duration = duration;
+            event.object = object;
+            event.id = id;
+            event.nbyte = nbyte;
+            event.peer = peer;
+            event.type = type;
+            event.id_kind = id_kind;
+            buf->count.store(n + 1, std::memory_order_release);
+        }
+
+        void Tracer::task_run(const void* task, const void* id, int id_kind, double start) {
+            if (enabled()) {
+                const double duration = wall_time() - start;
+                record(TRACE_TASK_RUN, task, id, id_kind, -1, 0, start,
+                       (duration > 0.0) ? duration : 1e-9);
+            }
+        }
+
+        void Tracer::rmi_recv(int src, std::size_t nbyte, const void* handler, double start) {
+            if (enabled()) {
+                const double duration = wall_time() - start;
+                record(TRACE_RMI_RECV, nullptr, handler, 1, src, nbyte, start,
+                       (duration > 0.0) ? duration : 1e-9);
+            }
+        }
+
+        void Tracer::fence(double start) {
+            if (enabled()) {
+                const double duration = wall_time() - start;
+                record(TRACE_FENCE, nullptr, nullptr, 0, -1, 0, start,
+                       (duration > 0.0) ? duration : 1e-9);
+            }
+        }
+
+        void Tracer::enable(const char* file_prefix) {
+            if (file_prefix && *file_prefix) prefix = file_prefix;
+            if (origin == 0.0) origin = wall_time();
+            enabled_.store(true);
+        }
+
+        void Tracer::disable() {
+            enabled_.store(false);
+        }
+
+        void Tracer::begin() {
+            const char* mad_trace_events = getenv("MAD_TRACE_EVENTS");
+            if (mad_trace_events) {
+                const long n = atol(mad_trace_events);
+                if (n > 0) capacity = n;
+            }
+            const char* mad_trace = getenv("MAD_TRACE");
+            if (mad_trace) enable(mad_trace);
+        }
+
+        void Tracer::write(World& world) {
+            const bool was_enabled = enabled();
+            disable();
+
+            // Put all processes on the clock of rank 0, starting when rank 0
+            // first enabled tracing. The residual error is about the latency
+            // of the broadcast.
+            world.gop.barrier();
+            double t[2] = { wall_time(), origin };
+            world.gop.broadcast(t, 2, 0);
+            const double shift = (t[0] - wall_time()) - t[1];
+
+            const int rank = world.rank();
+            std::ostringstream filename;
+            filename << prefix << "." << rank;
+            if (nwrite) filename << "." << nwrite;
+            filename << ".json";
+            ++nwrite;
+
+            FILE* file = fopen(filename.str().c_str(), "w");
+            if (!file) {
+                print("Tracer: could not open", filename.str());
+                if (was_enabled) enable();
+                return;
+            }
+
+            NameCache name;
+            fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+            fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                    "\"args\":{\"name\":\"rank %d\"}}", rank, rank);
+            for (Buffer* buf = buffers.load(); buf; buf = buf->next) {
+                const int tid = buf->index;
+                fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                        "\"args\":{\"name\":%s}}", rank, tid, json_string(buf->name).c_str());
+
+                const uint64_t count = buf->count.load(std::memory_order_acquire);
+                uint64_t first = (count > buf->capacity) ? count - buf->capacity : 0;
+                if (first < buf->nwritten) first = buf->nwritten;
+                for (uint64_t n = first; n < count; ++n) {
+                    const TraceEvent& e = buf->events[n % buf->capacity];
+                    const double ts = 1e6*(e.time + shift);
+                    const double dur = 1e6*e.duration;
+                    switch (e.type) {
+                    case TRACE_TASK_SUBMIT:
+                        // Flow arrows link submission, readiness and execution
+                        fprintf(file, ",\n{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"s\",\"id\":\"%p\","
+                                "\"pid\":%d,\"tid\":%d,\"ts\":%.3f}", e.object, rank, tid, ts);
+                        fprintf(file, ",\n{\"name\":\"submit\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\","
+                                "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"task\":\"%p\"}}",
+                                rank, tid, ts, e.object);
+                        break;
+                    case TRACE_TASK_READY:
+                        fprintf(file, ",\n{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"t\",\"id\":\"%p\","
+                                "\"pid\":%d,\"tid\":%d,\"ts\":%.3f}", e.object, rank, tid, ts);
+                        fprintf(file, ",\n{\"name\":\"ready\",\"cat\":\"task\",\"ph\":\"i\",\"s\":\"t\","
+                                "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"task\":\"%p\"}}",
+                                rank, tid, ts, e.object);
+                        break;
+                    case TRACE_TASK_RUN:
+                        fprintf(file, ",\n{\"name\":%s,\"cat\":\"task\",\"ph\":\"X\","
+                                "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"task\":\"%p\"}}",
+                                name(e.id, e.id_kind).c_str(), rank, tid, ts, dur, e.object);
+                        fprintf(file, ",\n{\"name\":\"task\",\"cat\":\"task\",\"ph\":\"f\",\"bp\":\"e\","
+                                "\"id\":\"%p\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f}", e.object, rank, tid, ts);
+                        break;
+                    case TRACE_RMI_SEND:
+                        fprintf(file, ",\n{\"name\":\"send\",\"cat\":\"rmi\",\"ph\":\"i\",\"s\":\"t\","
+                                "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"args\":{\"dest\":%d,\"nbyte\":%lu,"
+                                "\"handler\":%s}}", rank, tid, ts, int(e.peer), (unsigned long) e.nbyte,
+                                name(e.id, e.id_kind).c_str());
+                        break;
+                    case TRACE_RMI_RECV:
+                        fprintf(file, ",\n{\"name\":%s,\"cat\":\"rmi\",\"ph\":\"X\","
+                                "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"src\":%d,"
+                                "\"nbyte\":%lu}}", name(e.id, e.id_kind).c_str(), rank, tid, ts, dur,
+                                int(e.peer), (unsigned long) e.nbyte);
+                        break;
+                    case TRACE_FENCE:
+                        fprintf(file, ",\n{\"name\":\"fence\",\"cat\":\"gop\",\"ph\":\"X\","
+                                "\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", rank, tid, ts, dur);
+                        break;
+                    }
+                }
+                buf->nwritten = count;
+            }
+            fprintf(file, "\n]}\n");
+            fclose(file);
+
+            if (was_enabled) enable();
+        }
+
+    } // namespace profiling
+} // namespace madness
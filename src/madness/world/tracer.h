@@ -0,0 +1,149 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_TRACER_H__INCLUDED
+#define MADNESS_WORLD_TRACER_H__INCLUDED
+
+/**
+ \file tracer.h
+ \brief Runtime-enabled event tracer with Chrome trace export.
+*/
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+
+namespace madness {
+
+    class World;
+
+    namespace profiling {
+
+        /// Kinds of event recorded by the \c Tracer
+        enum TraceEventType {
+            TRACE_TASK_SUBMIT,  ///< Task handed to the task queue
+            TRACE_TASK_READY,   ///< Last dependency of a task satisfied
+            TRACE_TASK_RUN,     ///< Task executed (has a duration)
+            TRACE_RMI_SEND,     ///< Active message sent
+            TRACE_RMI_RECV,     ///< Active message handler executed (has a duration)
+            TRACE_FENCE         ///< Global fence (has a duration)
+        };
+
+        /// One traced event; 48 bytes
+        struct TraceEvent {
+            double time;        ///< Start time (wall_time)
+            double duration;    ///< Duration in seconds, or 0 for instant events
+            const void* object; ///< Task or other object the event refers to
+            const void* id;     ///< Function pointer or type name identifying the code
+            uint64_t nbyte;     ///< Message size for RMI events
+            int32_t peer;       ///< Remote process for RMI events
+            uint16_t type;      ///< A \c TraceEventType
+            uint16_t id_kind;   ///< 0 = no id, 1 = function pointer, 2 = \c typeid name
+        };
+
+        /// Low-overhead, always compiled event tracer
+
+        /// Unlike \c TaskProfiler, which needs `MADNESS_TASK_PROFILING` at
+        /// compile time, the tracer is always built in and costs one relaxed
+        /// load and branch per hook while disabled. Set the environment
+        /// variable `MAD_TRACE=<prefix>` (or call \c enable()) to record:
+        /// task submission, dependency satisfaction, task execution, RMI
+        /// sends and handler executions, and global fences.
+        ///
+        /// Each thread appends to its own fixed-size ring buffer, so
+        /// recording takes no locks and no allocation; when a buffer fills,
+        /// the oldest events are overwritten. The capacity per thread is
+        /// `MAD_TRACE_EVENTS` (default 1M events, 48 MB).
+        ///
+        /// \c write(World&) (called by \c finalize when tracing is enabled)
+        /// writes `<prefix>.<rank>.json` in Chrome trace / Perfetto JSON,
+        /// with timestamps shifted to the clock of rank 0. The per-rank
+        /// files are combined with `bin/mad_trace_merge.py`.
+        class Tracer {
+        private:
+            static std::atomic<bool> enabled_;
+
+            static void record(TraceEventType type, const void* object, const void* id,
+                               int id_kind, int peer, std::size_t nbyte,
+                               double start, double duration);
+
+        public:
+            /// Returns true if events are being recorded
+            static bool enabled() {
+                return enabled_.load(std::memory_order_relaxed);
+            }
+
+            /// Starts recording
+
+            /// \param[in] prefix Output file prefix; null keeps the current one.
+            static void enable(const char* prefix = nullptr);
+
+            /// Stops recording; recorded events are kept until written
+            static void disable();
+
+            /// Reads `MAD_TRACE` and `MAD_TRACE_EVENTS` (called by \c initialize)
+            static void begin();
+
+            /// Writes this process's events as Chrome trace JSON (collective)
+
+            /// Events are cleared after writing, so this may be called more
+            /// than once; later calls append a sequence number to the name.
+            static void write(World& world);
+
+            /// Records that \c task was handed to the task queue
+            static void task_submit(const void* task) {
+                if (enabled()) record(TRACE_TASK_SUBMIT, task, nullptr, 0, -1, 0, 0.0, 0.0);
+            }
+
+            /// Records that the last dependency of \c task was satisfied
+            static void task_ready(const void* task) {
+                if (enabled()) record(TRACE_TASK_READY, task, nullptr, 0, -1, 0, 0.0, 0.0);
+            }
+
+            /// Records the execution of a task that started at \c start
+            static void task_run(const void* task, const void* id, int id_kind, double start);
+
+            /// Records an active message sent to \c dest
+            static void rmi_send(int dest, std::size_t nbyte, const void* handler) {
+                if (enabled()) record(TRACE_RMI_SEND, nullptr, handler, 1, dest, nbyte, 0.0, 0.0);
+            }
+
+            /// Records the execution of a handler for a message from \c src that started at \c start
+            static void rmi_recv(int src, std::size_t nbyte, const void* handler, double start);
+
+            /// Records a global fence that started at \c start
+            static void fence(double start);
+        };
+
+    } // namespace profiling
+} // namespace madness
+
+#endif // MADNESS_WORLD_TRACER_H__INCLUDED
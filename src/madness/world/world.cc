@@ -190,6 +190,7 @@ namespace madness {
         detail::WorldMpi::initialize(argc, argv, MADNESS_MPI_THREAD_LEVEL);
         start_cpu_time = cpu_time();
         start_wall_time = wall_time();
+        profiling::Tracer::begin();
         ThreadPool::begin();        // Must have thread pool before any AM arrives
         if(SafeMPI::COMM_WORLD.Get_size() > 1) {
             RMI::begin();           // Must have RMI while still running single threaded
@@ -219,6 +220,8 @@ namespace madness {
 
     void finalize() {
         World::default_world->gop.fence();
+        if (profiling::Tracer::enabled())
+            profiling::Tracer::write(*World::default_world);
 
         // Destroy the default world
         delete World::default_world;
@@ -242,6 +245,7 @@ namespace madness {
         double total_cpu_time = cpu_time()-start_cpu_time;
         RMIStats rmi = RMI::get_stats();
         DQStats q = ThreadPool::get_stats();
+        WSStats ws = ThreadPool::get_ws_stats();
 #ifdef HAVE_PAPI
         // For papi ... this only make sense if done once after all
         // other worker threads have exited
@@ -285,35 +289,78 @@ namespace madness {
         double npush_back = q.npush_back;
         double npush_front = q.npush_front;
         double npop_front = q.npop_front;
-        double ntask = q.npush_back + q.npush_front;
+        double ntask = q.npush_back + q.npush_front + ws.npush;
         double nmax = q.nmax;
+        double nsteal = ws.nsteal;
+        double nsteal_remote = ws.nsteal_remote;
         world.gop.sum(npush_back);
         world.gop.sum(npush_front);
         world.gop.sum(npop_front);
         world.gop.sum(ntask);
         world.gop.sum(nmax);
+        world.gop.sum(nsteal);
+        world.gop.sum(nsteal_remote);
 
         double max_npush_back = q.npush_back;
         double max_npush_front = q.npush_front;
         double max_npop_front = q.npop_front;
-        double max_ntask = q.npush_back + q.npush_front;
+        double max_ntask = q.npush_back + q.npush_front + ws.npush;
         double max_nmax = q.nmax;
+        double max_nsteal = ws.nsteal;
+        double max_nsteal_remote = ws.nsteal_remote;
         world.gop.max(max_npush_back);
         world.gop.max(max_npush_front);
         world.gop.max(max_npop_front);
         world.gop.max(max_ntask);
         world.gop.max(max_nmax);
+        world.gop.max(max_nsteal);
+        world.gop.max(max_nsteal_remote);
 
         double min_npush_back = q.npush_back;
         double min_npush_front = q.npush_front;
         double min_npop_front = q.npop_front;
-        double min_ntask = q.npush_back + q.npush_front;
+        double min_ntask = q.npush_back + q.npush_front + ws.npush;
         double min_nmax = q.nmax;
+        double min_nsteal = ws.nsteal;
+        double min_nsteal_remote = ws.nsteal_remote;
         world.gop.min(min_npush_back);
         world.gop.min(min_npush_front);
         world.gop.min(min_npop_front);
         world.gop.min(min_ntask);
         world.gop.min(min_nmax);
+        world.gop.min(min_nsteal);
+        world.gop.min(min_nsteal_remote);
+
+        const bool rmi_batching = (world.size() > 1) && (RMI::batch_size() > 0);
+        double nbatch_sent = rmi.nbatch_sent;
+        double nmsg_batched = rmi.nmsg_batched;
+        double max_msg_per_batch = rmi.max_msg_per_batch;
+        double nflush[4] = {double(rmi.nflush_size), double(rmi.nflush_timeout),
+                            double(rmi.nflush_fence), double(rmi.nflush_order)};
+        if (rmi_batching) {
+            world.gop.sum(nbatch_sent);
+            world.gop.sum(nmsg_batched);
+            world.gop.max(max_msg_per_batch);
+            world.gop.sum(nflush, 4);
+        }
+
+        const PoolMemStats pool = PoolMem::get_stats();
+        double pool_nalloc = pool.nalloc;
+        double pool_nhit = pool.nhit;
+        double pool_nfree_remote = pool.nfree_remote;
+        double pool_cached = pool.cached_bytes;
+        if (PoolMem::enabled()) {
+            world.gop.sum(pool_nalloc);
+            world.gop.sum(pool_nhit);
+            world.gop.sum(pool_nfree_remote);
+            world.gop.max(pool_cached);
+        }
+
+        const bool task_fusion = (TaskFusion::threshold() != 0);
+        const TaskFusionStats fusion = TaskFusion::get_stats();
+        double fusion_counts[4] = {double(fusion.ninline), double(fusion.nfused),
+                                   double(fusion.nbatch), double(fusion.nqueued)};
+        if (task_fusion) world.gop.sum(fusion_counts, 4);
 
 #ifdef HAVE_PAPI
         double val[NUMEVENTS], max_val[NUMEVENTS], min_val[NUMEVENTS];
@@ -355,6 +402,17 @@ namespace madness {
             printf("        #msgs systemwide    %.2e\n", nmsg_sent);
             printf("       #bytes systemwide    %.2e\n", nbyte_sent);
             printf("\n");
+            if (rmi_batching) {
+                printf("  RMI batching statistics (systemwide)\n");
+                printf("  -----------------------\n");
+                printf("          #batches sent    %.2e\n", nbatch_sent);
+                printf("   #messages in batches    %.2e\n", nmsg_batched);
+                printf("   avg / max msgs/batch    %.2e / %.2e\n",
+                       (nbatch_sent > 0.0) ? nmsg_batched/nbatch_sent : 0.0, max_msg_per_batch);
+                printf("  flushes size / timeout    %.2e / %.2e\n", nflush[0], nflush[1]);
+                printf("  flushes fence / order    %.2e / %.2e\n", nflush[2], nflush[3]);
+                printf("\n");
+            }
             printf("  Thread pool statistics (min / avg / max)\n");
             printf("  ----------------------\n");
             printf("         #tasks per node    %.2e / %.2e / %.2e\n",
@@ -363,7 +421,33 @@ namespace madness {
                    min_nmax, nmax/world.size(), max_nmax);
             printf("  #hi-pri tasks per node    %.2e / %.2e / %.2e\n",
                    min_npush_front, npush_front/world.size(), max_npush_front);
+            if (ThreadPool::is_work_stealing())
+                printf("  #stolen tasks per node    %.2e / %.2e / %.2e\n",
+                       min_nsteal, nsteal/world.size(), max_nsteal);
+            if (ThreadPool::is_work_stealing() && NUMATopology::nnodes() > 1)
+                printf(" #x-socket steals per node   %.2e / %.2e / %.2e\n",
+                       min_nsteal_remote, nsteal_remote/world.size(), max_nsteal_remote);
             printf("\n");
+            if (PoolMem::enabled()) {
+                printf("  Tensor pool statistics (systemwide)\n");
+                printf("  ----------------------\n");
+                printf("        #allocations    %.2e\n", pool_nalloc);
+                printf("           #pool hits    %.2e (%.1f%%)\n", pool_nhit,
+                       (pool_nalloc > 0.0) ? 100.0*pool_nhit/pool_nalloc : 0.0);
+                printf("  #cross-thread frees    %.2e\n", pool_nfree_remote);
+                printf(" max cached bytes/node   %.2e\n", pool_cached);
+                printf("\n");
+            }
+            if (task_fusion) {
+                printf("  Task fusion statistics (systemwide)\n");
+                printf("  ----------------------\n");
+                printf("       #tasks run inline    %.2e\n", fusion_counts[0]);
+                printf("   #tasks run in batches    %.2e\n", fusion_counts[1]);
+                printf("     #batches / avg size    %.2e / %.2e\n", fusion_counts[2],
+                       (fusion_counts[2] > 0.0) ? fusion_counts[1]/fusion_counts[2] : 0.0);
+                printf("   #tiny tasks queued       %.2e\n", fusion_counts[3]);
+                printf("\n");
+            }
 #ifdef HAVE_PAPI
             printf("         PAPI statistics (min / avg / max)\n");
             printf("         ---------------\n");
@@ -444,14 +444,22 @@ namespace madness {
         /// Once the task is complete it will execute
         /// \c task_complete_callback to decrement the number of pending
         /// tasks and be deleted.
+        ///
+        /// A ready task with a small cost hint may instead be run inline
+        /// or fused with its siblings (see \c TaskFusion).
         /// \param[in] t Pointer to the task.
         void add(TaskInterface* t)  {
             nregistered++;
 
             t->set_info(&world, this);       // Stuff info
+            profiling::Tracer::task_submit(static_cast<PoolTaskInterface*>(t));
 
             if (t->ndep() == 0) {
-                ThreadPool::add(t); // If no dependencies directly submit
+                // If no dependencies directly submit, or inline/fuse if tiny
+                if (TaskFusion::candidate(t->get_cost(), t->get_nthread()))
+                    TaskFusion::submit(t, true);
+                else
+                    ThreadPool::add(t);
             } else {
                 // With dependencies must use the callback to avoid race condition
                 t->register_submit_callback();
@@ -41,9 +41,10 @@
 */
 
 #include <madness/world/parallel_archive.h>
-#include <madness/world/worldhashmap.h>
+#include <madness/world/lockfreehashmap.h>
 #include <madness/world/mpi_archive.h>
 #include <madness/world/world_object.h>
+#include <cstdint>
 #include <set>
 
 namespace madness {
@@ -344,7 +345,7 @@ namespace madness {
         typedef const pairT const_pairT;
         typedef WorldContainerImpl<keyT,valueT,hashfunT> implT;
 
-        typedef ConcurrentHashMap< keyT,valueT,hashfunT > internal_containerT;
+        typedef ContainerHashMap< keyT,valueT,hashfunT > internal_containerT;
 
 	//typedef WorldObject< WorldContainerImpl<keyT, valueT, hashfunT> > worldobjT;
 
@@ -1533,11 +1534,14 @@ namespace madness {
         /// \ingroup worlddc
         /// Each node (process) is served by a designated IO node.
         /// The IO node has a binary local file archive to which is
-        /// first written a cookie and the number of servers.  The IO
-        /// node then loops thru all of its clients and in turn tells
-        /// each to write its data over an MPI stream, which is copied
-        /// directly to the output file.  The stream contents are then
-        /// cookie, no. of clients, foreach client (usual sequential archive).
+        /// first written a cookie and the offsets of the index and of
+        /// the end of the data of this container.  The IO node then
+        /// writes its own entries and loops thru all of its clients,
+        /// telling each in turn to send its data over an MPI stream,
+        /// whose entries are copied one by one to the output file.
+        /// Finally the index, i.e. the key and the offset of each entry,
+        /// is written and the offsets at the start are filled in.  With
+        /// the index any number of readers can find the entries they own.
         ///
         /// If ar.dofence() is true (default) fence is invoked before and
         /// after the IO. The fence is optional but it is of course
@@ -1548,9 +1552,9 @@ namespace madness {
         template <class keyT, class valueT>
         struct ArchiveStoreImpl< ParallelOutputArchive, WorldContainer<keyT,valueT> > {
             static void store(const ParallelOutputArchive& ar, const WorldContainer<keyT,valueT>& t) {
-                const long magic = -5881828; // Sitar Indian restaurant in Knoxville (negative to indicate parallel!)
+                const long magic = -5881829; // one more than the old unindexed format
                 typedef WorldContainer<keyT,valueT> dcT;
-                // typedef typename dcT::const_iterator iterator; // unused?
+                typedef typename dcT::const_iterator iterator;
                 typedef typename dcT::pairT pairT;
                 World* world = ar.get_world();
                 Tag tag = world->mpi.unique_tag();
@@ -1558,10 +1562,20 @@ namespace madness {
                 if (ar.dofence()) world->gop.fence();
                 if (ar.is_io_node()) {
                     BinaryFstreamOutputArchive& localar = ar.local_archive();
-                    localar & magic & ar.num_io_clients();
+                    localar & magic;
+                    const std::uint64_t header = localar.tell();
+                    std::uint64_t index_offset = 0, end_offset = 0;
+                    localar & index_offset & end_offset;
+
+                    std::vector<keyT> keys;
+                    std::vector<std::uint64_t> offsets;
                     for (ProcessID p=0; p<world->size(); ++p) {
                         if (p == me) {
-                            localar & t;
+                            for (iterator it=t.begin(); it!=t.end(); ++it) {
+                                keys.push_back(it->first);
+                                offsets.push_back(localar.tell());
+                                localar & *it;
+                            }
                         }
                         else if (ar.io_node(p) == me) {
                             world->mpi.Send(int(1),p,tag); // Tell client to start sending
@@ -1569,19 +1583,23 @@ namespace madness {
                             long cookie = 0l;
                             unsigned long count = 0ul;
 
-                            ArchivePrePostImpl<BinaryFstreamOutputArchive,dcT>::preamble_store(localar);
-
                             source & cookie & count;
-                            localar & cookie & count;
                             while (count--) {
                                 pairT datum;
                                 source & datum;
+                                keys.push_back(datum.first);
+                                offsets.push_back(localar.tell());
                                 localar & datum;
                             }
-
-                            ArchivePrePostImpl<BinaryFstreamOutputArchive,dcT>::postamble_store(localar);
                         }
                     }
+
+                    index_offset = localar.tell();
+                    localar & keys & offsets;
+                    end_offset = localar.tell();
+                    localar.seek(header);
+                    localar & index_offset & end_offset;
+                    localar.seek(end_offset);
                 }
                 else {
                     ProcessID p = ar.my_io_node();
@@ -1597,30 +1615,70 @@ namespace madness {
 
         template <class keyT, class valueT>
         struct ArchiveLoadImpl< ParallelInputArchive, WorldContainer<keyT,valueT> > {
+            typedef WorldContainer<keyT,valueT> dcT;
+            typedef typename dcT::pairT pairT;
+
+            /// Load the entries at the given offsets of a file and insert them locally
+            static void load_entries(dcT t, const std::string& filename, const std::vector<std::uint64_t>& offsets) {
+                BinaryFstreamInputArchive in(filename.c_str());
+                for (std::size_t i=0; i<offsets.size(); ++i) {
+                    in.seek(offsets[i]);
+                    pairT datum;
+                    in & datum;
+                    t.replace(datum);
+                }
+                in.close();
+            }
+
             /// Read container from parallel archive
 
             /// \ingroup worlddc
             /// See store method above for format of file content.
-            /// !!! We presently ASSUME that the number of writers and readers are
-            /// the same.  This is frustrating but not a show stopper since you
-            /// can always run a separate job to copy to a different number.
+            /// Each file is read sequentially by one process (see
+            /// BaseParallelArchive::file_reader), which reads the index
+            /// and sends to each owner of entries under the pmap of \c t
+            /// the offsets of its entries.  The owners then read their
+            /// entries directly from the file and insert them locally, so
+            /// the number of readers need not be that of the writers.
             ///
-            /// The IO node simply reads all data and inserts entries.
-            static void load(const ParallelInputArchive& ar, WorldContainer<keyT,valueT>& t) {
+            /// Archives written in the former format without an index
+            /// are also read; there the reader of a file inserts all of
+            /// its entries.
+            static void load(const ParallelInputArchive& ar, dcT& t) {
                 const long magic = -5881828; // Sitar Indian restaurant in Knoxville (negative to indicate parallel!)
-                // typedef WorldContainer<keyT,valueT> dcT; // unused
-                // typedef typename dcT::iterator iterator; // unused
-                // typedef typename dcT::pairT pairT; // unused
+                const long indexed_magic = -5881829;
                 World* world = ar.get_world();
                 if (ar.dofence()) world->gop.fence();
-                if (ar.is_io_node()) {
+                for (int ifile=world->rank(); ifile<ar.num_files(); ifile+=world->size()) {
                     long cookie = 0l;
-                    int nclient = 0;
-                    BinaryFstreamInputArchive& localar = ar.local_archive();
-                    localar & cookie & nclient;
-                    MADNESS_ASSERT(cookie == magic);
-                    while (nclient--) {
-                        localar & t;
+                    BinaryFstreamInputArchive& localar = ar.file_archive(ifile);
+                    localar & cookie;
+                    if (cookie == indexed_magic) {
+                        std::uint64_t index_offset = 0, end_offset = 0;
+                        localar & index_offset & end_offset;
+                        std::vector<keyT> keys;
+                        std::vector<std::uint64_t> offsets;
+                        localar.seek(index_offset);
+                        localar & keys & offsets;
+                        localar.seek(end_offset);
+                        MADNESS_ASSERT(keys.size() == offsets.size());
+
+                        std::vector< std::vector<std::uint64_t> > owned(world->size());
+                        for (std::size_t i=0; i<keys.size(); ++i) owned[t.owner(keys[i])].push_back(offsets[i]);
+                        const std::string filename = ar.file_name(ifile);
+                        for (ProcessID p=0; p<world->size(); ++p) {
+                            if (owned[p].empty()) continue;
+                            if (p == world->rank()) load_entries(t, filename, owned[p]);
+                            else world->taskq.add(p, &load_entries, t, filename, owned[p]);
+                        }
+                    }
+                    else {
+                        MADNESS_ASSERT(cookie == magic);
+                        int nclient = 0;
+                        localar & nclient;
+                        while (nclient--) {
+                            localar & t;
+                        }
                     }
                 }
                 if (ar.dofence()) world->gop.fence();
@@ -31,11 +31,131 @@
 
 #include <madness/world/worldgop.h>
 #include <madness/world/MADworld.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <unistd.h>
 #ifdef MADNESS_HAS_GOOGLE_PERF_MINIMAL
 #include <gperftools/malloc_extension.h>
 #endif
 namespace madness {
 
+    void WorldGopInterface::configure_tree() {
+        const char* mad_gop_tree = getenv("MAD_GOP_TREE");
+        if (mad_gop_tree) {
+            if (strcmp(mad_gop_tree, "hierarchical") == 0)
+                hierarchical_ = true;
+            else if (strcmp(mad_gop_tree, "binary") != 0 && world_.rank() == 0)
+                std::cerr << "!!! WARNING: MAD_GOP_TREE must be binary or hierarchical; using binary.\n";
+        }
+
+        const char* mad_gop_segment = getenv("MAD_GOP_SEGMENT");
+        if (mad_gop_segment) {
+            std::stringstream ss(mad_gop_segment);
+            double nbyte = 0.0;
+            if (ss >> nbyte) {
+                std::string unit;
+                if (ss >> unit) {
+                    if (unit == "KB" || unit == "kB") nbyte *= 1024.0;
+                    else if (unit == "MB") nbyte *= 1048576.0;
+                }
+                if (nbyte >= 1.0) segment_bytes_ = std::size_t(nbyte);
+            }
+        }
+    }
+
+    void WorldGopInterface::discover_topology() {
+        const int np = world_.size();
+        const ProcessID me = world_.rank();
+
+        // All-gather a node id per process by summing contributions
+        std::vector<uint64_t> id(np, 0);
+        int ranks_per_node = 0;
+        const char* mad_ranks_per_node = getenv("MAD_RANKS_PER_NODE");
+        if (mad_ranks_per_node) ranks_per_node = atoi(mad_ranks_per_node);
+        if (ranks_per_node > 0) {
+            id[me] = me/ranks_per_node;
+        }
+        else {
+            char host[256];
+            if (gethostname(host, sizeof(host))) host[0] = 0;
+            host[sizeof(host)-1] = 0;
+            uint64_t h = 14695981039346656037ull; // FNV-1a
+            for (const char* c = host; *c; ++c) {
+                h ^= uint64_t(static_cast<unsigned char>(*c));
+                h *= 1099511628211ull;
+            }
+            id[me] = h;
+        }
+
+        const bool hierarchical = hierarchical_;
+        hierarchical_ = false; // Discovery itself uses the binary tree
+        sum(id.data(), np);
+        hierarchical_ = hierarchical;
+
+        // Nodes are numbered in order of their lowest rank
+        std::map<uint64_t,int> node_index;
+        node_of_.resize(np);
+        nodes_.clear();
+        for (ProcessID p=0; p<np; ++p) {
+            auto it = node_index.find(id[p]);
+            if (it == node_index.end()) {
+                it = node_index.insert(std::make_pair(id[p], int(nodes_.size()))).first;
+                nodes_.push_back(std::vector<ProcessID>());
+            }
+            node_of_[p] = it->second;
+            nodes_[it->second].push_back(p);
+        }
+        topology_known_ = true;
+
+        if (debug_ && me == 0)
+            print("gop: hierarchical tree over", nodes_.size(), "nodes");
+    }
+
+    void WorldGopInterface::tree_info(ProcessID root, ProcessID& parent, std::vector<ProcessID>& children) {
+        children.clear();
+        if (!hierarchical_) {
+            ProcessID child0, child1;
+            world_.mpi.binary_tree_info(root, parent, child0, child1);
+            if (child0 != -1) children.push_back(child0);
+            if (child1 != -1) children.push_back(child1);
+            return;
+        }
+
+        if (!topology_known_) discover_topology();
+
+        const ProcessID me = world_.rank();
+        const int nnode = nodes_.size();
+        const int rootnode = node_of_[root];
+        const int mynode = node_of_[me];
+
+        // Each node's subtree hangs from its lowest rank, except that the
+        // root heads the subtree of its own node
+        auto leader = [&](int node) { return (node == rootnode) ? root : nodes_[node][0]; };
+
+        // Binary tree within the node, renumbered so the leader is 0
+        const std::vector<ProcessID>& local = nodes_[mynode];
+        const int nlocal = local.size();
+        const ProcessID myleader = leader(mynode);
+        const int ime = std::find(local.begin(), local.end(), me) - local.begin();
+        const int ileader = std::find(local.begin(), local.end(), myleader) - local.begin();
+        const int pos = (ime - ileader + nlocal) % nlocal;
+        parent = (pos == 0) ? -1 : local[((pos - 1)/2 + ileader) % nlocal];
+
+        // Leaders form a binary tree across nodes, renumbered so the root's node is 0;
+        // remote children are listed first since they take longest
+        if (me == myleader) {
+            const int inode = (mynode - rootnode + nnode) % nnode;
+            if (inode) parent = leader(((inode - 1)/2 + rootnode) % nnode);
+            for (int c = 2*inode + 1; c <= 2*inode + 2 && c < nnode; ++c)
+                children.push_back(leader((c + rootnode) % nnode));
+        }
+        for (int c = 2*pos + 1; c <= 2*pos + 2 && c < nlocal; ++c)
+            children.push_back(local[(c + ileader) % nlocal]);
+    }
+
 
     /// Synchronizes all processes in communicator AND globally ensures no pending AM or tasks
 
@@ -48,10 +168,14 @@ namespace madness {
     /// flight.
     void WorldGopInterface::fence() {
         PROFILE_MEMBER_FUNC(WorldGopInterface);
+        const double trace_start = profiling::Tracer::enabled() ? wall_time() : 0.0;
         unsigned long nsent_prev=0, nrecv_prev=1; // invalid initial condition
-        SafeMPI::Request req0, req1;
-        ProcessID parent, child0, child1;
-        world_.mpi.binary_tree_info(0, parent, child0, child1);
+        ProcessID parent;
+        std::vector<ProcessID> children;
+        tree_info(0, parent, children);
+        const std::size_t nchild = children.size();
+        std::vector<SafeMPI::Request> req(nchild);
+        SafeMPI::Request req0;
         Tag gfence_tag = world_.mpi.unique_tag();
         Tag bcast_tag = world_.mpi.unique_tag();
         int npass = 0;
@@ -59,12 +183,12 @@ namespace madness {
         //double start = wall_time();
 
         while (1) {
-            uint64_t sum0[2]={0,0}, sum1[2]={0,0}, sum[2];
-            if (child0 != -1) req0 = world_.mpi.Irecv((void*) &sum0, sizeof(sum0), MPI_BYTE, child0, gfence_tag);
-            if (child1 != -1) req1 = world_.mpi.Irecv((void*) &sum1, sizeof(sum1), MPI_BYTE, child1, gfence_tag);
+            std::vector<uint64_t> sumc(2*nchild, 0);
+            uint64_t sum[2];
+            for (std::size_t c=0; c<nchild; ++c)
+                req[c] = world_.mpi.Irecv((void*) &sumc[2*c], 2*sizeof(uint64_t), MPI_BYTE, children[c], gfence_tag);
             world_.taskq.fence();
-            if (child0 != -1) World::await(req0);
-            if (child1 != -1) World::await(req1);
+            for (std::size_t c=0; c<nchild; ++c) World::await(req[c]);
 
             bool finished;
             uint64_t ntask1, nsent1, nrecv1, ntask2, nsent2, nrecv2;
@@ -92,8 +216,16 @@ namespace madness {
             }
             while (!finished);
 
-            sum[0] = sum0[0] + sum1[0] + nsent2; // Must use values read above
-            sum[1] = sum0[1] + sum1[1] + nrecv2;
+            // Small messages held for aggregation are already counted in
+            // nsent so must be sent before the counts can ever balance
+            RMI::flush();
+
+            sum[0] = nsent2; // Must use values read above
+            sum[1] = nrecv2;
+            for (std::size_t c=0; c<nchild; ++c) {
+                sum[0] += sumc[2*c];
+                sum[1] += sumc[2*c+1];
+            }
 
             if (parent != -1) {
                 req0 = world_.mpi.Isend(&sum, sizeof(sum), MPI_BYTE, parent, gfence_tag);
@@ -130,6 +262,7 @@ namespace madness {
         };
         world_.am.free_managed_buffers(); // free up communication buffers
         deferred_->do_cleanup();
+        if (trace_start != 0.0) profiling::Tracer::fence(trace_start);
 #ifdef MADNESS_HAS_GOOGLE_PERF_MINIMAL
         MallocExtension::instance()->ReleaseFreeMemory();
 //        print("clearing memory");
@@ -141,24 +274,24 @@ namespace madness {
 
     /// Optimizations can be added for long messages
     void WorldGopInterface::broadcast(void* buf, size_t nbyte, ProcessID root, bool dowork, Tag bcast_tag) {
-        SafeMPI::Request req0, req1;
-        ProcessID parent, child0, child1;
-        world_.mpi.binary_tree_info(root, parent, child0, child1);
+        ProcessID parent;
+        std::vector<ProcessID> children;
+        tree_info(root, parent, children);
         if(bcast_tag < 0)
             bcast_tag = world_.mpi.unique_tag();
 
         //print("BCAST TAG", bcast_tag);
 
         if (parent != -1) {
-            req0 = world_.mpi.Irecv(buf, nbyte, MPI_BYTE, parent, bcast_tag);
+            SafeMPI::Request req0 = world_.mpi.Irecv(buf, nbyte, MPI_BYTE, parent, bcast_tag);
             World::await(req0, dowork);
         }
 
-        if (child0 != -1) req0 = world_.mpi.Isend(buf, nbyte, MPI_BYTE, child0, bcast_tag);
-        if (child1 != -1) req1 = world_.mpi.Isend(buf, nbyte, MPI_BYTE, child1, bcast_tag);
-
-        if (child0 != -1) World::await(req0, dowork);
-        if (child1 != -1) World::await(req1, dowork);
+        std::vector<SafeMPI::Request> req(children.size());
+        for (std::size_t c=0; c<children.size(); ++c)
+            req[c] = world_.mpi.Isend(buf, nbyte, MPI_BYTE, children[c], bcast_tag);
+        for (std::size_t c=0; c<children.size(); ++c)
+            World::await(req[c], dowork);
     }
 
 } // namespace madness
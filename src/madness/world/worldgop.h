@@ -39,6 +39,8 @@
 /// the abbreviation.
 
 #include <type_traits>
+#include <memory>
+#include <vector>
 #include <madness/world/worldtypes.h>
 #include <madness/world/buffer_archive.h>
 #include <madness/world/world.h>
@@ -140,11 +142,43 @@ namespace madness {
     /// Provides collectives that interoperate with the AM and task interfaces
 
     /// If native AM interoperates with MPI we probably should map these to MPI.
+    ///
+    /// \c reduce, \c broadcast and \c fence run over a spanning tree of
+    /// the processes. By default this is a binary tree over all ranks. If
+    /// the environment variable `MAD_GOP_TREE=hierarchical` is set (or
+    /// \c set_hierarchical is called) the tree is topology aware: the
+    /// processes on each node form a binary tree under one node leader,
+    /// which hops through the node's shared-memory transport, and only the
+    /// leaders communicate across nodes, again over a binary tree. Nodes
+    /// are identified by host name, or `MAD_RANKS_PER_NODE=n` groups each
+    /// n consecutive ranks (to emulate a layout or to override detection).
+    ///
+    /// Reductions proceed in segments of at most `MAD_GOP_SEGMENT` bytes
+    /// (default 1MB) so temporary memory is bounded by two segments per
+    /// child and the levels of the tree work on successive segments
+    /// concurrently.
     class WorldGopInterface {
     private:
         World& world_; ///< MPI interface
         std::shared_ptr<detail::DeferredCleanup> deferred_; ///< Deferred cleanup object.
         bool debug_; ///< Debug mode
+        bool hierarchical_; ///< Use the topology-aware tree
+        bool topology_known_; ///< True once nodes have been identified
+        std::size_t segment_bytes_; ///< Max. bytes reduced per step
+        std::vector<int> node_of_; ///< Node index of each process
+        std::vector< std::vector<ProcessID> > nodes_; ///< Processes on each node in ascending order
+        unsigned long ireduce_count_; ///< Number of non-blocking reductions started
+
+        /// Reads the tree configuration from the environment
+        void configure_tree();
+
+        /// Identifies the processes on each node (collective)
+        void discover_topology();
+
+        /// Returns the parent and children of this process in the tree rooted at \c root
+
+        /// The first call with the hierarchical tree selected is collective.
+        void tree_info(ProcessID root, ProcessID& parent, std::vector<ProcessID>& children);
 
         friend class detail::DeferredCleanup;
 
@@ -158,6 +192,57 @@ namespace madness {
         struct GroupReduceTag { };
         struct AllReduceTag { };
         struct GroupAllReduceTag { };
+        struct IReduceTag { };
+        struct IAllReduceTag { };
+
+        /// Key of a non-blocking reduction: the world id and a per-world count
+        struct IReduceKey {
+            unsigned long world_id;
+            unsigned long count;
+
+            bool operator==(const IReduceKey& other) const {
+                return (world_id == other.world_id) && (count == other.count);
+            }
+
+            hashT hash() const {
+                hashT seed = hash_value(world_id);
+                detail::combine_hash(seed, hash_value(count));
+                return seed;
+            }
+
+            template <typename Archive>
+            void serialize(const Archive& ar) { ar & world_id & count; }
+        };
+
+        /// Adapts an elementwise binary operation (e.g., \c WorldSumOp) to
+        /// the functor interface of the keyed reductions
+
+        /// The initial value is an empty vector, so operations without an
+        /// identity element (e.g., max) need no special treatment.
+        /// \tparam T The element type
+        /// \tparam opT The binary operation type
+        template <typename T, typename opT>
+        class ElementwiseReduceOp {
+        private:
+            opT op_; ///< The binary operation
+        public:
+            typedef std::vector<T> result_type;
+            typedef std::vector<T> argument_type;
+
+            ElementwiseReduceOp(const opT& op) : op_(op) { }
+
+            result_type operator()() const { return result_type(); }
+
+            void operator()(result_type& result, const argument_type& value) const {
+                if(result.empty()) {
+                    result = value;
+                } else {
+                    MADNESS_ASSERT(result.size() == value.size());
+                    for(std::size_t i = 0ul; i < result.size(); ++i)
+                        result[i] = op_(result[i], value[i]);
+                }
+            }
+        }; // class ElementwiseReduceOp
 
 
         /// Delayed send callback object
@@ -612,13 +697,35 @@ namespace madness {
             return Future<result_type>::default_initializer();
         }
 
+        template <typename T>
+        static T first_element_task(const std::vector<T>& v) {
+            MADNESS_ASSERT(v.size() == 1ul);
+            return v.front();
+        }
+
+        /// Returns the key and root of the next non-blocking reduction
+
+        /// Successive calls return distinct keys and rotate the root so the
+        /// combining work is spread over the processes.
+        IReduceKey next_ireduce_key(ProcessID& root) {
+            IReduceKey key;
+            key.world_id = world_.id();
+            key.count = ireduce_count_++;
+            root = key.count % world_.size();
+            return key;
+        }
+
 
     public:
 
         // In the World constructor can ONLY rely on MPI and MPI being initialized
         WorldGopInterface(World& world) :
-            world_(world), deferred_(new detail::DeferredCleanup()), debug_(false)
-        { }
+            world_(world), deferred_(new detail::DeferredCleanup()), debug_(false),
+            hierarchical_(false), topology_known_(false), segment_bytes_(1 << 20),
+            ireduce_count_(0ul)
+        {
+            configure_tree();
+        }
 
         ~WorldGopInterface() {
             deferred_->destroy(true);
@@ -633,6 +740,29 @@ namespace madness {
             return status;
         }
 
+        /// Selects the tree used by reduce, broadcast and fence
+
+        /// Must be called by all processes with the same value between collectives.
+        /// \param[in] value True for the topology-aware tree, false for a binary tree over all ranks.
+        /// \return The previous setting.
+        bool set_hierarchical(bool value) {
+            bool status = hierarchical_;
+            hierarchical_ = value;
+            return status;
+        }
+
+        /// Returns true if reduce, broadcast and fence use the topology-aware tree
+        bool get_hierarchical() const {
+            return hierarchical_;
+        }
+
+        /// Sets the size of the segments in which reductions proceed
+
+        /// \param[in] nbyte Max. bytes per segment (same on all processes).
+        void set_segment_bytes(std::size_t nbyte) {
+            segment_bytes_ = (nbyte > 0) ? nbyte : 1;
+        }
+
         /// Synchronizes all processes in communicator ... does NOT fence pending AM or tasks
         void barrier() {
             long i = world_.rank();
@@ -708,36 +838,50 @@ namespace madness {
 
         /// Inplace global reduction (like MPI all_reduce) while still processing AM & tasks
 
-        /// Optimizations can be added for long messages and to reduce the memory footprint
+        /// Data is reduced up the tree in segments, so each process needs
+        /// at most two segments of temporary storage per child, then
+        /// broadcast back down.
         template <typename T, class opT>
         void reduce(T* buf, size_t nelem, opT op) {
-            SafeMPI::Request req0, req1;
-            ProcessID parent, child0, child1;
-            world_.mpi.binary_tree_info(0, parent, child0, child1);
+            ProcessID parent;
+            std::vector<ProcessID> children;
+            tree_info(0, parent, children);
             Tag gsum_tag = world_.mpi.unique_tag();
 
-            T* buf0 = new T[nelem];
-            T* buf1 = new T[nelem];
-
-            if (child0 != -1) req0 = world_.mpi.Irecv(buf0, nelem*sizeof(T), MPI_BYTE, child0, gsum_tag);
-            if (child1 != -1) req1 = world_.mpi.Irecv(buf1, nelem*sizeof(T), MPI_BYTE, child1, gsum_tag);
-
-            if (child0 != -1) {
-                World::await(req0);
-                for (long i=0; i<(long)nelem; ++i) buf[i] = op(buf[i],buf0[i]);
-            }
-            if (child1 != -1) {
-                World::await(req1);
-                for (long i=0; i<(long)nelem; ++i) buf[i] = op(buf[i],buf1[i]);
-            }
-
-            delete [] buf0;
-            delete [] buf1;
-
-            if (parent != -1) {
-                req0 = world_.mpi.Isend(buf, nelem*sizeof(T), MPI_BYTE, parent, gsum_tag);
-                World::await(req0);
+            const std::size_t nchild = children.size();
+            const std::size_t seglen = std::max(std::size_t(1),
+                    std::min(nelem, segment_bytes_/sizeof(T)));
+            const std::size_t nseg = (nelem + seglen - 1)/seglen;
+
+            // Two buffers per child so segment s+1 arrives while s is combined
+            std::unique_ptr<T[]> tmp(nchild ? new T[2*nchild*seglen] : nullptr);
+            std::vector<SafeMPI::Request> rreq(2*nchild);
+            std::vector<SafeMPI::Request> sreq(parent != -1 ? nseg : 0);
+
+            auto post_recv = [&](std::size_t s) {
+                const std::size_t n = std::min(seglen, nelem - s*seglen);
+                for (std::size_t c=0; c<nchild; ++c) {
+                    const std::size_t slot = 2*c + s%2;
+                    rreq[slot] = world_.mpi.Irecv(tmp.get() + slot*seglen, n*sizeof(T),
+                            MPI_BYTE, children[c], gsum_tag);
+                }
+            };
+
+            if (nseg && nchild) post_recv(0);
+            for (std::size_t s=0; s<nseg; ++s) {
+                if (s+1 < nseg && nchild) post_recv(s+1);
+                T* seg = buf + s*seglen;
+                const long n = std::min(seglen, nelem - s*seglen);
+                for (std::size_t c=0; c<nchild; ++c) {
+                    const std::size_t slot = 2*c + s%2;
+                    World::await(rreq[slot]);
+                    const T* in = tmp.get() + slot*seglen;
+                    for (long i=0; i<n; ++i) seg[i] = op(seg[i],in[i]);
+                }
+                if (parent != -1)
+                    sreq[s] = world_.mpi.Isend(seg, n*sizeof(T), MPI_BYTE, parent, gsum_tag);
             }
+            for (std::size_t s=0; s<sreq.size(); ++s) World::await(sreq[s]);
 
             broadcast(buf, nelem, 0);
         }
@@ -1279,6 +1423,114 @@ namespace madness {
 
             return reduce_result;
         }
+
+        /// Non-blocking elementwise reduction of a vector onto \c root
+
+        /// Starts the reduction and returns immediately; the communication
+        /// and combining run as high-priority tasks and active messages, so
+        /// the caller can overlap the reduction with further work. Waiting on
+        /// the result (\c Future::get) keeps processing tasks and AMs. All
+        /// processes must start non-blocking reductions in the same order and
+        /// with vectors of equal length.
+        /// \tparam T The element type
+        /// \tparam opT The binary operation type (e.g., \c WorldSumOp<T>)
+        /// \param v The local values
+        /// \param op The binary operation applied elementwise
+        /// \param root The process that receives the result
+        /// \return A future to the reduced vector on \c root, otherwise an
+        /// uninitialized future that may be ignored.
+        template <typename T, typename opT>
+        Future< std::vector<T> > ireduce(const std::vector<T>& v, opT op, const ProcessID root = 0) {
+            MADNESS_ASSERT((root >= 0) && (root < world_.size()));
+            ProcessID ignored;
+            const IReduceKey key = next_ireduce_key(ignored);
+            ProcessID parent = -1, child0 = -1, child1 = -1;
+            world_.mpi.binary_tree_info(root, parent, child0, child1);
+
+            return reduce_internal<IReduceTag>(parent, child0, child1, root, key,
+                    v, ElementwiseReduceOp<T, opT>(op));
+        }
+
+        /// Non-blocking reduction of a scalar onto \c root
+
+        /// \see ireduce(const std::vector<T>&, opT, const ProcessID)
+        template <typename T, typename opT>
+        Future<T> ireduce(const T& value, opT op, const ProcessID root = 0) {
+            Future< std::vector<T> > result = ireduce(std::vector<T>(1, value), op, root);
+            if(world_.rank() != root)
+                return Future<T>::default_initializer();
+            return world_.taskq.add(WorldGopInterface::template first_element_task<T>,
+                    result, TaskAttributes::hipri());
+        }
+
+        /// Non-blocking elementwise reduction of a vector with the result on all processes
+
+        /// \see ireduce(const std::vector<T>&, opT, const ProcessID)
+        template <typename T, typename opT>
+        Future< std::vector<T> > iallreduce(const std::vector<T>& v, opT op) {
+            ProcessID root;
+            const IReduceKey key = next_ireduce_key(root);
+            ProcessID parent = -1, child0 = -1, child1 = -1;
+            world_.mpi.binary_tree_info(root, parent, child0, child1);
+
+            Future< std::vector<T> > result =
+                    reduce_internal<IAllReduceTag>(parent, child0, child1, root,
+                            key, v, ElementwiseReduceOp<T, opT>(op));
+            if(world_.rank() != root)
+                result = Future< std::vector<T> >();
+
+            bcast_internal<IAllReduceTag>(key, result, root);
+
+            return result;
+        }
+
+        /// Non-blocking reduction of a scalar with the result on all processes
+
+        /// \see ireduce(const std::vector<T>&, opT, const ProcessID)
+        template <typename T, typename opT>
+        Future<T> iallreduce(const T& value, opT op) {
+            return world_.taskq.add(WorldGopInterface::template first_element_task<T>,
+                    iallreduce(std::vector<T>(1, value), op), TaskAttributes::hipri());
+        }
+
+        /// Non-blocking global sum of a scalar or elementwise sum of a vector
+
+        /// \see iallreduce
+        template <typename T>
+        Future<T> isum(const T& value) {
+            return iallreduce(value, WorldSumOp<T>());
+        }
+
+        template <typename T>
+        Future< std::vector<T> > isum(const std::vector<T>& v) {
+            return iallreduce(v, WorldSumOp<T>());
+        }
+
+        /// Non-blocking global max of a scalar or elementwise max of a vector
+
+        /// \see iallreduce
+        template <typename T>
+        Future<T> imax(const T& value) {
+            return iallreduce(value, WorldMaxOp<T>());
+        }
+
+        template <typename T>
+        Future< std::vector<T> > imax(const std::vector<T>& v) {
+            return iallreduce(v, WorldMaxOp<T>());
+        }
+
+        /// Non-blocking global min of a scalar or elementwise min of a vector
+
+        /// \see iallreduce
+        template <typename T>
+        Future<T> imin(const T& value) {
+            return iallreduce(value, WorldMinOp<T>());
+        }
+
+        template <typename T>
+        Future< std::vector<T> > imin(const std::vector<T>& v) {
+            return iallreduce(v, WorldMinOp<T>());
+        }
     }; // class WorldGopInterface
 
 } // namespace madness
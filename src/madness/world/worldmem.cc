@@ -98,6 +98,22 @@ namespace madness {
             << cur_num_frags << " " << std::setw(12) << max_num_frags << "\n";
         std::cout << "  cur and max bytes allocated " << std::setw(12)
             << cur_num_bytes << " " << std::setw(12) << max_num_bytes << "\n";
+        if (PoolMem::enabled()) print_pool();
+    }
+
+    void WorldMemInfo::print_pool() const {
+        const PoolMemStats s = pool_stats();
+        std::cout.flush();
+        std::cout << "\n    MADNESS tensor pool statistics\n";
+        std::cout << "    ------------------------------\n";
+        std::cout << "     allocations and pool hits " << std::setw(12)
+            << s.nalloc << " " << std::setw(12) << s.nhit << "\n";
+        std::cout << "      local and remote frees   " << std::setw(12)
+            << s.nfree << " " << std::setw(12) << s.nfree_remote << "\n";
+        std::cout << "      unpooled (large) allocs  " << std::setw(12)
+            << s.nlarge << "\n";
+        std::cout << "      bytes cached in pool     " << std::setw(12)
+            << s.cached_bytes << "\n";
     }
 
     void WorldMemInfo::reset() {
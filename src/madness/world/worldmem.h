@@ -42,6 +42,7 @@
 #endif // WORLD_GATHER_MEM_STATS
 #include <cstddef>
 #include <fstream>
+#include <madness/world/poolmem.h>
 #include <sstream>
 
 #if defined(HAVE_IBMBGQ)
@@ -93,6 +94,16 @@ namespace madness {
         /// Prints memory use statistics to std::cout
         void print() const;
 
+        /// Statistics of the tensor memory pool of this process
+
+        /// See \c PoolMem; the counters are kept by the pool itself.
+        PoolMemStats pool_stats() const {
+            return PoolMem::get_stats();
+        }
+
+        /// Prints tensor memory pool statistics to std::cout
+        void print_pool() const;
+
         /// Resets all counters to zero
         void reset();
 
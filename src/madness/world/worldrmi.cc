@@ -40,6 +40,7 @@
 #include <sstream>
 #include <list>
 #include <memory>
+#include <cstring>
 #include <mpi.h>
 
 namespace madness {
@@ -55,6 +56,52 @@ namespace madness {
     tbb::task* RMI::tbb_rmi_parent_task = nullptr;
 #endif
 
+    namespace {
+
+        /// Parses a size in bytes with an optional unit (KB, MB or GB)
+        double parse_bytes(const char* str) {
+            std::stringstream ss(str);
+            double size = 0.0;
+            if (ss >> size) {
+                std::string unit;
+                if (ss >> unit) { // Failure == assume bytes
+                    if (unit == "KB" || unit == "kB") size *= 1024.0;
+                    else if (unit == "MB") size *= 1048576.0;
+                    else if (unit == "GB") size *= 1073741824.0;
+                }
+            }
+            return size;
+        }
+
+        // A multi-piece huge message send is reported to the caller as an
+        // MPI generalized request that the server completes once every
+        // piece has gone
+        int huge_send_query(void*, MPI_Status* status) {
+            MPI_Status_set_elements(status, MPI_BYTE, 0);
+            MPI_Status_set_cancelled(status, 0);
+            status->MPI_SOURCE = MPI_UNDEFINED;
+            status->MPI_TAG = MPI_UNDEFINED;
+            return MPI_SUCCESS;
+        }
+
+        int huge_send_free(void*) { return MPI_SUCCESS; }
+
+        int huge_send_cancel(void*, int) { return MPI_SUCCESS; }
+
+        /// Runs a message handler, timing it if the tracer is enabled
+        inline void invoke(rmi_handlerT func, void* buf, size_t len, int src) {
+            if (profiling::Tracer::enabled()) {
+                const double start = wall_time();
+                func(buf, len);
+                profiling::Tracer::rmi_recv(src, len, reinterpret_cast<const void*>(func), start);
+            }
+            else {
+                func(buf, len);
+            }
+        }
+
+    } // namespace
+
     void RMI::RmiTask::process_some() {
 
         const bool print_debug_info = RMI::debugging;
@@ -76,6 +123,8 @@ namespace madness {
           if (narrived) break;
 	  ++iterations;
           clear_send_req();
+          flush_expired();
+          progress_huge_send();
 	  myusleep(RMI::testsome_backoff_us);
         }
 
@@ -90,8 +139,17 @@ namespace madness {
         if (narrived) {
             for (int m=0; m<narrived; ++m) {
                 const int src = status[m].Get_source();
-                const size_t len = status[m].Get_count(MPI_BYTE);
                 const int i = ind[m];
+                size_t len;
+                if (i < (int)nrecv_) {
+                    len = status[m].Get_count(MPI_BYTE);
+                }
+                else {
+                    // Huge message ... this was its last piece
+                    wait_huge_recv(i);
+                    len = huge_recv[i - nrecv_].nbyte;
+                    ++(RMI::stats.nhuge_recv);
+                }
 
                 ++(RMI::stats.nmsg_recv);
                 RMI::stats.nbyte_recv += len;
@@ -113,7 +171,7 @@ namespace madness {
                                   << std::endl;
 
                     if (is_ordered(attr)) ++(recv_counters[src]);
-                    func(recv_buf[i], len);
+                    invoke(func, recv_buf[i], len, src);
                     post_recv_buf(i);
                 }
                 else {
@@ -156,7 +214,7 @@ namespace madness {
                                   << std::endl;
 
                     ++(recv_counters[src]);
-                    q[m].func(recv_buf[q[m].i], q[m].len);
+                    invoke(q[m].func, recv_buf[q[m].i], q[m].len, src);
                     post_recv_buf(q[m].i);
                 }
                 else {
@@ -176,35 +234,89 @@ namespace madness {
             post_pending_huge_msg();
 
             clear_send_req();
+            flush_expired();
+            progress_huge_send();
         }
     }
 
     void RMI::RmiTask::post_pending_huge_msg() {
-        if (recv_buf[nrecv_]) return;      // Message already pending
-        if (!hugeq.empty()) {
-            const auto& hugemsg = hugeq.front();
-            const int src = std::get<0>(hugemsg);
-            const size_t nbyte = std::get<1>(hugemsg);
-            const int tag = std::get<2>(hugemsg);
+        for (std::size_t k=0; k<nhuge_ && !hugeq.empty(); ++k) {
+            const int i = nrecv_ + k;
+            if (recv_buf[i]) continue;      // Message already pending
+            const HugeMsg msg = hugeq.front();
             hugeq.pop_front();
-            if (posix_memalign(&recv_buf[nrecv_], ALIGNMENT, nbyte))
+            if (posix_memalign(&recv_buf[i], ALIGNMENT, msg.nbyte))
                 MADNESS_EXCEPTION("RMI: failed allocating huge message", 1);
-            recv_req[nrecv_] = comm.Irecv(recv_buf[nrecv_], nbyte, MPI_BYTE, src, tag);
-            int nada=0;
+
+            // The pieces are matched in order since they share the tag;
+            // the last goes in recv_req so Testsome reports the message
+            HugeRecv& h = huge_recv[k];
+            h.nbyte = msg.nbyte;
+            h.piece.clear();
+            char* p = static_cast<char*>(recv_buf[i]);
+            const std::size_t npiece = msg.piece.size();
+            for (std::size_t j=0; j<npiece; ++j) {
+                Request req = comm.Irecv(p, msg.piece[j], MPI_BYTE, msg.src, msg.tag);
+                if (j+1 < npiece) h.piece.push_back(req);
+                else recv_req[i] = req;
+                p += msg.piece[j];
+            }
+
             // make unique tags to ensure that ack msgs do not collide with normal recv msgs
 #ifdef MADNESS_USE_BSEND_ACKS
-            comm.Bsend(&nada, sizeof(nada), MPI_BYTE, src, tag + unique_tag_period());
+            comm.Bsend(&h.ack, sizeof(h.ack), MPI_BYTE, msg.src, msg.tag + unique_tag_period());
 #else
-            comm.Send(&nada, sizeof(nada), MPI_BYTE, src, tag + unique_tag_period());
+            h.ack_req = comm.Isend(&h.ack, sizeof(h.ack), MPI_BYTE, msg.src, msg.tag + unique_tag_period());
 #endif // MADNESS_USE_BSEND_ACKS
         }
     }
 
+    void RMI::RmiTask::wait_huge_recv(int i) {
+        HugeRecv& h = huge_recv[i - nrecv_];
+        MutexWaiter waiter;
+        for (Request& req : h.piece) {
+            while (!req.Test()) waiter.wait();
+        }
+        h.piece.clear();
+    }
+
+    void RMI::RmiTask::progress_huge_send() {
+        if (!nhuge_send_) return;
+        lock();
+        auto it = huge_send.begin();
+        while (it != huge_send.end()) {
+            bool done = true;
+            for (Request& req : it->piece) {
+                if (!req.Test()) {
+                    done = false;
+                    break;
+                }
+            }
+            if (done) {
+                {
+                    SAFE_MPI_GLOBAL_MUTEX;
+                    MADNESS_MPI_TEST(MPI_Grequest_complete(it->done));
+                }
+                it = huge_send.erase(it);
+                --nhuge_send_;
+            }
+            else {
+                ++it;
+            }
+        }
+        unlock();
+    }
+
     void RMI::RmiTask::post_recv_buf(int i) {
         if (i < (int)nrecv_) {
             recv_req[i] = comm.Irecv(recv_buf[i], max_msg_len_, MPI_BYTE, MPI_ANY_SOURCE, SafeMPI::RMI_TAG);
         }
-        else if (i == (int)nrecv_) {
+        else if (i < (int)(nrecv_ + nhuge_)) {
+#ifndef MADNESS_USE_BSEND_ACKS
+            // The sender has had the ack so it has gone, but it may not be complete here yet
+            MutexWaiter waiter;
+            while (!huge_recv[i - nrecv_].ack_req.Test()) waiter.wait();
+#endif // MADNESS_USE_BSEND_ACKS
             free(recv_buf[i]);
             recv_buf[i] = 0;
             post_pending_huge_msg();
@@ -214,6 +326,94 @@ namespace madness {
         }
     }
 
+    void RMI::RmiTask::batch_handler(void *buf, size_t nbytein) {
+        // Messages are packed back-to-back after the batch header, each
+        // padded to ALIGNMENT and carrying its length in its own header
+        ++(RMI::stats.nbatch_recv);
+        char* p = static_cast<char*>(buf) + HEADER_LEN;
+        const char* end = static_cast<char*>(buf) + nbytein;
+        while (p < end) {
+            const header* h = (const header*)(p);
+            const std::size_t len = h->len;
+            invoke(h->func, p, len, -1);
+            p += ((len + ALIGNMENT - 1)/ALIGNMENT)*ALIGNMENT;
+        }
+    }
+
+    void RMI::RmiTask::send_batch(ProcessID dest, flush_reasonT reason) {
+        Batch& b = batches[dest];
+        MADNESS_ASSERT(b.buf);
+
+        ++(RMI::stats.nbatch_sent);
+        RMI::stats.nmsg_batched += b.nmsg;
+        RMI::stats.max_msg_per_batch = std::max(RMI::stats.max_msg_per_batch, uint64_t(b.nmsg));
+        switch (reason) {
+        case FLUSH_SIZE:    ++(RMI::stats.nflush_size); break;
+        case FLUSH_TIMEOUT: ++(RMI::stats.nflush_timeout); break;
+        case FLUSH_FENCE:   ++(RMI::stats.nflush_fence); break;
+        case FLUSH_ORDER:   ++(RMI::stats.nflush_order); break;
+        }
+
+        // Always ordered so it cannot overtake an earlier unbatched ordered message
+        Request req = post_send(b.buf, b.nbyte, dest, batch_handler, ATTR_ORDERED, SafeMPI::RMI_TAG);
+        batch_inflight.push_back(std::make_pair(b.buf, req));
+
+        b.buf = 0;
+        b.nbyte = 0;
+        b.nmsg = 0;
+        --nbatch_open;
+    }
+
+    void RMI::RmiTask::reclaim_batch_bufs() {
+        auto it = batch_inflight.begin();
+        while (it != batch_inflight.end()) {
+            if (it->second.Test()) {
+                batch_free.push_back(it->first);
+                it = batch_inflight.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void RMI::RmiTask::flush(flush_reasonT reason) {
+        if (!batch_size_ || !nbatch_open) return;
+        lock();
+        for (ProcessID p=0; p<nproc; ++p) {
+            if (batches[p].buf) send_batch(p, reason);
+        }
+        unlock();
+    }
+
+    void RMI::RmiTask::flush_expired() {
+        if (!batch_size_ || !nbatch_open) return;
+        const double now = wall_time();
+        lock();
+        for (ProcessID p=0; p<nproc; ++p) {
+            if (batches[p].buf && (now - batches[p].start) > batch_timeout_)
+                send_batch(p, FLUSH_TIMEOUT);
+        }
+        reclaim_batch_bufs();
+        unlock();
+    }
+
+    void RMI::RmiTask::free_batch_bufs() {
+        if (!batch_size_) return;
+        MutexWaiter waiter;
+        lock();
+        while (true) {
+            reclaim_batch_bufs();
+            if (batch_inflight.empty()) break;
+            unlock();
+            waiter.wait();
+            lock();
+        }
+        for (char* buf : batch_free) free(buf);
+        batch_free.clear();
+        unlock();
+    }
+
     RMI::RmiTask::~RmiTask() {
         //         if (!SafeMPI::Is_finalized()) {
         //             for (int i=0; i<nrecv_; ++i) {
@@ -235,13 +435,25 @@ namespace madness {
             , recv_counters(new counterT[nproc])
             , max_msg_len_(DEFAULT_MAX_MSG_LEN)
             , nrecv_(DEFAULT_NRECV)
-            , maxq_(DEFAULT_NRECV + 1)
+            , maxq_(DEFAULT_NRECV + DEFAULT_NHUGE)
             , recv_buf()
             , recv_req()
             , status()
             , ind()
             , q()
             , n_in_q(0)
+            , batch_size_(0)
+            , batch_max_msg_(0)
+            , batch_timeout_(50e-6)
+            , batches()
+            , batch_inflight()
+            , batch_free()
+            , nbatch_open(0)
+            , nhuge_(DEFAULT_NHUGE)
+            , huge_chunk_(DEFAULT_HUGE_CHUNK)
+            , huge_recv()
+            , huge_send()
+            , nhuge_send_(0)
     {
         // Get the maximum buffer size from the MAD_BUFFER_SIZE environment
         // variable.
@@ -290,9 +502,34 @@ namespace madness {
                 std::cerr << "!!! WARNING: MAD_RECV_BUFFERS must be at least 32.\n"
                           << "!!! WARNING: Increasing MAD_RECV_BUFFERS to " << nrecv_ << ".\n";
             }
-            maxq_ = nrecv_ + 1;
         }
 
+        // Get the number of concurrent huge message receives from the
+        // MAD_RMI_HUGE_RECV environment variable and the size of the
+        // pieces they are sent in from MAD_RMI_CHUNK.
+        const char* mad_rmi_huge_recv = getenv("MAD_RMI_HUGE_RECV");
+        if (mad_rmi_huge_recv) {
+            std::stringstream ss(mad_rmi_huge_recv);
+            int n = 0;
+            if (!(ss >> n) || n < 1) {
+                n = DEFAULT_NHUGE;
+                std::cerr << "!!! WARNING: MAD_RMI_HUGE_RECV must be at least 1.\n"
+                          << "!!! WARNING: Using " << n << ".\n";
+            }
+            nhuge_ = n;
+        }
+        maxq_ = nrecv_ + nhuge_;
+
+        const char* mad_rmi_chunk = getenv("MAD_RMI_CHUNK");
+        if (mad_rmi_chunk) {
+            const double chunk = parse_bytes(mad_rmi_chunk);
+            huge_chunk_ = (chunk > 0.0) ? std::size_t(chunk) : std::size_t(0);
+        }
+        // A piece is sent as one MPI message so must fit in an int
+        if (huge_chunk_ == 0 || huge_chunk_ > (std::size_t(1) << 30))
+            huge_chunk_ = std::size_t(1) << 30;
+        huge_chunk_ = std::max(huge_chunk_, max_msg_len_);
+
         // Get environment variable controlling use of synchronous send (MAD_NSSEND)
         // negative=sends synchronous message every MAD_RECV_BUFFER sends (default)
         //        0=never send synchronous message
@@ -307,6 +544,32 @@ namespace madness {
             }
         }
 
+        // Get the size of the buffers aggregating small messages from the
+        // MAD_RMI_BATCH environment variable (bytes, or with units KB/MB).
+        // Batches must fit in the receive buffers.
+        const char* mad_rmi_batch = getenv("MAD_RMI_BATCH");
+        if (mad_rmi_batch && nproc > 1) {
+            const double size = parse_bytes(mad_rmi_batch);
+            if (size > 0.0) {
+                batch_size_ = std::max(std::size_t(size), std::size_t(4096));
+                if (batch_size_ > max_msg_len_) {
+                    batch_size_ = max_msg_len_;
+                    std::cerr << "!!! WARNING: MAD_RMI_BATCH cannot exceed MAD_BUFFER_SIZE.\n"
+                              << "!!! WARNING: Reducing MAD_RMI_BATCH to " << batch_size_ << " bytes.\n";
+                }
+                batch_size_ -= batch_size_ % ALIGNMENT;
+                batch_max_msg_ = batch_size_/4;
+                batches.reset(new Batch[nproc]);
+            }
+
+            const char* mad_rmi_batch_timeout = getenv("MAD_RMI_BATCH_TIMEOUT_US");
+            if (mad_rmi_batch_timeout) {
+                std::stringstream ss(mad_rmi_batch_timeout);
+                double us = 0.0;
+                if (ss >> us && us >= 0.0) batch_timeout_ = us*1e-6;
+            }
+        }
+
         // Allocate memory for receive buffer and requests
         recv_buf.reset(new void*[maxq_]);
         recv_req.reset(new Request[maxq_]);
@@ -319,6 +582,7 @@ namespace madness {
         status.reset(new SafeMPI::Status[maxq_]);
         ind.reset(new int[maxq_]);
         q.reset(new qmsg[maxq_]);
+        huge_recv.reset(new HugeRecv[nhuge_]);
 
         // Allocate receive buffers
         if(nproc > 1) {
@@ -327,7 +591,7 @@ namespace madness {
                     MADNESS_EXCEPTION("RMI:initialize:failed allocating aligned recv buffer", 1);
                 post_recv_buf(i);
             }
-            recv_buf[nrecv_] = 0;
+            for (std::size_t k = 0; k < nhuge_; ++k) recv_buf[nrecv_ + k] = 0;
         }
     }
 
@@ -335,9 +599,12 @@ namespace madness {
     void RMI::RmiTask::huge_msg_handler(void *buf, size_t /*nbytein*/) {
         const size_t* info = (size_t *)(buf);
         int nword = HEADER_LEN/sizeof(size_t);
-        const int src = info[nword];
-        const size_t nbyte = info[nword+1];
-        const int tag = info[nword+2];
+        HugeMsg msg;
+        msg.src = info[nword];
+        msg.nbyte = info[nword+1];
+        msg.tag = info[nword+2];
+        const size_t npiece = info[nword+3];
+        msg.piece.assign(info + nword + 4, info + nword + 4 + npiece);
 
         // extra dose of paranoia: assert that we never process so many huge messages
         // that the tag wraparound somewhere becomes possible ...
@@ -348,7 +615,7 @@ namespace madness {
                        RMI::task_ptr->hugeq.size() <
                            RMI::RmiTask::unique_tag_period() /
                                RMI::task_ptr->comm.Get_size());
-        RMI::task_ptr->hugeq.push_back(std::make_tuple(src, nbyte, tag));
+        RMI::task_ptr->hugeq.push_back(msg);
         RMI::task_ptr->post_pending_huge_msg();
     }
 
@@ -416,28 +683,63 @@ namespace madness {
 
     RMI::Request
     RMI::RmiTask::RmiTask::isend(const void* buf, size_t nbyte, ProcessID dest, rmi_handlerT func, attrT attr) {
-        int tag = SafeMPI::RMI_TAG;
-        static std::size_t numsent = 0; // for tracking synchronous sends
+        if (nbyte > batch_max_msg_ || nbyte < HEADER_LEN)
+            return isend_direct(buf, nbyte, dest, func, attr);
 
-        if (nbyte > max_msg_len_) {
-            // Huge message protocol ... send message to dest indicating size and origin of huge message.
-            // Remote end posts a buffer then acks the request.  This end can then send.
-            const int nword = HEADER_LEN/sizeof(size_t);
-            size_t info[nword+3];
-            info[nword  ] = rank;
-            info[nword+1] = nbyte;
-            tag = unique_tag();
-            info[nword+2] = tag;
-
-            int ack;
-            // make unique tags to ensure that ack msgs do not collide with normal recv msgs
-            Request req_ack = comm.Irecv(&ack, sizeof(ack), MPI_BYTE, dest, tag + unique_tag_period());
-            Request req_send = isend(info, sizeof(info), dest, RMI::RmiTask::huge_msg_handler, ATTR_UNORDERED);
+        if (RMI::debugging)
+            std::cerr << rank
+                      << ":RMI: batching buf=" << buf
+                      << " nbyte=" << nbyte
+                      << " dest=" << dest
+                      << " func=" << func
+                      << " ordered=" << is_ordered(attr)
+                      << std::endl;
 
-            MutexWaiter waiter;
-            while (!req_send.Test()) waiter.wait();
-            waiter.reset();
-            while (!req_ack.Test()) waiter.wait();
+        const std::size_t nalign = ((nbyte + ALIGNMENT - 1)/ALIGNMENT)*ALIGNMENT;
+
+        lock();
+
+        Batch& b = batches[dest];
+        if (b.buf && b.nbyte + nalign > batch_size_) send_batch(dest, FLUSH_SIZE);
+        if (!b.buf) {
+            if (batch_free.empty()) reclaim_batch_bufs();
+            if (batch_free.empty()) {
+                void* p = 0;
+                if (posix_memalign(&p, ALIGNMENT, batch_size_))
+                    MADNESS_EXCEPTION("RMI: failed allocating batch buffer", 1);
+                b.buf = static_cast<char*>(p);
+            }
+            else {
+                b.buf = batch_free.back();
+                batch_free.pop_back();
+            }
+            b.nbyte = HEADER_LEN;
+            b.start = wall_time();
+            ++nbatch_open;
+        }
+
+        // Order within the batch is the order of arrival here, and the
+        // batch itself is ordered, so ordered messages stay in sequence
+        char* p = b.buf + b.nbyte;
+        std::memcpy(p, buf, nbyte);
+        header* h = (header*)(p);
+        h->func = func;
+        h->attr = attr;
+        h->len = nbyte;
+        b.nbyte += nalign;
+        ++(b.nmsg);
+
+        unlock();
+
+        // The message has been copied so the caller may reuse buf at once
+        return Request();
+    }
+
+    RMI::Request
+    RMI::RmiTask::isend_direct(const void* buf, size_t nbyte, ProcessID dest, rmi_handlerT func, attrT attr) {
+        if (nbyte > max_msg_len_) {
+            const Segment seg = {buf, nbyte};
+            return isendv(&seg, 1, dest, func, attr);
         }
         else if (nbyte < HEADER_LEN) {
             MADNESS_EXCEPTION("RMI::isend --- your buffer is too small to hold the header", static_cast<int>(nbyte));
@@ -457,6 +759,125 @@ namespace madness {
         // we presently always get the lock
         lock();
 
+        // Held back messages to dest must be delivered first
+        if (is_ordered(attr) && batch_size_ && batches[dest].buf)
+            send_batch(dest, FLUSH_ORDER);
+
+        Request result = post_send(buf, nbyte, dest, func, attr, SafeMPI::RMI_TAG);
+
+        unlock();
+
+        return result;
+    }
+
+    RMI::Request
+    RMI::RmiTask::isendv(const Segment* seg, int nseg, ProcessID dest, rmi_handlerT func, attrT attr) {
+        MADNESS_ASSERT(nseg > 0);
+        if (seg[0].nbyte < HEADER_LEN)
+            MADNESS_EXCEPTION("RMI::isendv --- your first segment is too small to hold the header", static_cast<int>(seg[0].nbyte));
+
+        // Split the segments into pieces, coarsening if the list of
+        // pieces would not fit in the control message
+        const int nword = HEADER_LEN/sizeof(size_t);
+        const std::size_t maxpiece = (max_msg_len_ - HEADER_LEN)/sizeof(size_t) - 4;
+        std::size_t chunk = huge_chunk_;
+        std::vector<Segment> piece;
+        std::size_t nbyte;
+        while (true) {
+            piece.clear();
+            nbyte = 0;
+            for (int s=0; s<nseg; ++s) {
+                const char* p = static_cast<const char*>(seg[s].buf);
+                std::size_t n = seg[s].nbyte;
+                nbyte += n;
+                while (n) {
+                    const std::size_t len = std::min(n, chunk);
+                    const Segment x = {p, len};
+                    piece.push_back(x);
+                    p += len;
+                    n -= len;
+                }
+            }
+            if (piece.size() <= maxpiece) break;
+            MADNESS_ASSERT(chunk < (std::size_t(1) << 30));
+            chunk *= 2;
+        }
+
+        // Huge message protocol ... send message to dest indicating size, origin
+        // and pieces of huge message. Remote end posts a buffer then acks the request.
+        // This end can then send.
+        const int tag = unique_tag();
+        std::vector<std::size_t> info(nword + 4 + piece.size());
+        info[nword  ] = rank;
+        info[nword+1] = nbyte;
+        info[nword+2] = tag;
+        info[nword+3] = piece.size();
+        for (std::size_t j=0; j<piece.size(); ++j) info[nword+4+j] = piece[j].nbyte;
+
+        int ack;
+        // make unique tags to ensure that ack msgs do not collide with normal recv msgs
+        Request req_ack = comm.Irecv(&ack, sizeof(ack), MPI_BYTE, dest, tag + unique_tag_period());
+        Request req_send = isend_direct(info.data(), info.size()*sizeof(std::size_t), dest,
+                                        RMI::RmiTask::huge_msg_handler, ATTR_UNORDERED);
+
+        MutexWaiter waiter;
+        while (!req_send.Test()) waiter.wait();
+        waiter.reset();
+        while (!req_ack.Test()) waiter.wait();
+
+        if (RMI::debugging)
+            std::cerr << rank
+                      << ":RMI: sending huge nbyte=" << nbyte
+                      << " npiece=" << piece.size()
+                      << " dest=" << dest
+                      << " func=" << func
+                      << " ordered=" << is_ordered(attr)
+                      << " count=" << int(send_counters[dest])
+                      << std::endl;
+
+        lock();
+
+        // Held back messages to dest must be delivered first
+        if (is_ordered(attr) && batch_size_ && batches[dest].buf)
+            send_batch(dest, FLUSH_ORDER);
+
+        if (is_ordered(attr)) attr |= ((send_counters[dest]++)<<16);
+
+        header* h = (header*)(seg[0].buf);
+        h->func = func;
+        h->attr = attr;
+
+        ++(RMI::stats.nmsg_sent);
+        ++(RMI::stats.nhuge_sent);
+        RMI::stats.nbyte_sent += nbyte;
+
+        Request result;
+        if (piece.size() == 1) {
+            result = comm.Isend(piece[0].buf, piece[0].nbyte, MPI_BYTE, dest, tag);
+        }
+        else {
+            HugeSend hs;
+            for (const Segment& x : piece)
+                hs.piece.push_back(comm.Isend(x.buf, x.nbyte, MPI_BYTE, dest, tag));
+            {
+                SAFE_MPI_GLOBAL_MUTEX;
+                MADNESS_MPI_TEST(MPI_Grequest_start(huge_send_query, huge_send_free, huge_send_cancel,
+                                                    nullptr, &hs.done));
+            }
+            result = hs.done;
+            huge_send.push_back(hs);
+            ++nhuge_send_;
+        }
+
+        unlock();
+
+        return result;
+    }
+
+    RMI::Request
+    RMI::RmiTask::post_send(const void* buf, size_t nbyte, ProcessID dest, rmi_handlerT func, attrT attr, int tag) {
+        static std::size_t numsent = 0; // for tracking synchronous sends
+
         // If ordering need the mutex to enclose sending the message
         // otherwise there is a livelock scenario due to a starved thread
         // holding an early counter.
@@ -483,8 +904,6 @@ namespace madness {
             result = comm.Isend(buf, nbyte, MPI_BYTE, dest, tag);
         }
 
-        unlock();
-
         return result;
     }
 
@@ -40,6 +40,7 @@
 #include <list>
 #include <memory>
 #include <tuple>
+#include <vector>
 #include <pthread.h>
 
 /*
@@ -76,18 +77,47 @@
   - RMI::Request has the same interface as SafeMPI::Request
   (right now it is a SafeMPI::Request but this is not guaranteed)
 
+  RMI::Request RMI::isendv(const RMI::Segment* seg, int nseg, int dest,
+                           rmi_handlerT func, unsigned int attr=0)
+  - to send the concatenation of several large buffers as one message
+  without first copying them together (the first holds the header)
+
   void RMI::begin()
   - to start the server thread
 
   void RMI::end()
   - to terminate the server thread
 
+  void RMI::flush()
+  - to send any small messages held back for aggregation (see below)
+
   bool RMI::get_debug()
   - to get the debug flag
 
   void RMI::set_debug(bool)
   - to set the debug flag
 
+  Small messages may optionally be aggregated.  If the environment
+  variable MAD_RMI_BATCH is set to a size in bytes (e.g., 65536 or
+  64KB) messages of at most a quarter of that size are copied into a
+  per-destination buffer instead of being sent immediately.  A buffer
+  is sent as a single ordered message when it is full, when it has
+  been open longer than MAD_RMI_BATCH_TIMEOUT_US microseconds (default
+  50, checked by the server thread), when an ordered message that
+  cannot be batched is sent to the same destination, or when
+  RMI::flush() is called (e.g., by WorldGopInterface::fence()).  The
+  receiver unpacks the buffer and invokes each handler in turn, so
+  handlers see no difference.  Since batched messages are copied the
+  Request returned for them is already complete.
+
+  Messages longer than max_msg_len(), and all messages sent with
+  isendv(), use a rendezvous protocol: a control message describes the
+  message and the receiver acks once it has posted a buffer.  The
+  payload then goes straight from the sender's buffers in pieces of at
+  most MAD_RMI_CHUNK bytes (default 8MB, 0 means as few pieces as
+  possible) so the transfer is pipelined.  Each process receives up to
+  MAD_RMI_HUGE_RECV (default 4) such messages concurrently.
+
 */
 
 /**
@@ -129,9 +159,22 @@ namespace madness {
         uint64_t nmsg_recv;
         uint64_t nbyte_recv;
         uint64_t max_serv_send_q;
+        uint64_t nbatch_sent;       ///< Aggregated messages sent (also counted in nmsg_sent)
+        uint64_t nmsg_batched;      ///< Small messages sent inside an aggregated message
+        uint64_t max_msg_per_batch; ///< Most small messages in one aggregated message
+        uint64_t nbatch_recv;       ///< Aggregated messages received
+        uint64_t nflush_size;       ///< Batches sent because they were full
+        uint64_t nflush_timeout;    ///< Batches sent because they were too old
+        uint64_t nflush_fence;      ///< Batches sent by RMI::flush()
+        uint64_t nflush_order;      ///< Batches sent ahead of an unbatched ordered message
+        uint64_t nhuge_sent;        ///< Messages sent using the rendezvous protocol
+        uint64_t nhuge_recv;        ///< Messages received using the rendezvous protocol
 
         RMIStats()
-            : nmsg_sent(0), nbyte_sent(0), nmsg_recv(0), nbyte_recv(0), max_serv_send_q(0) {}
+            : nmsg_sent(0), nbyte_sent(0), nmsg_recv(0), nbyte_recv(0), max_serv_send_q(0)
+            , nbatch_sent(0), nmsg_batched(0), max_msg_per_batch(0), nbatch_recv(0)
+            , nflush_size(0), nflush_timeout(0), nflush_fence(0), nflush_order(0)
+            , nhuge_sent(0), nhuge_recv(0) {}
     };
 
     /// This for RMI server thread to manage lifetime of WorldAM messages that it is sending
@@ -160,6 +203,12 @@ namespace madness {
         static const attrT ATTR_UNORDERED=0x0;
         static const attrT ATTR_ORDERED=0x1;
 
+        /// A piece of a message sent by isendv()
+        struct Segment {
+            const void* buf;     ///< Start of the data (do not modify until the send completes)
+            std::size_t nbyte;   ///< Size of the data in bytes
+        };
+
         static int testsome_backoff_us;
 
         static void set_this_thread_is_server(bool flag = true) {is_server_thread = flag;}
@@ -194,10 +243,46 @@ namespace madness {
             struct header {
                 rmi_handlerT func;
                 attrT attr;
+                std::size_t len; // Only used for messages inside a batch
             }; // struct header
 
-            /// q of huge messages, each msg = {source,nbytes,tag}
-            std::list< std::tuple<int,size_t,int> > hugeq;
+            /// Why a batch was sent
+            enum flush_reasonT {FLUSH_SIZE, FLUSH_TIMEOUT, FLUSH_FENCE, FLUSH_ORDER};
+
+            /// Small messages being aggregated for one destination
+            struct Batch {
+                char* buf;          // Null if no batch is open
+                std::size_t nbyte;  // Bytes used including the batch header
+                std::size_t nmsg;   // Number of messages in the batch
+                double start;       // Wall time the first message was added
+                Batch() : buf(0), nbyte(0), nmsg(0), start(0.0) {}
+            }; // struct Batch
+
+            /// A huge message announced but not yet being received
+            struct HugeMsg {
+                int src;
+                std::size_t nbyte;
+                int tag;
+                std::vector<std::size_t> piece; // Length of each piece
+            }; // struct HugeMsg
+
+            /// State of a huge message being received
+            struct HugeRecv {
+                std::size_t nbyte;                  // Total length
+                std::vector<Request> piece;         // All but the last piece (which is in recv_req)
+                Request ack_req;
+                int ack;
+                HugeRecv() : nbyte(0), ack(0) {}
+            }; // struct HugeRecv
+
+            /// A huge message being sent in several pieces
+            struct HugeSend {
+                std::vector<Request> piece;
+                MPI_Request done;   // Generalized request returned to the sender
+            }; // struct HugeSend
+
+            /// q of huge messages waiting for a free huge recv buffer
+            std::list<HugeMsg> hugeq;
 
             SafeMPI::Intracomm comm;
             const int nproc;            // No. of processes in comm world
@@ -210,7 +295,12 @@ namespace madness {
             std::size_t nrecv_;
             long nssend_;
             std::size_t maxq_;
-            std::unique_ptr<void*[]> recv_buf; // Will be at least ALIGNMENT aligned ... +1 for huge messages
+            std::size_t nhuge_;         // No. of concurrent huge message receives
+            std::size_t huge_chunk_;    // Max. size of a piece of a huge message
+            std::unique_ptr<HugeRecv[]> huge_recv;
+            std::list<HugeSend> huge_send;   // Multi-piece sends in progress
+            volatile int nhuge_send_;        // Size of huge_send (read without lock)
+            std::unique_ptr<void*[]> recv_buf; // Will be at least ALIGNMENT aligned ... +nhuge_ for huge messages
             std::unique_ptr<SafeMPI::Request[]> recv_req;
 
             std::unique_ptr<SafeMPI::Status[]> status;
@@ -218,6 +308,14 @@ namespace madness {
             std::unique_ptr<qmsg[]> q;
             int n_in_q;
 
+            std::size_t batch_size_;     // Size of batch buffers, zero if not batching
+            std::size_t batch_max_msg_;  // Largest message that will be batched
+            double batch_timeout_;       // Max. seconds a batch is held
+            std::unique_ptr<Batch[]> batches;  // Open batch for each destination
+            std::list< std::pair<char*,Request> > batch_inflight; // Sent batches
+            std::vector<char*> batch_free;     // Buffers available for reuse
+            volatile int nbatch_open;          // No. of open batches (read without lock)
+
             static inline bool is_ordered(attrT attr) { return attr & ATTR_ORDERED; }
 
             void process_some();
@@ -267,12 +365,29 @@ namespace madness {
 
             static void huge_msg_handler(void *buf, size_t nbytein);
 
+            static void batch_handler(void *buf, size_t nbytein);
+
             Request isend(const void* buf, size_t nbyte, ProcessID dest, rmi_handlerT func, attrT attr);
 
+            /// Sends a message using the rendezvous protocol
+            Request isendv(const Segment* seg, int nseg, ProcessID dest, rmi_handlerT func, attrT attr);
+
+            /// Sends all open batches
+            void flush(flush_reasonT reason);
+
+            /// Sends batches that have been open too long (server thread)
+            void flush_expired();
+
+            /// Waits for sent batches to complete and frees all batch buffers
+            void free_batch_bufs();
+
             void post_pending_huge_msg();
 
             void post_recv_buf(int i);
 
+            /// Completes the sends of huge messages whose pieces have all gone (server thread)
+            void progress_huge_send();
+
         private:
 
             /// thread-safely round-robins through tags in [first_tag, first_tag+period) range
@@ -282,6 +397,21 @@ namespace madness {
             /// @warning this bounds how many huge messages each RmiTask will be able to process
             static constexpr int unique_tag_period() { return 2048; }
 
+            /// Sends a message bypassing any batching
+            Request isend_direct(const void* buf, size_t nbyte, ProcessID dest, rmi_handlerT func, attrT attr);
+
+            /// Waits for all pieces of the huge message in recv buffer i
+            void wait_huge_recv(int i);
+
+            /// Fills in the header and posts the send ... caller holds the lock
+            Request post_send(const void* buf, size_t nbyte, ProcessID dest, rmi_handlerT func, attrT attr, int tag);
+
+            /// Sends the open batch for dest ... caller holds the lock
+            void send_batch(ProcessID dest, flush_reasonT reason);
+
+            /// Moves buffers of completed batch sends to the free list ... caller holds the lock
+            void reclaim_batch_bufs();
+
         }; // class RmiTask
 
 #if HAVE_INTEL_TBB
@@ -294,6 +424,8 @@ namespace madness {
 
         static const size_t DEFAULT_MAX_MSG_LEN = 3*512*1024;  //!< the default size of recv buffers, in bytes; the actual size can be configured by the user via envvar MAD_BUFFER_SIZE
         static const int DEFAULT_NRECV = 128;  //!< the default # of recv buffers; the actual number can be configured by the user via envvar MAD_RECV_BUFFERS
+        static const int DEFAULT_NHUGE = 4;  //!< the default # of concurrent huge message receives; can be configured by the user via envvar MAD_RMI_HUGE_RECV
+        static const size_t DEFAULT_HUGE_CHUNK = 8*1024*1024;  //!< the default max. size of a piece of a huge message; can be configured by the user via envvar MAD_RMI_CHUNK
 
         // Not allowed
         RMI(const RMI&);
@@ -341,13 +473,56 @@ namespace madness {
                   "!! MADNESS RMI error: This typically occurs when an active message is sent or a remote task is spawned after calling madness::finalize()\n";
               MADNESS_EXCEPTION("!! MADNESS error: The RMI thread is not running", (task_ptr != nullptr));
             }
+            profiling::Tracer::rmi_send(dest, nbyte, reinterpret_cast<const void*>(func));
             return task_ptr->isend(buf, nbyte, dest, func, attr);
         }
 
+        /// Returns the size of the buffers used to aggregate small messages
+
+        /// @return The size in bytes, zero if messages are not aggregated
+        /// @note Set at runtime by the user via environment variable MAD_RMI_BATCH;
+        /// always zero when running on one process or before begin().
+        static std::size_t batch_size() {
+            return task_ptr ? task_ptr->batch_size_ : 0;
+        }
+
+        /// Sends all small messages being held for aggregation
+        static void flush() {
+            if (task_ptr) task_ptr->flush(RmiTask::FLUSH_FENCE);
+        }
+
+        /// Send the concatenation of several buffers as one message without copying them
+
+        /// The receiver sees a single contiguous message, exactly as if
+        /// the segments had been copied into one buffer and sent with
+        /// isend().  The data go directly from the segments using the
+        /// rendezvous protocol, which costs a round trip, so this is
+        /// meant for large messages (e.g., sending the contents of a
+        /// tensor after a small serialized header).
+        /// @param[in] seg The segments; the first must be at least HEADER_LEN bytes long and its first HEADER_LEN bytes are overwritten
+        /// @param[in] nseg The number of segments
+        /// @param[in] dest Process to receive the message
+        /// @param[in] func The function to handle the message on the remote end
+        /// @param[in] attr Attributes of the message (ATTR_UNORDERED or ATTR_ORDERED)
+        /// @return The status as an RMI::Request; segments must not be modified until it completes
+        static Request
+        isendv(const Segment* seg, int nseg, ProcessID dest, rmi_handlerT func, unsigned int attr=ATTR_UNORDERED) {
+            if(!task_ptr)
+                MADNESS_EXCEPTION("!! MADNESS error: The RMI thread is not running", (task_ptr != nullptr));
+            if (profiling::Tracer::enabled()) {
+                std::size_t nbyte = 0;
+                for (int i=0; i<nseg; ++i) nbyte += seg[i].nbyte;
+                profiling::Tracer::rmi_send(dest, nbyte, reinterpret_cast<const void*>(func));
+            }
+            return task_ptr->isendv(seg, nseg, dest, func, attr);
+        }
+
         static void begin();
 
         static void end() {
             if(task_ptr) {
+                task_ptr->flush(RmiTask::FLUSH_FENCE);
+                task_ptr->free_batch_bufs();
                 task_ptr->exit();
 #if HAVE_INTEL_TBB
                 tbb_rmi_parent_task->wait_for_all();
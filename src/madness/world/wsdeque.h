@@ -0,0 +1,247 @@
+/*
+  This file is part of MADNESS.
+
+  Copyright (C) 2007,2010 Oak Ridge National Laboratory
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; either version 2 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+
+  For more information please contact:
+
+  Robert J. Harrison
+  Oak Ridge National Laboratory
+  One Bethel Valley Road
+  P.O. Box 2008, MS-6367
+
+  email: harrisonrj@ornl.gov
+  tel:   865-241-3937
+  fax:   865-572-0680
+*/
+
+#ifndef MADNESS_WORLD_WSDEQUE_H__INCLUDED
+#define MADNESS_WORLD_WSDEQUE_H__INCLUDED
+
+/**
+ \file wsdeque.h
+ \brief Implements \c WSDeque, a lock-free work-stealing deque.
+ \ingroup threads
+*/
+
+#include <madness/world/madness_exception.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+namespace madness {
+
+    /// Work-stealing statistics for a single deque.
+    struct WSStats {
+        uint64_t npush;         ///< #calls to push (owner)
+        uint64_t npop;          ///< #successful pops (owner)
+        uint64_t nsteal;        ///< #successful steals by this deque's owner
+        uint64_t nsteal_fail;   ///< #failed steal attempts by this deque's owner
+        uint64_t nsteal_remote; ///< #successful steals from a thread on another NUMA node
+        uint64_t ngrow;         ///< #calls to grow
+
+        WSStats()
+                : npush(0), npop(0), nsteal(0), nsteal_fail(0), nsteal_remote(0), ngrow(0) {}
+    };
+
+
+    /// A lock-free, single-owner, multi-thief double-ended queue.
+
+    /// This is the dynamic circular work-stealing deque of Chase and Lev,
+    /// using the C++11 memory model formulation of Le, Pop, Cohen and
+    /// Zappa Nardelli (PPoPP 2013). The owning thread pushes and pops at
+    /// the bottom (LIFO, for cache locality) while other threads steal from
+    /// the top (FIFO, to take the oldest and usually largest work).
+    ///
+    /// The buffer grows as needed but never shrinks. Retired buffers are
+    /// kept until the deque is destroyed since a thief may still be
+    /// reading from them; growth is geometric so this at most doubles the
+    /// memory footprint.
+    ///
+    /// It is heavily specialized to its use in \c ThreadPool: \c T must be
+    /// a pointer type and a null pointer is returned for an empty deque or
+    /// a lost race.
+    /// \tparam T The element type (a pointer).
+    template <typename T>
+    class WSDeque {
+        static_assert(std::is_pointer<T>::value, "WSDeque element type must be a pointer");
+
+        /// Circular buffer with a power-of-two capacity.
+        class Array {
+            const std::size_t mask; ///< Capacity - 1.
+            std::atomic<T>* const buf; ///< The elements.
+
+        public:
+            Array(std::size_t capacity)
+                : mask(capacity - 1), buf(new std::atomic<T>[capacity])
+            { }
+
+            ~Array() { delete [] buf; }
+
+            std::size_t capacity() const { return mask + 1; }
+
+            T get(std::int64_t i) const {
+                return buf[i & mask].load(std::memory_order_relaxed);
+            }
+
+            void put(std::int64_t i, T value) {
+                buf[i & mask].store(value, std::memory_order_relaxed);
+            }
+
+            /// Return a buffer of twice the size holding elements [t,b).
+            Array* grow(std::int64_t t, std::int64_t b) const {
+                Array* a = new Array(capacity() << 1);
+                for (std::int64_t i = t; i < b; ++i)
+                    a->put(i, get(i));
+                return a;
+            }
+        };
+
+        char pad0[64]; ///< Keep top, bottom and the buffer in separate cache lines
+        std::atomic<std::int64_t> top; ///< Index of the oldest element (thieves)
+        char pad1[64];
+        std::atomic<std::int64_t> bottom; ///< Index past the newest element (owner)
+        std::atomic<Array*> array; ///< Current buffer
+        std::vector<Array*> retired; ///< Old buffers, freed on destruction (owner only)
+        WSStats stats; ///< Owner statistics (steal counts are per thief)
+
+        WSDeque(const WSDeque&) = delete;
+        WSDeque& operator=(const WSDeque&) = delete;
+
+    public:
+        /// Construct an empty deque.
+
+        /// \param[in] hint Initial capacity, rounded up to a power of two.
+        WSDeque(std::size_t hint=1024) : top(0), bottom(0), array(nullptr) {
+            std::size_t capacity = 2;
+            while (capacity < hint) capacity <<= 1;
+            array.store(new Array(capacity), std::memory_order_relaxed);
+        }
+
+        ~WSDeque() {
+            delete array.load(std::memory_order_relaxed);
+            for (std::size_t i = 0; i < retired.size(); ++i)
+                delete retired[i];
+        }
+
+        /// Push a value on the bottom of the deque.
+
+        /// \attention Only the owner may call this.
+        /// \param[in] value The value to be pushed.
+        void push(T value) {
+            const std::int64_t b = bottom.load(std::memory_order_relaxed);
+            const std::int64_t t = top.load(std::memory_order_acquire);
+            Array* a = array.load(std::memory_order_relaxed);
+            if (b - t > std::int64_t(a->capacity()) - 1) {
+                retired.push_back(a);
+                a = a->grow(t, b);
+                array.store(a, std::memory_order_release);
+                ++(stats.ngrow);
+            }
+            a->put(b, value);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            ++(stats.npush);
+        }
+
+        /// Pop a value from the bottom of the deque.
+
+        /// \attention Only the owner may call this.
+        /// \return The newest element, or null if the deque is empty.
+        T pop() {
+            const std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            Array* a = array.load(std::memory_order_relaxed);
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            std::int64_t t = top.load(std::memory_order_relaxed);
+
+            T result = nullptr;
+            if (t <= b) {
+                result = a->get(b);
+                if (t == b) {
+                    // Last element ... race against thieves for it
+                    if (!top.compare_exchange_strong(t, t + 1,
+                            std::memory_order_seq_cst, std::memory_order_relaxed))
+                        result = nullptr;
+                    bottom.store(b + 1, std::memory_order_relaxed);
+                }
+            }
+            else {
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            if (result) ++(stats.npop);
+            return result;
+        }
+
+        /// Steal a value from the top of the deque.
+
+        /// May be called by any thread. A null result means the deque was
+        /// empty or the steal lost a race with another thread.
+        /// \return The oldest element or null.
+        T steal() {
+            std::int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const std::int64_t b = bottom.load(std::memory_order_acquire);
+
+            if (t < b) {
+                Array* a = array.load(std::memory_order_acquire);
+                T result = a->get(t);
+                if (!top.compare_exchange_strong(t, t + 1,
+                        std::memory_order_seq_cst, std::memory_order_relaxed))
+                    return nullptr;
+                return result;
+            }
+            return nullptr;
+        }
+
+        /// Approximate number of elements in the deque.
+        std::size_t size() const {
+            const std::int64_t n = bottom.load(std::memory_order_relaxed) -
+                    top.load(std::memory_order_relaxed);
+            return (n > 0 ? std::size_t(n) : 0);
+        }
+
+        /// Approximate test for an empty deque.
+        bool empty() const {
+            return size() == 0;
+        }
+
+        /// Record the outcome of a steal attempt made by the owner of this deque.
+
+        /// \attention Only the owner may call this.
+        /// \param[in] success True if the steal returned an element.
+        /// \param[in] remote True if the victim is on another NUMA node.
+        void record_steal(bool success, bool remote=false) {
+            if (success) {
+                ++(stats.nsteal);
+                if (remote) ++(stats.nsteal_remote);
+            }
+            else {
+                ++(stats.nsteal_fail);
+            }
+        }
+
+        const WSStats& get_stats() const {
+            return stats;
+        }
+    };
+
+}
+
+#endif // MADNESS_WORLD_WSDEQUE_H__INCLUDED